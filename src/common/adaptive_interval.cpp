@@ -0,0 +1,237 @@
+/**
+ * adaptive_interval.cpp
+ *
+ * Threshold-based stream interval.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+
+#include "adaptive_interval.h"
+
+/*
+ * The stock bands: stream 10% faster per update above 40% of the CPU
+ * cores, 20% faster above 60%, and back off by 50% (10% once demand
+ * eases) when the cores are oversubscribed.
+ */
+static const adaptive_band_t default_bands[] = {
+    { "normal",   0.0f, 1.0f,        1.0f },
+    { "elevated", 0.4f, 1.0f / 1.1f, 1.0f / 1.1f },
+    { "high",     0.6f, 1.0f / 1.2f, 1.0f / 1.2f },
+    { "overload", 1.0f, 1.5f,        1.1f }
+};
+
+#define DEFAULT_BANDS ((int) (sizeof(default_bands) / sizeof(default_bands[0])))
+
+void adaptive_default_cfg(adaptive_cfg_t *cfg, uint32_t base_ms)
+{
+    cfg->metric = ADAPTIVE_LOAD_PER_CPU;
+    cfg->base_ms = base_ms;
+    cfg->min_ms = ADAPTIVE_MIN_MS;
+    cfg->max_ms = ADAPTIVE_MAX_MS;
+    cfg->alpha = ADAPTIVE_ALPHA;
+    cfg->hysteresis = ADAPTIVE_HYSTERESIS;
+    memcpy(cfg->bands, default_bands, sizeof(default_bands));
+    cfg->nbands = DEFAULT_BANDS;
+}
+
+static uint32_t clamp_ms(const adaptive_cfg_t *cfg, double ms)
+{
+    if (ms < cfg->min_ms) {
+        return cfg->min_ms;
+    }
+    if (ms > cfg->max_ms) {
+        return cfg->max_ms;
+    }
+    return (uint32_t) (ms + 0.5);
+}
+
+static int demand_index(float demand)
+{
+    if (!(demand > 0.0f)) {
+        return 0;
+    }
+    int i = (int) (demand / ADAPTIVE_TABLE_STEP + 0.5f);
+    return std::min(i, ADAPTIVE_TABLE_SIZE - 1);
+}
+
+static bool cmp_band(const adaptive_band_t& a, const adaptive_band_t& b)
+{
+    return a.enter < b.enter;
+}
+
+static void sanitize_cfg(adaptive_cfg_t *cfg)
+{
+    if (cfg->min_ms == 0) {
+        cfg->min_ms = 1;
+    }
+    if (cfg->max_ms < cfg->min_ms) {
+        uint32_t t = cfg->max_ms;
+        cfg->max_ms = cfg->min_ms;
+        cfg->min_ms = (t > 0) ? t : 1;
+    }
+    if (!(cfg->alpha > 0.0f && cfg->alpha <= 1.0f)) {
+        cfg->alpha = ADAPTIVE_ALPHA;
+    }
+    if (!(cfg->hysteresis >= 0.0f)) {
+        cfg->hysteresis = 0.0f;
+    }
+    cfg->base_ms = clamp_ms(cfg, cfg->base_ms);
+
+    if (cfg->nbands <= 0) {
+        memcpy(cfg->bands, default_bands, sizeof(default_bands));
+        cfg->nbands = DEFAULT_BANDS;
+    }
+    cfg->nbands = std::min(cfg->nbands, ADAPTIVE_MAX_BANDS);
+    std::sort(cfg->bands, cfg->bands + cfg->nbands, cmp_band);
+
+    /* Demand below the lowest threshold holds the interval */
+    if (cfg->bands[0].enter > 0.0f && cfg->nbands < ADAPTIVE_MAX_BANDS) {
+        memmove(&cfg->bands[1], &cfg->bands[0], cfg->nbands * sizeof(cfg->bands[0]));
+        snprintf(cfg->bands[0].name, sizeof(cfg->bands[0].name), "normal");
+        cfg->bands[0].enter = 0.0f;
+        cfg->bands[0].factor = 1.0f;
+        cfg->bands[0].easing_factor = 1.0f;
+        cfg->nbands++;
+    }
+
+    for (int b = 0; b < cfg->nbands; b++) {
+        if (!(cfg->bands[b].factor > 0.0f)) {
+            cfg->bands[b].factor = 1.0f;
+        }
+        if (!(cfg->bands[b].easing_factor > 0.0f)) {
+            cfg->bands[b].easing_factor = cfg->bands[b].factor;
+        }
+    }
+}
+
+/*
+ * band_up[d]   the highest band whose threshold is <= d
+ * band_down[d] the highest band whose threshold minus the hysteresis is <= d
+ */
+static void compile_bands(adaptive_interval_t *ai)
+{
+    const adaptive_cfg_t *cfg = &ai->cfg;
+
+    for (int i = 0; i < ADAPTIVE_TABLE_SIZE; i++) {
+        int up = 0, down = 0;
+        for (int b = 1; b < cfg->nbands; b++) {
+            int enter = demand_index(cfg->bands[b].enter);
+            int leave = demand_index(cfg->bands[b].enter - cfg->hysteresis);
+            if (enter <= i) {
+                up = b;
+            }
+            if (leave <= i) {
+                down = b;
+            }
+        }
+        ai->band_up[i] = (uint8_t) up;
+        ai->band_down[i] = (uint8_t) down;
+    }
+}
+
+void adaptive_init(adaptive_interval_t *ai, const adaptive_cfg_t *cfg)
+{
+    ai->cfg = *cfg;
+    sanitize_cfg(&ai->cfg);
+    compile_bands(ai);
+
+    ai->interval_ms = ai->cfg.base_ms;
+    ai->demand = 0;
+    ai->prev_demand = 0;
+    ai->primed = false;
+    ai->band = 0;
+    ai->burst_until_ms = 0;
+    ai->quiet = false;
+}
+
+void adaptive_reconfigure(adaptive_interval_t *ai, const adaptive_cfg_t *cfg)
+{
+    ai->cfg = *cfg;
+    sanitize_cfg(&ai->cfg);
+    compile_bands(ai);
+
+    ai->interval_ms = clamp_ms(&ai->cfg, ai->interval_ms);
+    ai->band = std::min(ai->band, ai->cfg.nbands - 1);
+
+    std::cout << "Threshold policy: " << ai->cfg.nbands << " bands, "
+              << ai->cfg.min_ms << ".." << ai->cfg.max_ms << "ms (base "
+              << ai->cfg.base_ms << "ms), alpha " << ai->cfg.alpha
+              << ", hysteresis " << ai->cfg.hysteresis << std::endl;
+}
+
+/* Move up as soon as a threshold is reached, down only past the hysteresis */
+static int select_band(const adaptive_interval_t *ai)
+{
+    int i = demand_index(ai->demand);
+
+    if (ai->band_up[i] > ai->band) {
+        return ai->band_up[i];
+    }
+    if (ai->band_down[i] < ai->band) {
+        return ai->band_down[i];
+    }
+    return ai->band;
+}
+
+uint32_t adaptive_update(adaptive_interval_t *ai, float sample, bool rising,
+                         uint64_t now_ms)
+{
+    ai->prev_demand = ai->demand;
+    if (ai->primed) {
+        ai->demand += ai->cfg.alpha * (sample - ai->demand);
+    } else {
+        ai->demand = sample;
+        ai->prev_demand = sample;
+        ai->primed = true;
+    }
+
+    int band = select_band(ai);
+    if (band != ai->band && !ai->quiet) {
+        std::cout << "\tDemand " << ai->demand
+                  << (ai->cfg.metric == ADAPTIVE_CPU_BUSY ? " busy: " : " per CPU: ")
+                  << ai->cfg.bands[ai->band].name << " -> "
+                  << ai->cfg.bands[band].name << std::endl;
+    }
+    ai->band = band;
+
+    if (now_ms < ai->burst_until_ms) {
+        /* Ticks come every min_ms; scaling per tick would compound */
+        if (!ai->quiet) {
+            std::cout << "\tBurst for another " << ai->burst_until_ms - now_ms << "ms" << std::endl;
+        }
+    } else if (rising) {
+        const adaptive_band_t *b = &ai->cfg.bands[band];
+        float factor = (ai->demand < ai->prev_demand) ? b->easing_factor : b->factor;
+
+        if (!ai->quiet) {
+            std::cout << "\tSystem Load is increasing (" << b->name << ")..." << std::endl;
+        }
+        ai->interval_ms = clamp_ms(&ai->cfg, (double) ai->interval_ms * factor);
+    } else {
+        if (!ai->quiet) {
+            std::cout << "\tSystem load is decreasing..." << std::endl;
+        }
+        ai->interval_ms = ai->cfg.base_ms;
+    }
+
+    if (!ai->quiet) {
+        std::cout << "Streaming Interval is: " << ai->interval_ms << "ms" << std::endl;
+    }
+    return ai->interval_ms;
+}
+
+void adaptive_burst(adaptive_interval_t *ai, uint64_t until_ms)
+{
+    if (until_ms > ai->burst_until_ms) {
+        ai->burst_until_ms = until_ms;
+    }
+}
+
+uint32_t adaptive_period_ms(const adaptive_interval_t *ai, uint64_t now_ms)
+{
+    return (now_ms < ai->burst_until_ms) ? ai->cfg.min_ms : ai->interval_ms;
+}
@@ -0,0 +1,121 @@
+/**
+ * adaptive_interval.h
+ *
+ * Threshold-based stream interval. The system demand (the 1-min load
+ * average per CPU, or the busy share of all CPUs from /proc/stat,
+ * smoothed with an EWMA) selects a band; while the load is rising, each
+ * band scales the interval by its factor once per update, so streaming
+ * speeds up as demand builds and backs off when the system is
+ * overloaded. When the load is falling the interval returns to its base
+ * value. The interval is kept in milliseconds and never leaves
+ * [min_ms, max_ms].
+ *
+ * A band is entered when the demand reaches its threshold and only
+ * left (downwards) once the demand drops 'hysteresis' below it, so a
+ * demand hovering on a threshold does not flap between bands.
+ *
+ * A burst (e.g. on a pressure stall, see psi.h) runs at min_ms until
+ * it expires, whatever the demand; the demand keeps being tracked
+ * meanwhile.
+ *
+ * The band table is compiled into two lookup tables indexed by the
+ * demand in steps of ADAPTIVE_TABLE_STEP, so an update costs the same
+ * however many bands are configured.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef ADAPTIVE_INTERVAL_H
+#define ADAPTIVE_INTERVAL_H
+
+#include <inttypes.h>
+
+#define ADAPTIVE_MIN_MS 1000
+#define ADAPTIVE_MAX_MS 300000
+#define ADAPTIVE_ALPHA 0.3f
+#define ADAPTIVE_HYSTERESIS 0.05f
+
+#define ADAPTIVE_MAX_BANDS 8
+#define ADAPTIVE_BAND_NAME 32
+
+/* Demand resolution of the compiled band table: 0.00 .. 10.23 per CPU */
+#define ADAPTIVE_TABLE_STEP 0.01f
+#define ADAPTIVE_TABLE_SIZE 1024
+
+struct adaptive_band_t {
+    char name[ADAPTIVE_BAND_NAME];
+    float enter;                /* demand (load per CPU) to enter the band */
+    float factor;               /* interval scale per update, load rising */
+    float easing_factor;        /* ... demand lower than at the last update */
+};
+
+typedef struct adaptive_band_t adaptive_band_t;
+
+/* What the demand is measured in */
+enum adaptive_metric_t {
+    ADAPTIVE_LOAD_PER_CPU,      /* 1-min load average / CPU count */
+    ADAPTIVE_CPU_BUSY           /* non-idle share of all CPUs, 0..1 */
+};
+
+typedef enum adaptive_metric_t adaptive_metric_t;
+
+struct adaptive_cfg_t {
+    adaptive_metric_t metric;
+    uint32_t base_ms;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    float alpha;                /* EWMA weight of the newest sample, (0, 1] */
+    float hysteresis;
+    adaptive_band_t bands[ADAPTIVE_MAX_BANDS];
+    int nbands;
+};
+
+typedef struct adaptive_cfg_t adaptive_cfg_t;
+
+struct adaptive_interval_t {
+    adaptive_cfg_t cfg;
+    uint32_t interval_ms;
+    float demand;               /* smoothed load per CPU */
+    float prev_demand;
+    bool primed;                /* demand holds at least one sample */
+    int band;
+    uint64_t burst_until_ms;    /* monotonic_ms() time base, 0 if none */
+    bool quiet;                 /* the owner logs the changes; nothing per update */
+
+    /* Compiled band table: the band to move up to / fall back to */
+    uint8_t band_up[ADAPTIVE_TABLE_SIZE];
+    uint8_t band_down[ADAPTIVE_TABLE_SIZE];
+};
+
+typedef struct adaptive_interval_t adaptive_interval_t;
+
+/* Defaults for a base interval, with the stock band table */
+void adaptive_default_cfg(adaptive_cfg_t *cfg, uint32_t base_ms);
+
+/*
+ * Sanitizes the configuration (clamps alpha, orders the bounds and
+ * bands, puts the base inside the bounds), compiles the band table and
+ * starts at the base interval.
+ */
+void adaptive_init(adaptive_interval_t *ai, const adaptive_cfg_t *cfg);
+
+/*
+ * Switch to a new configuration, keeping the smoothed demand and the
+ * current interval (clamped to the new bounds).
+ */
+void adaptive_reconfigure(adaptive_interval_t *ai, const adaptive_cfg_t *cfg);
+
+/*
+ * Feed one demand sample, in the unit of cfg.metric, and whether the
+ * load is rising, taken at 'now_ms'; returns the new interval in
+ * milliseconds. The interval holds while a burst is active.
+ */
+uint32_t adaptive_update(adaptive_interval_t *ai, float sample, bool rising,
+                         uint64_t now_ms);
+
+/* Run at min_ms until 'until_ms'; a later burst extends an earlier one */
+void adaptive_burst(adaptive_interval_t *ai, uint64_t until_ms);
+
+/* The interval to schedule with at time 'now_ms' */
+uint32_t adaptive_period_ms(const adaptive_interval_t *ai, uint64_t now_ms);
+
+#endif
@@ -0,0 +1,252 @@
+/**
+ * adaptive_test.cpp
+ *
+ * Feeds synthetic demand series (steps, ramps, oscillation on a band
+ * edge, pressure bursts) through adaptive_update() and checks that the
+ * interval never leaves [min_ms, max_ms] and that the hysteresis keeps
+ * a demand hovering on a threshold from flapping between bands.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "adaptive_interval.h"
+#include "unit_test.h"
+
+#define TICK_MS 1000
+
+static uint64_t now_ms;
+
+/* adaptive_update() logs every step; keep it out of the test output */
+static std::ofstream devnull("/dev/null");
+
+static void check_bounds(const adaptive_interval_t *ai)
+{
+    CHECK(ai->cfg.min_ms <= ai->interval_ms && ai->interval_ms <= ai->cfg.max_ms);
+
+    uint32_t period = adaptive_period_ms(ai, now_ms);
+    CHECK(ai->cfg.min_ms <= period && period <= ai->cfg.max_ms);
+}
+
+/* One update, a tick after the previous one */
+static void update(adaptive_interval_t *ai, float sample, bool rising)
+{
+    now_ms += TICK_MS;
+    adaptive_update(ai, sample, rising, now_ms);
+    check_bounds(ai);
+}
+
+/* One update, the load rising when the sample is above the last one */
+static int step(adaptive_interval_t *ai, float sample, float *last)
+{
+    update(ai, sample, sample >= *last);
+    *last = sample;
+    return ai->band;
+}
+
+static void test_step(const adaptive_cfg_t *cfg)
+{
+    adaptive_interval_t ai;
+    adaptive_init(&ai, cfg);
+    check_bounds(&ai);
+
+    float last = 0;
+    for (int i = 0; i < 20; i++) {
+        step(&ai, 0.1f, &last);
+    }
+    CHECK(ai.interval_ms == ai.cfg.base_ms);
+
+    /* Overloaded and rising: the interval backs off until max_ms */
+    for (int i = 0; i < 100; i++) {
+        update(&ai, 3.0f, true);
+    }
+    CHECK(ai.interval_ms == ai.cfg.max_ms);
+
+    /* Elevated and rising: the interval speeds up until min_ms */
+    for (int i = 0; i < 500; i++) {
+        update(&ai, 0.5f, true);
+    }
+    CHECK(ai.interval_ms == ai.cfg.min_ms);
+
+    /* Falling: back to the base */
+    step(&ai, 0.0f, &last);
+    CHECK(ai.interval_ms == ai.cfg.base_ms);
+}
+
+static void test_ramp(const adaptive_cfg_t *cfg)
+{
+    adaptive_interval_t ai;
+    adaptive_init(&ai, cfg);
+
+    float last = 0;
+    int band = 0;
+    for (float d = 0.0f; d < 12.0f; d += 0.01f) {
+        int b = step(&ai, d, &last);
+        CHECK(b >= band);       /* rising demand never moves down a band */
+        band = b;
+    }
+    CHECK(band == ai.cfg.nbands - 1);
+
+    for (float d = 12.0f; d > 0.0f; d -= 0.01f) {
+        int b = step(&ai, d, &last);
+        CHECK(b <= band);
+        band = b;
+    }
+}
+
+/*
+ * A demand alternating around a threshold, within the hysteresis,
+ * changes band once; without hysteresis it flaps.
+ */
+static int band_changes(float hysteresis, float threshold, float swing)
+{
+    adaptive_cfg_t cfg;
+    adaptive_default_cfg(&cfg, 10000);
+    cfg.alpha = 1.0f;           /* no smoothing: the demand is the sample */
+    cfg.hysteresis = hysteresis;
+
+    adaptive_interval_t ai;
+    adaptive_init(&ai, &cfg);
+
+    float last = 0;
+    int band = step(&ai, threshold - swing, &last);
+    int changes = 0;
+    for (int i = 0; i < 200; i++) {
+        float d = (i % 2) ? threshold - swing : threshold + swing;
+        int b = step(&ai, d, &last);
+        if (b != band) {
+            changes++;
+        }
+        band = b;
+    }
+    return changes;
+}
+
+static void test_band_edges(void)
+{
+    adaptive_cfg_t cfg;
+    adaptive_default_cfg(&cfg, 10000);
+
+    for (int b = 1; b < cfg.nbands; b++) {
+        float enter = cfg.bands[b].enter;
+        CHECK(band_changes(ADAPTIVE_HYSTERESIS, enter, 0.02f) == 1);
+        CHECK(band_changes(0.0f, enter, 0.02f) > 100);
+    }
+
+    /* With the default smoothing the band holds as well */
+    adaptive_interval_t ai;
+    adaptive_init(&ai, &cfg);
+
+    float last = 0;
+    for (int i = 0; i < 50; i++) {
+        step(&ai, 0.6f, &last);
+    }
+    int band = ai.band;
+    int changes = 0;
+    for (int i = 0; i < 200; i++) {
+        int b = step(&ai, (i % 2) ? 0.57f : 0.63f, &last);
+        if (b != band) {
+            changes++;
+        }
+        band = b;
+    }
+    CHECK(changes == 0);
+}
+
+static void test_burst(const adaptive_cfg_t *cfg)
+{
+    adaptive_interval_t ai;
+    adaptive_init(&ai, cfg);
+
+    float last = 0;
+    for (int i = 0; i < 10; i++) {
+        step(&ai, 2.0f, &last);
+    }
+    uint32_t before = ai.interval_ms;
+
+    /* A stall: min_ms until the burst expires, the interval holds */
+    adaptive_burst(&ai, now_ms + 10 * TICK_MS);
+    adaptive_burst(&ai, now_ms + 5 * TICK_MS);      /* does not shorten it */
+    for (int i = 0; i < 9; i++) {
+        CHECK(adaptive_period_ms(&ai, now_ms) == ai.cfg.min_ms);
+        update(&ai, 2.0f, true);
+        CHECK(ai.interval_ms == before);
+    }
+
+    now_ms += TICK_MS;
+    CHECK(adaptive_period_ms(&ai, now_ms) == ai.interval_ms);
+
+    /* Bursts back to back, with the demand swinging, stay in bounds */
+    for (int i = 0; i < 1000; i++) {
+        if (i % 7 == 0) {
+            adaptive_burst(&ai, now_ms + (i % 13) * TICK_MS);
+        }
+        step(&ai, (float) (i % 37) / 10.0f, &last);
+    }
+}
+
+/* Random demand, including values outside the band table */
+static void test_random(const adaptive_cfg_t *cfg)
+{
+    adaptive_interval_t ai;
+    adaptive_init(&ai, cfg);
+
+    srand(1);
+    for (int i = 0; i < 10000; i++) {
+        float d = (float) (rand() % 2000) / 100.0f - 2.0f;
+        update(&ai, d, rand() % 2);
+    }
+}
+
+static void run_all(const adaptive_cfg_t *cfg)
+{
+    test_step(cfg);
+    test_ramp(cfg);
+    test_burst(cfg);
+    test_random(cfg);
+}
+
+int main(void)
+{
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+    adaptive_cfg_t cfg;
+
+    /* The stock configuration */
+    adaptive_default_cfg(&cfg, 10000);
+    run_all(&cfg);
+
+    /* Narrow bounds, and a base outside them */
+    adaptive_default_cfg(&cfg, 60000);
+    cfg.min_ms = 2000;
+    cfg.max_ms = 5000;
+    run_all(&cfg);
+
+    /* Bounds given the wrong way round, extreme factors */
+    adaptive_default_cfg(&cfg, 10);
+    cfg.min_ms = 50000;
+    cfg.max_ms = 500;
+    cfg.bands[1].factor = 0.001f;
+    cfg.bands[3].factor = 1000.0f;
+    cfg.bands[3].easing_factor = 0.0f;
+    run_all(&cfg);
+
+    /* Unsorted bands not starting at 0, on the CPU busy share */
+    adaptive_default_cfg(&cfg, 15000);
+    cfg.metric = ADAPTIVE_CPU_BUSY;
+    cfg.nbands = 2;
+    strcpy(cfg.bands[0].name, "busy");
+    cfg.bands[0].enter = 0.9f;
+    cfg.bands[0].factor = 2.0f;
+    strcpy(cfg.bands[1].name, "warm");
+    cfg.bands[1].enter = 0.5f;
+    cfg.bands[1].factor = 0.5f;
+    run_all(&cfg);
+
+    test_band_edges();
+
+    std::cout.rdbuf(out);
+    return test_result("adaptive_test");
+}
@@ -0,0 +1,530 @@
+/**
+ * cgroup_collector.cpp
+ *
+ * Streams the resource use of the cgroup v2 groups.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "openconfig-procmon-ext.h"
+#include "proc_reader.h"
+#include "cgroup_collector.h"
+#include "history.h"
+#include "summary_collector.h"
+
+cgroup_opts_t cgroup_opts = {
+    NULL                        /* root */
+};
+
+/* Shorten the interval by a third above 10% stalled, and halve it above 25% */
+static const adaptive_band_t cgroup_bands[] = {
+    { "normal",   0.0f,  1.0f,        1.0f },
+    { "elevated", 0.1f,  1.0f / 1.5f, 1.0f },
+    { "critical", 0.25f, 1.0f / 2.0f, 1.0f }
+};
+
+#define CGROUP_BANDS ((int) (sizeof(cgroup_bands) / sizeof(cgroup_bands[0])))
+
+/* Tag values per group: begin/end, path and fourteen leaves */
+#define CGROUP_TAGS 17
+
+/* The files of a group that could be read */
+enum {
+    CGROUP_HAS_CPU = 1,
+    CGROUP_HAS_PRESSURE = 2,
+    CGROUP_HAS_MEMORY = 4,
+    CGROUP_HAS_MEMORY_EVENTS = 8,
+    CGROUP_HAS_IO = 16
+};
+
+/* What was read of a group; all counters but memory_current */
+struct cgroup_counters_t {
+    unsigned int has;
+    uint64_t usage_usec;        /* cpu.stat */
+    uint64_t user_usec;
+    uint64_t system_usec;
+    uint64_t nr_throttled;
+    uint64_t throttled_usec;
+    uint64_t stall_usec;        /* cpu.pressure, "some" total */
+    uint64_t memory_current;    /* memory.current, bytes */
+    uint64_t memory_high;       /* memory.events */
+    uint64_t memory_max;
+    uint64_t oom_kill;
+    uint64_t rbytes;            /* io.stat, over all devices */
+    uint64_t wbytes;
+    uint64_t rios;
+    uint64_t wios;
+};
+
+typedef struct cgroup_counters_t cgroup_counters_t;
+
+/* A group as read at the previous collection */
+struct cgroup_t {
+    cgroup_counters_t last;
+    unsigned int generation;    /* 0: not read yet */
+};
+
+typedef struct cgroup_t cgroup_t;
+
+/* A "name value" line of a flat keyed file, and where its value goes */
+struct cgroup_key_t {
+    const char *name;
+    size_t offset;
+};
+
+typedef struct cgroup_key_t cgroup_key_t;
+
+static const cgroup_key_t cpu_keys[] = {
+    { "usage_usec", offsetof(cgroup_counters_t, usage_usec) },
+    { "user_usec", offsetof(cgroup_counters_t, user_usec) },
+    { "system_usec", offsetof(cgroup_counters_t, system_usec) },
+    { "nr_throttled", offsetof(cgroup_counters_t, nr_throttled) },
+    { "throttled_usec", offsetof(cgroup_counters_t, throttled_usec) },
+    { NULL, 0 }
+};
+
+static const cgroup_key_t memory_event_keys[] = {
+    { "high", offsetof(cgroup_counters_t, memory_high) },
+    { "max", offsetof(cgroup_counters_t, memory_max) },
+    { "oom_kill", offsetof(cgroup_counters_t, oom_kill) },
+    { NULL, 0 }
+};
+
+static const cgroup_key_t io_keys[] = {
+    { "rbytes", offsetof(cgroup_counters_t, rbytes) },
+    { "wbytes", offsetof(cgroup_counters_t, wbytes) },
+    { "rios", offsetof(cgroup_counters_t, rios) },
+    { "wios", offsetof(cgroup_counters_t, wios) },
+    { NULL, 0 }
+};
+
+static adaptive_interval_t cgroup_cadence;
+
+static tv_arena_t cgroup_arena;
+
+static history_metric_t *history_pressure;
+static summary_metric_t *summary_pressure;
+
+static std::string root;        /* empty: no cgroup v2 hierarchy */
+static proc_file_t file;
+static std::map<std::string, cgroup_t> groups;     /* by path below the root */
+static unsigned int generation = 0;
+static uint64_t collected_ms;
+
+/* What was last logged: the number of groups and the cadence band */
+static size_t logged_groups;
+static int logged_band;
+
+/* The groups found by this collection, and what they did since the last */
+static std::vector<std::string> paths;
+static std::vector<const std::string *> names;     /* the keys of 'groups' */
+static std::vector<cgroup_counters_t> deltas;
+
+static uint64_t *counter(cgroup_counters_t *c, size_t offset)
+{
+    return (uint64_t *) ((char *) c + offset);
+}
+
+static const cgroup_key_t *find_key(const cgroup_key_t *keys, const char *name, size_t len)
+{
+    for (; keys->name != NULL; keys++) {
+        if (strlen(keys->name) == len && memcmp(keys->name, name, len) == 0) {
+            return keys;
+        }
+    }
+    return NULL;
+}
+
+static bool read_file(const std::string& group, const char *name)
+{
+    std::string path = root + group + "/" + name;
+    return proc_file_read_path(&file, path.c_str()) > 0;
+}
+
+/* cpu.stat, memory.events: one "name value" per line */
+static void parse_flat_keyed(const cgroup_key_t *keys, cgroup_counters_t *c)
+{
+    const char *p = file.buf;
+    const char *end = p + file.len;
+
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        const char *space = (const char *) memchr(p, ' ', eol - p);
+        if (space != NULL) {
+            const cgroup_key_t *k = find_key(keys, p, space - p);
+            if (k != NULL) {
+                proc_parse_u64(space, eol, counter(c, k->offset));
+            }
+        }
+
+        p = eol + 1;
+    }
+}
+
+/* io.stat: "MAJ:MIN name=value ..." per device, summed */
+static void parse_io_stat(cgroup_counters_t *c)
+{
+    const char *p = file.buf;
+    const char *end = p + file.len;
+
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        /* Past the device, every token is name=value */
+        const char *q = (const char *) memchr(p, ' ', eol - p);
+        while (q != NULL && q < eol) {
+            q = proc_skip_space(q, eol);
+            const char *eq = (const char *) memchr(q, '=', eol - q);
+            if (eq == NULL) {
+                break;
+            }
+
+            uint64_t val = 0;
+            const cgroup_key_t *k = find_key(io_keys, q, eq - q);
+            if ((q = proc_parse_u64(eq + 1, eol, &val)) == NULL) {
+                break;
+            }
+            if (k != NULL) {
+                *counter(c, k->offset) += val;
+            }
+        }
+
+        p = eol + 1;
+    }
+}
+
+/* cpu.pressure: "some avg10=... avg60=... avg300=... total=<usec>" */
+static bool parse_pressure(uint64_t *stall)
+{
+    const char *end = file.buf + file.len;
+
+    if (file.len < 5 || memcmp(file.buf, "some ", 5) != 0) {
+        return false;
+    }
+
+    const char *eol = (const char *) memchr(file.buf, '\n', file.len);
+    const char *total = strstr(file.buf, "total=");
+    return total != NULL && (eol == NULL || total < eol) &&
+           proc_parse_u64(total + strlen("total="), end, stall) != NULL;
+}
+
+/*
+ * Read what the controllers enabled for a group have. A group removed
+ * during the walk reads as one with none.
+ */
+static void read_group(const std::string& group, cgroup_counters_t *c)
+{
+    memset(c, 0, sizeof(*c));
+
+    if (read_file(group, "cpu.stat")) {
+        parse_flat_keyed(cpu_keys, c);
+        c->has |= CGROUP_HAS_CPU;
+    }
+    if (read_file(group, "cpu.pressure") && parse_pressure(&c->stall_usec)) {
+        c->has |= CGROUP_HAS_PRESSURE;
+    }
+    if (read_file(group, "memory.current") &&
+        proc_parse_u64(file.buf, file.buf + file.len, &c->memory_current) != NULL) {
+        c->has |= CGROUP_HAS_MEMORY;
+    }
+    if (read_file(group, "memory.events")) {
+        parse_flat_keyed(memory_event_keys, c);
+        c->has |= CGROUP_HAS_MEMORY_EVENTS;
+    }
+    if (read_file(group, "io.stat")) {
+        parse_io_stat(c);
+        c->has |= CGROUP_HAS_IO;
+    }
+}
+
+/* The groups below 'group' (a path below the root, "" for the root) */
+static void walk_groups(const std::string& group, int depth)
+{
+    if (paths.size() >= CGROUP_MAX_GROUPS) {
+        return;
+    }
+    paths.push_back(group);
+
+    if (depth >= CGROUP_MAX_DEPTH) {
+        return;
+    }
+
+    std::string dirPath = root + group;
+    DIR *dir = opendir(dirPath.c_str());
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_DIR || entry->d_name[0] == '.') {
+            continue;
+        }
+        walk_groups(group + "/" + entry->d_name, depth + 1);
+    }
+
+    closedir(dir);
+}
+
+static uint64_t counter_delta(uint64_t last, uint64_t now)
+{
+    return (now > last) ? now - last : 0;
+}
+
+/* What a group did since it was last read, or since it was created */
+static void group_delta(const cgroup_t& g, const cgroup_counters_t& now, cgroup_counters_t *d)
+{
+    *d = now;
+    if (g.generation == 0) {
+        return;
+    }
+
+    d->usage_usec = counter_delta(g.last.usage_usec, now.usage_usec);
+    d->user_usec = counter_delta(g.last.user_usec, now.user_usec);
+    d->system_usec = counter_delta(g.last.system_usec, now.system_usec);
+    d->nr_throttled = counter_delta(g.last.nr_throttled, now.nr_throttled);
+    d->throttled_usec = counter_delta(g.last.throttled_usec, now.throttled_usec);
+    d->stall_usec = counter_delta(g.last.stall_usec, now.stall_usec);
+    d->memory_high = counter_delta(g.last.memory_high, now.memory_high);
+    d->memory_max = counter_delta(g.last.memory_max, now.memory_max);
+    d->oom_kill = counter_delta(g.last.oom_kill, now.oom_kill);
+    d->rbytes = counter_delta(g.last.rbytes, now.rbytes);
+    d->wbytes = counter_delta(g.last.wbytes, now.wbytes);
+    d->rios = counter_delta(g.last.rios, now.rios);
+    d->wios = counter_delta(g.last.wios, now.wios);
+}
+
+/* Share of 'period_ms' that 'usec' takes, 0 to 1 */
+static float share(uint64_t usec, uint64_t period_ms)
+{
+    float s = (period_ms > 0) ? (float) usec / (float) (period_ms * 1000) : 0;
+    return (s < 1.0f) ? s : 1.0f;
+}
+
+static bool is_cgroup2(const std::string& dir)
+{
+    return access((dir + "/cgroup.controllers").c_str(), R_OK) == 0;
+}
+
+static void start_cgroup(collector_t *c, scheduler_t *sched)
+{
+    adaptive_cfg_t cfg;
+
+    adaptive_default_cfg(&cfg, (uint32_t) c->interval * 1000);
+    cfg.min_ms = CGROUP_MIN_MS;
+    cfg.max_ms = cfg.base_ms;
+    memcpy(cfg.bands, cgroup_bands, sizeof(cgroup_bands));
+    cfg.nbands = CGROUP_BANDS;
+    adaptive_init(&cgroup_cadence, &cfg);
+    cgroup_cadence.quiet = true;
+
+    tv_arena_init(&cgroup_arena, "cgroup-statistics", 0);
+    confd_agent_register_stream(sched->agent);
+
+    history_pressure = history_register("cgroup-statistics/cpu-pressure", &cgroup_cadence.cfg);
+    summary_pressure = summary_register("cgroup-statistics/cpu-pressure");
+
+    /* A hybrid setup mounts the v2 hierarchy apart, under "unified" */
+    proc_file_init(&file);
+    if (cgroup_opts.root != NULL) {
+        root = cgroup_opts.root;
+    } else if (is_cgroup2(CGROUP_ROOT)) {
+        root = CGROUP_ROOT;
+    } else if (is_cgroup2(CGROUP_ROOT "/unified")) {
+        root = CGROUP_ROOT "/unified";
+    }
+
+    if (root.empty() || !is_cgroup2(root)) {
+        std::cout << "Cgroups: no cgroup v2 hierarchy found, not streaming" << std::endl;
+        root.clear();
+    } else {
+        std::cout << "Cgroups: streaming the groups under " << root << std::endl;
+    }
+}
+
+static void append_percent(tv_arena_t *arena, uint32_t tag, float fraction)
+{
+    struct confd_decimal64 d;
+    d.value = (int64_t) (fraction * 10000 + 0.5f);
+    d.fraction_digits = 2;
+
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_DECIMAL64(tv, tag, d);
+}
+
+static void append_group(tv_arena_t *arena, const std::string& path, const cgroup_counters_t& d,
+                         uint64_t period_ms)
+{
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_cgroup, oc_proc_ext__ns);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_STR(tv, oc_proc_ext_path, path.empty() ? "/" : path.c_str());
+
+    if (d.has & CGROUP_HAS_CPU) {
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_usage_user, d.user_usec);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_usage_system, d.system_usec);
+
+        /* In percent of one core, so not capped at 100 */
+        float cores = (period_ms > 0) ? (float) d.usage_usec / (float) (period_ms * 1000) : 0;
+        append_percent(arena, oc_proc_ext_cpu_usage_percent, cores);
+
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_throttled_periods, d.nr_throttled);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_throttled_time, d.throttled_usec);
+    }
+    if (d.has & CGROUP_HAS_PRESSURE) {
+        append_percent(arena, oc_proc_ext_cpu_pressure, share(d.stall_usec, period_ms));
+    }
+    if (d.has & CGROUP_HAS_MEMORY) {
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_memory_usage, d.memory_current);
+    }
+    if (d.has & CGROUP_HAS_MEMORY_EVENTS) {
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_memory_high_events, d.memory_high);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_memory_max_events, d.memory_max);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_memory_oom_kills, d.oom_kill);
+    }
+    if (d.has & CGROUP_HAS_IO) {
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_io_read_bytes, d.rbytes);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_io_write_bytes, d.wbytes);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_io_read_ops, d.rios);
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_io_write_ops, d.wios);
+    }
+
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_cgroup, oc_proc_ext__ns);
+}
+
+static int send_notif_cgroup(collector_t *c, scheduler_t *sched)
+{
+    if (root.empty()) {
+        return CONFD_OK;
+    }
+
+    uint64_t now = monotonic_ms();
+    uint64_t periodMs = (collected_ms != 0) ? now - collected_ms : 0;
+    bool baseline = collected_ms == 0;
+    collected_ms = now;
+
+    if (++generation == 0) {
+        generation = 1;
+    }
+
+    paths.clear();
+    walk_groups("", 0);
+
+    names.clear();
+    deltas.resize(paths.size());
+
+    /* The demand: the most any group was stalled or throttled */
+    float demand = 0;
+    cgroup_counters_t counters;
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::map<std::string, cgroup_t>::iterator it =
+            groups.insert(std::make_pair(paths[i], cgroup_t())).first;
+        cgroup_t& g = it->second;
+
+        read_group(paths[i], &counters);
+        group_delta(g, counters, &deltas[i]);
+        g.last = counters;
+        g.generation = generation;
+        names.push_back(&it->first);
+
+        demand = std::max(demand, share(deltas[i].stall_usec, periodMs));
+        demand = std::max(demand, share(deltas[i].throttled_usec, periodMs));
+    }
+
+    std::map<std::string, cgroup_t>::iterator it = groups.begin();
+    while (it != groups.end()) {
+        if (it->second.generation != generation) {
+            groups.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    if (baseline) {
+        std::cout << "Cgroups: " << paths.size() << " groups, baseline taken" << std::endl;
+        logged_groups = paths.size();
+        logged_band = cgroup_cadence.band;
+        return CONFD_OK;
+    }
+
+    history_record(history_pressure, demand * 100);
+    summary_add(summary_pressure, demand * 100);
+
+    /* Rising: above its recent average */
+    adaptive_update(&cgroup_cadence, demand, !cgroup_cadence.primed || demand > cgroup_cadence.demand,
+                    now);
+
+    /* Every collection is in the history; the log only has the changes */
+    if (paths.size() != logged_groups || cgroup_cadence.band != logged_band) {
+        std::cout << "Cgroups: " << paths.size() << " groups, "
+                  << cgroup_cadence.cfg.bands[cgroup_cadence.band].name
+                  << ", most stalled or throttled " << demand * 100 << "% of " << periodMs
+                  << "ms, interval " << cgroup_cadence.interval_ms << "ms" << std::endl;
+        logged_groups = paths.size();
+        logged_band = cgroup_cadence.band;
+    }
+
+    if (!summary_raw(&cgroup_cadence)) {
+        return CONFD_OK;
+    }
+
+    tv_arena_reset(&cgroup_arena);
+    tv_arena_reserve(&cgroup_arena, names.size() * CGROUP_TAGS + 2);
+
+    confd_tag_value_t *tv = tv_arena_next(&cgroup_arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_cgroup_statistics, oc_proc_ext__ns);
+
+    /* The paths point at the keys of 'groups', which outlive the send */
+    for (size_t i = 0; i < names.size(); i++) {
+        append_group(&cgroup_arena, *names[i], deltas[i], periodMs);
+    }
+
+    tv = tv_arena_next(&cgroup_arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_cgroup_statistics, oc_proc_ext__ns);
+
+    confd_agent_send_notification(sched->agent, &cgroup_arena);
+
+    return CONFD_OK;
+}
+
+collector_t cgroup_collector = {
+    "cgroup",
+    false,                      /* adaptive */
+    CGROUP_INTERVAL,
+    false,                      /* on_demand */
+    start_cgroup,
+    send_notif_cgroup,
+    &cgroup_cadence,
+    0
+};
@@ -0,0 +1,46 @@
+/**
+ * cgroup_collector.h
+ *
+ * Streams the resource use of every control group (cgroup-statistics
+ * notification) from the cgroup v2 hierarchy: CPU time, throttling and
+ * CPU pressure (cpu.stat, cpu.pressure), memory in use and memory
+ * events (memory.current, memory.events) and block I/O (io.stat). The
+ * software agents run in groups of their own, so this attributes cost
+ * to a service at a few reads per group instead of a process scan.
+ *
+ * The counters are sent as deltas over the interval since the previous
+ * notification; the first collection only takes the baseline. The
+ * collector runs at an adaptive interval of its own, driven by the
+ * largest share of the interval that any group spent stalled
+ * (cpu.pressure "some") or throttled on CPU: the interval shortens,
+ * down to CGROUP_MIN_MS, while a service is starved.
+ *
+ * The walk goes at most CGROUP_MAX_DEPTH levels below the root and
+ * stops at CGROUP_MAX_GROUPS groups, so the cost stays bounded on a
+ * host that creates many groups.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef CGROUP_COLLECTOR_H
+#define CGROUP_COLLECTOR_H
+
+#include "scheduler.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+#define CGROUP_INTERVAL 30
+#define CGROUP_MIN_MS 2000
+#define CGROUP_MAX_DEPTH 3
+#define CGROUP_MAX_GROUPS 256
+
+struct cgroup_opts_t {
+    const char *root;           /* NULL: CGROUP_ROOT, or its "unified" mount */
+};
+
+typedef struct cgroup_opts_t cgroup_opts_t;
+
+extern cgroup_opts_t cgroup_opts;
+
+extern collector_t cgroup_collector;
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * cgroup_test.cpp
+ *
+ * Runs the cgroup collector over a synthetic cgroup v2 hierarchy and
+ * decodes the cgroup-statistics notifications it sends. cpu.stat and
+ * memory.events are read by key whatever the order and the other keys,
+ * io.stat is summed over the devices, and cpu.pressure is the "some"
+ * total. The first collection is the baseline; after it, a group sends
+ * what it did since the previous collection, a counter that went
+ * backwards counts nothing, and a group new since counts from its
+ * creation. A group sends the leaves of the files it has only. The log
+ * has the start-up and the changes of the groups or of the band, not a
+ * line per collection.
+ *
+ * The history is stubbed: this keeps the demand recorded, the largest
+ * share of the interval a group spent stalled or throttled.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "openconfig-procmon-ext.h"
+#include "cgroup_collector.h"
+#include "history.h"
+#include "proc_fixture.h"
+#include "test_agent.h"
+#include "unit_test.h"
+
+/* The leaves of a group, by tag; percentages in hundredths */
+typedef std::map<uint32_t, uint64_t> leaves_t;
+
+static std::string root;
+
+static confd_agent_t agent;
+static scheduler_t sched;
+
+static history_metric_t pressure_history;
+static std::vector<float> demands;
+
+/* The collector's notes, kept for the log checks */
+static std::ostringstream notes;
+
+history_metric_t *history_register(const char *name, const adaptive_cfg_t *cfg)
+{
+    pressure_history.name = name;
+    return &pressure_history;
+}
+
+void history_record(history_metric_t *m, float value)
+{
+    demands.push_back(value);
+}
+
+static void write_file(const std::string& group, const char *name, const std::string& data)
+{
+    std::ofstream f((root + group + "/" + name).c_str());
+    f << data;
+}
+
+static void make_group(const std::string& group)
+{
+    mkdir((root + group).c_str(), 0755);
+}
+
+/* A group's cpu.stat, in the kernel's order, with the keys not read */
+static void write_cpu(const std::string& group, uint64_t user, uint64_t system,
+                      uint64_t throttled, uint64_t throttled_usec)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "usage_usec %" PRIu64 "\nuser_usec %" PRIu64 "\nsystem_usec %" PRIu64 "\n"
+             "core_sched.force_idle_usec 0\nnr_periods 4000\nnr_throttled %" PRIu64 "\n"
+             "throttled_usec %" PRIu64 "\nnr_bursts 0\nburst_usec 0\n",
+             user + system, user, system, throttled, throttled_usec);
+    write_file(group, "cpu.stat", buf);
+}
+
+/* "full" has a total too, larger than the one of "some" */
+static void write_pressure(const std::string& group, uint64_t stall_usec)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "some avg10=1.50 avg60=0.80 avg300=0.20 total=%" PRIu64 "\n"
+             "full avg10=0.00 avg60=0.00 avg300=0.00 total=%" PRIu64 "\n",
+             stall_usec, stall_usec * 10 + 12345);
+    write_file(group, "cpu.pressure", buf);
+}
+
+/* Two devices, with the discard counters that are not read */
+static void write_io(const std::string& group, uint64_t rbytes, uint64_t wbytes,
+                     uint64_t rios, uint64_t wios)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "8:0 rbytes=%" PRIu64 " wbytes=%" PRIu64 " rios=%" PRIu64 " wios=%" PRIu64
+             " dbytes=999 dios=9\n"
+             "253:1 rbytes=%" PRIu64 " wbytes=%" PRIu64 " rios=%" PRIu64 " wios=%" PRIu64
+             " dbytes=0 dios=0\n",
+             rbytes / 4, wbytes / 2, rios - 1, wios / 2,
+             rbytes - rbytes / 4, wbytes - wbytes / 2, (uint64_t) 1, wios - wios / 2);
+    write_file(group, "io.stat", buf);
+}
+
+/* "oom" comes before, and is not, "oom_kill" */
+static void write_memory(const std::string& group, uint64_t current, uint64_t high,
+                         uint64_t max, uint64_t oom_kill)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%" PRIu64 "\n", current);
+    write_file(group, "memory.current", buf);
+    snprintf(buf, sizeof(buf),
+             "low 7\nhigh %" PRIu64 "\nmax %" PRIu64 "\noom 77\noom_kill %" PRIu64
+             "\noom_group_kill 0\n", high, max, oom_kill);
+    write_file(group, "memory.events", buf);
+}
+
+/* The groups of the last notification, by path; false if none was sent */
+static bool decode(std::map<std::string, leaves_t> *groups)
+{
+    const tv_arena_t *a = test_agent_last;
+    leaves_t *g = NULL;
+
+    groups->clear();
+    if (a == NULL || a->nvals < 2 ||
+        CONFD_GET_TAG_TAG(&a->vals[0]) != oc_proc_ext_cgroup_statistics) {
+        return false;
+    }
+
+    for (int i = 1; i < a->nvals - 1; i++) {
+        const confd_tag_value_t *tv = &a->vals[i];
+        const confd_value_t *v = CONFD_GET_TAG_VALUE(tv);
+        uint32_t tag = CONFD_GET_TAG_TAG(tv);
+
+        if (v->type == C_XMLBEGIN || v->type == C_XMLEND) {
+            g = NULL;
+        } else if (tag == oc_proc_ext_path) {
+            g = &(*groups)[v->val.s];
+        } else if (g != NULL && v->type == C_DECIMAL64) {
+            (*g)[tag] = v->val.d64.value;
+        } else if (g != NULL) {
+            (*g)[tag] = v->val.u64;
+        }
+    }
+    return true;
+}
+
+static bool leaf_is(const leaves_t& l, uint32_t tag, uint64_t value)
+{
+    leaves_t::const_iterator it = l.find(tag);
+    return it != l.end() && it->second == value;
+}
+
+/* The time collect() measures from, bounded by the test's reads of the clock */
+struct period_t {
+    uint64_t before;
+    uint64_t after;
+};
+
+typedef struct period_t period_t;
+
+static void collect(period_t *p)
+{
+    p->before = monotonic_ms();
+    CHECK(cgroup_collector.collect(&cgroup_collector, &sched) == CONFD_OK);
+    p->after = monotonic_ms();
+}
+
+/* 'usec' over the interval between two collections, in hundredths of a percent */
+static bool percent_within(const leaves_t& l, uint32_t tag, uint64_t usec,
+                           const period_t& from, const period_t& to)
+{
+    leaves_t::const_iterator it = l.find(tag);
+    if (it == l.end() || to.before <= from.after) {
+        return false;
+    }
+
+    double low = usec * 10.0 / (to.after - from.before);
+    double high = usec * 10.0 / (to.before - from.after);
+    return it->second + 1 >= low && it->second <= high + 1;
+}
+
+int main(void)
+{
+    std::streambuf *out = std::cout.rdbuf(notes.rdbuf());
+    std::map<std::string, leaves_t> groups;
+    period_t first, second, third;
+
+    root = fixture_make("cgroup_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        std::cout.rdbuf(out);
+        return test_result("cgroup_test");
+    }
+
+    /* The root, a slice with two services, and a group with CPU only */
+    write_file("", "cgroup.controllers", "cpu io memory pids\n");
+    write_cpu("", 9000000, 3000000, 0, 0);
+    make_group("/system.slice");
+    write_cpu("/system.slice", 5000000, 1000000, 0, 0);
+    make_group("/system.slice/telemetryd.service");
+    write_cpu("/system.slice/telemetryd.service", 2000000, 500000, 10, 40000);
+    write_pressure("/system.slice/telemetryd.service", 700000);
+    write_io("/system.slice/telemetryd.service", 40960, 8192, 10, 4);
+    write_memory("/system.slice/telemetryd.service", 52428800, 3, 1, 0);
+    make_group("/system.slice/confd.service");
+    write_cpu("/system.slice/confd.service", 1000000, 200000, 0, 0);
+    write_pressure("/system.slice/confd.service", 100000);
+    make_group("/user.slice");
+    write_cpu("/user.slice", 100, 100, 0, 0);
+
+    /* Below the depth walked */
+    make_group("/user.slice/user-0.slice");
+    make_group("/user.slice/user-0.slice/session-1.scope");
+    make_group("/user.slice/user-0.slice/session-1.scope/deep");
+    write_cpu("/user.slice/user-0.slice/session-1.scope/deep", 100, 100, 0, 0);
+
+    test_agent_init(&agent);
+    sched.agent = &agent;
+    cgroup_opts.root = root.c_str();
+    cgroup_collector.start(&cgroup_collector, &sched);
+    CHECK(notes.str().find("streaming the groups under " + root) != std::string::npos);
+
+    /* The baseline: nothing sent, nothing recorded */
+    unsigned long sent = test_agent_sent;
+    collect(&first);
+    CHECK(test_agent_sent == sent);
+    CHECK(demands.empty());
+    CHECK(notes.str().find("7 groups, baseline taken") != std::string::npos);
+
+    /* Nothing changed: zeros, and nothing logged but the arena growing the first time */
+    usleep(100000);
+    notes.str("");
+    collect(&second);
+    CHECK(test_agent_sent == sent + 1);
+    CHECK(decode(&groups));
+    CHECK(groups.size() == 7);
+    CHECK(leaf_is(groups["/system.slice/telemetryd.service"], oc_proc_ext_cpu_usage_user, 0));
+    CHECK(leaf_is(groups["/system.slice/telemetryd.service"], oc_proc_ext_io_read_bytes, 0));
+    CHECK(demands.size() == 1 && demands[0] == 0);
+    CHECK(notes.str().find("Cgroups") == std::string::npos);
+    CHECK(notes.str().find("Interval") == std::string::npos);
+    usleep(100000);
+    notes.str("");
+    collect(&second);
+    CHECK(test_agent_sent == sent + 2);
+    CHECK(notes.str().empty());
+    first = second;
+    sent = test_agent_sent;
+
+    /*
+     * Over the next interval: telemetryd runs 0.3 s, throttled 60 ms of
+     * it, and stalls 100 ms; confd stalls 50 ms and writes nothing.
+     */
+    usleep(200000);
+    write_cpu("/system.slice/telemetryd.service", 2200000, 600000, 13, 100000);
+    write_pressure("/system.slice/telemetryd.service", 800000);
+    write_io("/system.slice/telemetryd.service", 40960 + 4096 * 8, 8192 + 4096, 10 + 8, 4 + 2);
+    write_memory("/system.slice/telemetryd.service", 48000000, 5, 1, 1);
+    write_pressure("/system.slice/confd.service", 150000);
+    notes.str("");
+    collect(&second);
+    CHECK(test_agent_sent == sent + 1);
+    CHECK(decode(&groups));
+    CHECK(groups.size() == 7);
+    CHECK(groups.count("/") && groups.count("/user.slice/user-0.slice/session-1.scope"));
+    CHECK(!groups.count("/user.slice/user-0.slice/session-1.scope/deep"));
+
+    const leaves_t& t = groups["/system.slice/telemetryd.service"];
+    CHECK(leaf_is(t, oc_proc_ext_cpu_usage_user, 200000));
+    CHECK(leaf_is(t, oc_proc_ext_cpu_usage_system, 100000));
+    CHECK(percent_within(t, oc_proc_ext_cpu_usage_percent, 300000, first, second));
+    CHECK(leaf_is(t, oc_proc_ext_cpu_throttled_periods, 3));
+    CHECK(leaf_is(t, oc_proc_ext_cpu_throttled_time, 60000));
+    CHECK(percent_within(t, oc_proc_ext_cpu_pressure, 100000, first, second));
+    CHECK(leaf_is(t, oc_proc_ext_memory_usage, 48000000));     /* a level, not a delta */
+    CHECK(leaf_is(t, oc_proc_ext_memory_high_events, 2));
+    CHECK(leaf_is(t, oc_proc_ext_memory_max_events, 0));
+    CHECK(leaf_is(t, oc_proc_ext_memory_oom_kills, 1));
+    CHECK(leaf_is(t, oc_proc_ext_io_read_bytes, 4096 * 8));
+    CHECK(leaf_is(t, oc_proc_ext_io_write_bytes, 4096));
+    CHECK(leaf_is(t, oc_proc_ext_io_read_ops, 8));
+    CHECK(leaf_is(t, oc_proc_ext_io_write_ops, 2));
+
+    /* Unchanged: zeros. Only the leaves of the files the group has */
+    const leaves_t& c = groups["/system.slice/confd.service"];
+    CHECK(leaf_is(c, oc_proc_ext_cpu_usage_user, 0));
+    CHECK(leaf_is(c, oc_proc_ext_cpu_usage_percent, 0));
+    CHECK(percent_within(c, oc_proc_ext_cpu_pressure, 50000, first, second));
+    CHECK(!c.count(oc_proc_ext_memory_usage) && !c.count(oc_proc_ext_io_read_bytes));
+    const leaves_t& u = groups["/user.slice"];
+    CHECK(u.size() == 5 && !u.count(oc_proc_ext_cpu_pressure));
+
+    /* The demand is telemetryd's stall, the largest share of the interval */
+    CHECK(demands.size() == 3 && demands[0] == 0 && demands[1] == 0);
+    if (demands.size() == 3 && t.count(oc_proc_ext_cpu_pressure)) {
+        double stalled = t.find(oc_proc_ext_cpu_pressure)->second / 100.0;
+        CHECK(demands[2] > stalled - 0.02 && demands[2] < stalled + 0.02);
+    }
+
+    /*
+     * telemetryd restarted in a group of the same name: its counters
+     * start over and count nothing. A group new since the baseline
+     * counts from its creation. The group count changed: logged.
+     */
+    usleep(100000);
+    write_cpu("/system.slice/telemetryd.service", 1000, 1000, 0, 0);
+    write_pressure("/system.slice/telemetryd.service", 0);
+    write_io("/system.slice/telemetryd.service", 4096, 0, 1, 0);
+    write_memory("/system.slice/telemetryd.service", 4096, 0, 0, 0);
+    make_group("/system.slice/sshd.service");
+    write_cpu("/system.slice/sshd.service", 30000, 10000, 0, 0);
+    write_io("/system.slice/sshd.service", 8192, 4096, 2, 1);
+    notes.str("");
+    collect(&third);
+    CHECK(test_agent_sent == sent + 2);
+    CHECK(decode(&groups));
+    CHECK(groups.size() == 8);
+
+    const leaves_t& r = groups["/system.slice/telemetryd.service"];
+    CHECK(leaf_is(r, oc_proc_ext_cpu_usage_user, 0) && leaf_is(r, oc_proc_ext_cpu_usage_system, 0));
+    CHECK(leaf_is(r, oc_proc_ext_cpu_usage_percent, 0) && leaf_is(r, oc_proc_ext_cpu_pressure, 0));
+    CHECK(leaf_is(r, oc_proc_ext_io_read_bytes, 0) && leaf_is(r, oc_proc_ext_io_read_ops, 0));
+    CHECK(leaf_is(r, oc_proc_ext_memory_usage, 4096));
+
+    const leaves_t& s = groups["/system.slice/sshd.service"];
+    CHECK(leaf_is(s, oc_proc_ext_cpu_usage_user, 30000));
+    CHECK(leaf_is(s, oc_proc_ext_cpu_usage_system, 10000));
+    CHECK(percent_within(s, oc_proc_ext_cpu_usage_percent, 40000, second, third));
+    CHECK(leaf_is(s, oc_proc_ext_io_read_bytes, 8192) && leaf_is(s, oc_proc_ext_io_write_ops, 1));
+    CHECK(notes.str().find("Cgroups: 8 groups") != std::string::npos);
+
+    /* Counting from the lower counters; a group removed is gone, and logged */
+    write_cpu("/system.slice/telemetryd.service", 51000, 1000, 0, 0);
+    fixture_remove(root + "/system.slice/sshd.service");
+    usleep(100000);
+    notes.str("");
+    collect(&second);
+    CHECK(decode(&groups));
+    CHECK(groups.size() == 7 && !groups.count("/system.slice/sshd.service"));
+    CHECK(leaf_is(groups["/system.slice/telemetryd.service"], oc_proc_ext_cpu_usage_user, 50000));
+    CHECK(notes.str().find("Cgroups: 7 groups") != std::string::npos);
+
+    fixture_remove(root);
+
+    std::cout.rdbuf(out);
+    return test_result("cgroup_test");
+}
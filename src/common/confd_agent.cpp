@@ -0,0 +1,221 @@
+/**
+ * confd_agent.cpp
+ *
+ * ConfD plumbing shared by the streaming agents.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "confd_agent.h"
+
+static int get_confd_sock(confd_agent_t *agent, enum confd_sock_type type)
+{
+    int sock;
+
+    if ((sock = socket(PF_INET, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (confd_connect(agent->dctx, sock, type, (struct sockaddr *)&agent->addr,
+                      sizeof(struct sockaddr_in)) != CONFD_OK) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* The agent whose transactions are being served; there is one per process */
+static confd_agent_t *trans_agent;
+
+void confd_agent_init(confd_agent_t *agent, const char *name)
+{
+    agent->name = name;
+    memset(&agent->addr, 0, sizeof(agent->addr));
+    agent->dctx = NULL;
+    agent->live_ctx = NULL;
+    agent->replay_log = NULL;
+    agent->trans_registered = false;
+    agent->trans_hooks.clear();
+    agent->ctlsock = -1;
+    agent->workersock = -1;
+
+    agent->addr.sin_addr.s_addr = inet_addr(CONFD_AGENT_ADDR);
+    agent->addr.sin_family = AF_INET;
+    agent->addr.sin_port = htons(CONFD_AGENT_PORT);
+
+    confd_init(name, stderr, CONFD_TRACE);
+    OK(confd_load_schemas((struct sockaddr *)&agent->addr, sizeof(struct sockaddr_in)));
+
+    if ((agent->dctx = confd_init_daemon(name)) == NULL)
+        confd_fatal("Failed to initialize ConfD\n");
+    if ((agent->ctlsock = get_confd_sock(agent, CONTROL_SOCKET)) < 0)
+        confd_fatal("Failed to connect to ConfD\n");
+    if ((agent->workersock = get_confd_sock(agent, WORKER_SOCKET)) < 0)
+        confd_fatal("Failed to connect to ConfD\n");
+}
+
+static int get_log_times(struct confd_notification_ctx *nctx)
+{
+    return replay_log_times((replay_log_t *) nctx->cb_opaque, nctx);
+}
+
+static int replay(struct confd_notification_ctx *nctx,
+                  struct confd_datetime *start, struct confd_datetime *stop)
+{
+    return replay_log_request((replay_log_t *) nctx->cb_opaque, nctx, start, stop);
+}
+
+void confd_agent_register_stream(confd_agent_t *agent)
+{
+    struct confd_notification_stream_cbs ncb;
+
+    if (agent->live_ctx != NULL) {
+        return;
+    }
+
+    agent->replay_log = replay_log_open(REPLAY_LOG_DIR, CONFD_AGENT_STREAM);
+
+    memset(&ncb, 0, sizeof(ncb));
+    ncb.fd = agent->workersock;
+    if (agent->replay_log != NULL) {
+        ncb.get_log_times = get_log_times;
+        ncb.replay = replay;
+    }
+    strcpy(ncb.streamname, CONFD_AGENT_STREAM);
+    ncb.cb_opaque = agent->replay_log;
+
+    if (confd_register_notification_stream(agent->dctx, &ncb, &agent->live_ctx) != CONFD_OK) {
+        confd_fatal("Couldn't register stream %s\n", ncb.streamname);
+    }
+}
+
+void confd_agent_register_done(confd_agent_t *agent)
+{
+    if (confd_register_done(agent->dctx) != CONFD_OK) {
+        confd_fatal("Failed to complete registration\n");
+    }
+}
+
+static int trans_init(struct confd_trans_ctx *tctx)
+{
+    confd_trans_set_fd(tctx, trans_agent->workersock);
+
+    for (size_t i = 0; i < trans_agent->trans_hooks.size(); i++) {
+        trans_agent->trans_hooks[i].fn(trans_agent->trans_hooks[i].opaque);
+    }
+    return CONFD_OK;
+}
+
+static int trans_finish(struct confd_trans_ctx *tctx)
+{
+    return CONFD_OK;
+}
+
+void confd_agent_register_data(confd_agent_t *agent, struct confd_data_cbs *data,
+                               confd_agent_trans_hook_t hook, void *opaque)
+{
+    if (!agent->trans_registered) {
+        struct confd_trans_cbs trans;
+
+        memset(&trans, 0, sizeof(trans));
+        trans.init = trans_init;
+        trans.finish = trans_finish;
+        OK(confd_register_trans_cb(agent->dctx, &trans));
+
+        trans_agent = agent;
+        agent->trans_registered = true;
+    }
+
+    if (hook != NULL) {
+        confd_agent_hook_t h;
+        h.fn = hook;
+        h.opaque = opaque;
+        agent->trans_hooks.push_back(h);
+    }
+
+    OK(confd_register_data_cb(agent->dctx, data));
+}
+
+int confd_agent_cdb_connect(confd_agent_t *agent, enum cdb_sock_type type, const char *name)
+{
+    int sock;
+
+    if ((sock = socket(PF_INET, SOCK_STREAM, 0)) < 0) {
+        confd_fatal("Failed to create socket");
+    }
+
+    OK(cdb_connect_name(sock, type, (struct sockaddr *)&agent->addr,
+                        sizeof(struct sockaddr_in), name));
+    return sock;
+}
+
+static void getdatetime(struct confd_datetime *datetime, const struct timeval *tv)
+{
+    struct tm tm;
+
+    gmtime_r(&tv->tv_sec, &tm);
+
+    memset(datetime, 0, sizeof(*datetime));
+    datetime->year = 1900 + tm.tm_year;
+    datetime->month = tm.tm_mon + 1;
+    datetime->day = tm.tm_mday;
+    datetime->sec = tm.tm_sec;
+    datetime->micro = tv->tv_usec;
+    datetime->timezone = 0;
+    datetime->timezone_minutes = 0;
+    datetime->hour = tm.tm_hour;
+    datetime->min = tm.tm_min;
+}
+
+void confd_agent_send_notification(confd_agent_t *agent, tv_arena_t *arena)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    confd_agent_send_notification_at(agent, arena, &tv);
+}
+
+void confd_agent_send_notification_at(confd_agent_t *agent, tv_arena_t *arena,
+                                      const struct timeval *when)
+{
+    struct confd_datetime eventTime;
+
+    getdatetime(&eventTime, when);
+
+    OK(confd_notification_send(agent->live_ctx,
+                               &eventTime,
+                               arena->vals,
+                               arena->nvals));
+
+    if (agent->replay_log != NULL) {
+        replay_log_append(agent->replay_log, (uint64_t) when->tv_sec * 1000000 + when->tv_usec,
+                          arena->vals, arena->nvals);
+    }
+}
+
+static void confd_agent_ready(int fd, uint32_t events, void *opaque)
+{
+    confd_agent_t *agent = (confd_agent_t *) opaque;
+
+    if (confd_fd_ready(agent->dctx, fd) == CONFD_EOF)
+        confd_fatal("ConfD closed the %s socket\n",
+                    (fd == agent->ctlsock) ? "control" : "worker");
+}
+
+void confd_agent_attach(confd_agent_t *agent, reactor_t *reactor)
+{
+    if (reactor_add_fd(reactor, agent->ctlsock, EPOLLIN, confd_agent_ready, agent) < 0 ||
+        reactor_add_fd(reactor, agent->workersock, EPOLLIN, confd_agent_ready, agent) < 0) {
+        confd_fatal("Failed to watch the ConfD sockets\n");
+    }
+    if (agent->replay_log != NULL) {
+        replay_log_attach(agent->replay_log, reactor);
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * confd_agent.h
+ *
+ * ConfD plumbing shared by the streaming agents: one daemon context
+ * with its control and worker sockets, the threshold-stream
+ * notification context and a CDB data socket, all connected to the
+ * local ConfD.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef CONFD_AGENT_H
+#define CONFD_AGENT_H
+
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/time.h>
+
+#include <confd_lib.h>
+#include <confd_dp.h>
+#include <confd_cdb.h>
+
+#include "tv_arena.h"
+#include "reactor.h"
+#include "replay_log.h"
+
+#define CONFD_AGENT_ADDR "127.0.0.1"
+#define CONFD_AGENT_PORT 51015
+#define CONFD_AGENT_STREAM "threshold-stream"
+
+/* Called when a data provider transaction starts, e.g. to refresh a cache */
+typedef void (*confd_agent_trans_hook_t)(void *opaque);
+
+struct confd_agent_hook_t {
+    confd_agent_trans_hook_t fn;
+    void *opaque;
+};
+
+typedef struct confd_agent_hook_t confd_agent_hook_t;
+
+#define OK(rval) do {                                                   \
+        if ((rval) != CONFD_OK)                                         \
+            confd_fatal("error not CONFD_OK: %d : %s\n",                \
+                        confd_errno, confd_lasterr());                  \
+    } while (0);
+
+struct confd_agent_t {
+    const char *name;
+    struct sockaddr_in addr;
+    struct confd_daemon_ctx *dctx;
+    int ctlsock;
+    int workersock;
+    struct confd_notification_ctx *live_ctx;    /* NULL until registered */
+    replay_log_t *replay_log;                   /* NULL without replay */
+
+    /* Transaction callbacks, shared by every callpoint of the daemon */
+    bool trans_registered;
+    std::vector<confd_agent_hook_t> trans_hooks;
+};
+
+typedef struct confd_agent_t confd_agent_t;
+
+/* Connects the daemon context; exits through confd_fatal() on failure */
+void confd_agent_init(confd_agent_t *agent, const char *name);
+
+/*
+ * Registers CONFD_AGENT_STREAM, once, however many collectors ask, with
+ * replay served from the log in REPLAY_LOG_DIR (see replay_log.h).
+ */
+void confd_agent_register_stream(confd_agent_t *agent);
+void confd_agent_register_done(confd_agent_t *agent);
+
+/*
+ * Registers a callpoint. A daemon has a single set of transaction
+ * callbacks, registered with the first callpoint; 'hook' (may be NULL)
+ * runs at the start of every transaction.
+ */
+void confd_agent_register_data(confd_agent_t *agent, struct confd_data_cbs *data,
+                               confd_agent_trans_hook_t hook, void *opaque);
+
+/* A new CDB socket of "type", named after the caller for "confd --status" */
+int confd_agent_cdb_connect(confd_agent_t *agent, enum cdb_sock_type type, const char *name);
+
+void confd_agent_send_notification(confd_agent_t *agent, tv_arena_t *arena);
+
+/* The same, for something that happened at 'when' rather than now */
+void confd_agent_send_notification_at(confd_agent_t *agent, tv_arena_t *arena,
+                                      const struct timeval *when);
+
+/* Service the control and worker sockets, and replays, from 'reactor' */
+void confd_agent_attach(confd_agent_t *agent, reactor_t *reactor);
+
+#endif
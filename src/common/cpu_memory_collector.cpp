@@ -0,0 +1,102 @@
+/**
+ * cpu_memory_collector.cpp
+ *
+ * Streams the overall CPU utilization, summed over the process table
+ * shared with the process-statistics collector, and the memory
+ * utilization from /proc/meminfo.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cmath>
+#include <iostream>
+
+#include "openconfig-procmon-ext.h"
+#include "cpu_memory_collector.h"
+#include "history.h"
+#include "summary_collector.h"
+
+/* Encode buffer reused by every system-overall-cpu-memory notification */
+static tv_arena_t cpu_memory_arena;
+
+static history_metric_t *history_cpu, *history_memory;
+static summary_metric_t *summary_cpu, *summary_memory;
+
+static void start_cpu_memory(collector_t *c, scheduler_t *sched)
+{
+    const adaptive_cfg_t *cfg = &sched->adaptive.cfg;
+
+    tv_arena_init(&cpu_memory_arena, "system-overall-cpu-memory", 4);
+    confd_agent_register_stream(sched->agent);
+
+    history_cpu = history_register("system-overall-cpu-memory/cpu-utilization", cfg);
+    history_memory = history_register("system-overall-cpu-memory/memory-utilization", cfg);
+
+    summary_cpu = summary_register("system-overall-cpu-memory/cpu-utilization");
+    summary_memory = summary_register("system-overall-cpu-memory/memory-utilization");
+}
+
+static int send_notif_cpu_memory(collector_t *c, scheduler_t *sched)
+{
+    const proc_table_t& processes = sampler_processes(sched->sampler);
+    const mem_info_t& mem = sampler_meminfo(sched->sampler);
+
+    float total_cpu_utilization = 0.0;
+    float total_mem_utilization = 0.0;
+
+    /* One column of the table, nothing else is touched */
+    for (size_t i = 0; i < processes.cpu_pct.size(); i++) {
+        total_cpu_utilization += processes.cpu_pct[i];
+    }
+
+    /* Summing per-process shares would count shared pages many times */
+    if (mem.total > 0 && mem.available < mem.total) {
+        total_mem_utilization = (float) (mem.total - mem.available) * 100 / mem.total;
+    }
+
+    std::cout << "CPU Utilization: " << total_cpu_utilization << std::endl;
+    std::cout << "Memory Utilization: " << total_mem_utilization << std::endl;
+
+    history_record(history_cpu, total_cpu_utilization);
+    history_record(history_memory, total_mem_utilization);
+
+    summary_add(summary_cpu, total_cpu_utilization);
+    summary_add(summary_memory, total_mem_utilization);
+
+    if (!summary_raw(&sched->adaptive)) {
+        return CONFD_OK;
+    }
+
+    tv_arena_reset(&cpu_memory_arena);
+
+    confd_tag_value_t *cpuMemTag = tv_arena_next(&cpu_memory_arena);
+    CONFD_SET_TAG_XMLBEGIN(cpuMemTag, oc_proc_ext_system_overall_cpu_memory, oc_proc_ext__ns);
+
+    struct confd_decimal64 cpuMem;
+    cpuMem.value = total_cpu_utilization * pow(10, 2);
+    cpuMem.fraction_digits = 2;
+    cpuMemTag = tv_arena_next(&cpu_memory_arena);
+    CONFD_SET_TAG_DECIMAL64(cpuMemTag, oc_proc_ext_cpu_utilization, cpuMem);
+    cpuMem.value = total_mem_utilization * pow(10, 2);
+    cpuMem.fraction_digits = 2;
+    cpuMemTag = tv_arena_next(&cpu_memory_arena);
+    CONFD_SET_TAG_DECIMAL64(cpuMemTag, oc_proc_ext_memory_utilization, cpuMem);
+
+    cpuMemTag = tv_arena_next(&cpu_memory_arena);
+    CONFD_SET_TAG_XMLEND(cpuMemTag, oc_proc_ext_system_overall_cpu_memory, oc_proc_ext__ns);
+
+    /* Emit the notification */
+    confd_agent_send_notification(sched->agent, &cpu_memory_arena);
+
+    return CONFD_OK;
+}
+
+collector_t cpu_memory_collector = {
+    "cpu-memory",
+    true,                       /* adaptive */
+    INTERVAL,
+    false,                      /* on_demand */
+    start_cpu_memory,
+    send_notif_cpu_memory,
+    NULL,                       /* cadence */
+    0
+};
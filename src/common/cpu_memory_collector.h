@@ -0,0 +1,17 @@
+/**
+ * cpu_memory_collector.h
+ *
+ * Streams the overall CPU and memory utilization
+ * (system-overall-cpu-memory notification) at the adaptive stream
+ * interval.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef CPU_MEMORY_COLLECTOR_H
+#define CPU_MEMORY_COLLECTOR_H
+
+#include "scheduler.h"
+
+extern collector_t cpu_memory_collector;
+
+#endif
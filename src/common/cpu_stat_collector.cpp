@@ -0,0 +1,201 @@
+/**
+ * cpu_stat_collector.cpp
+ *
+ * Populates /oc-sys:system/oc-sys:cpus/oc-sys:cpu with the per-core
+ * and aggregate CPU utilization.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "openconfig-system.h"
+#include "cpu_stat_collector.h"
+
+/* Container of each metric under /system/cpus/cpu/state */
+static const uint32_t metric_tags[CPU_METRICS] = {
+    oc_sys_total,
+    oc_sys_user,
+    oc_sys_kernel,
+    oc_sys_nice,
+    oc_sys_idle,
+    oc_sys_wait,
+    oc_sys_hardware_interrupt,
+    oc_sys_software_interrupt
+};
+
+/* index, then begin, instant, avg, min, max, interval, end per metric */
+#define CPU_TAGS (1 + CPU_METRICS * 7)
+
+static int cdb_sock = -1;
+
+/* Core numbers of the entries in CDB, in sampler order (-1 is ALL) */
+static std::vector<int> written_cpus;
+
+/*
+ * The last CPU_STAT_WINDOW percentages of every entry and metric, at
+ * history[(entry * CPU_METRICS + metric) * CPU_STAT_WINDOW + slot]
+ */
+static std::vector<uint8_t> history;
+static uint64_t periods_ms[CPU_STAT_WINDOW];   /* what each slot was sampled over */
+static int samples;
+static int slot;
+
+static void cpu_key(int index, char *key, size_t len)
+{
+    if (index < 0) {
+        snprintf(key, len, "ALL");
+    } else {
+        snprintf(key, len, "%d", index);
+    }
+}
+
+static bool same_cpus(const std::vector<cpu_usage_t>& cpus)
+{
+    if (cpus.size() != written_cpus.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i].index != written_cpus[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Cores went on- or offline (or first run): recreate the list */
+static void sync_cpus(int sock, const std::vector<cpu_usage_t>& cpus)
+{
+    char key[16];
+
+    if (cdb_exists(sock, "/system/cpus") == 1) {
+        OK(cdb_delete(sock, "/system/cpus"));
+    }
+
+    written_cpus.clear();
+    for (size_t i = 0; i < cpus.size(); i++) {
+        cpu_key(cpus[i].index, key, sizeof(key));
+        OK(cdb_create(sock, "/system/cpus/cpu{%s}", key));
+        written_cpus.push_back(cpus[i].index);
+    }
+
+    history.assign(cpus.size() * CPU_METRICS * CPU_STAT_WINDOW, 0);
+    samples = 0;
+    slot = 0;
+}
+
+static void record_sample(const std::vector<cpu_usage_t>& cpus, uint64_t period_ms)
+{
+    for (size_t i = 0; i < cpus.size(); i++) {
+        uint8_t *h = &history[i * CPU_METRICS * CPU_STAT_WINDOW + slot];
+        for (int m = 0; m < CPU_METRICS; m++) {
+            float pct = cpus[i].pct[m];
+            h[m * CPU_STAT_WINDOW] = (uint8_t) ((pct > 100.0f ? 100.0f : pct) + 0.5f);
+        }
+    }
+
+    periods_ms[slot] = period_ms;
+
+    if (samples < CPU_STAT_WINDOW) {
+        samples++;
+    }
+}
+
+/* The time the window covers; the interval may have changed within it */
+static uint64_t window_ms(void)
+{
+    uint64_t ms = 0;
+
+    for (int s = 0; s < samples; s++) {
+        ms += periods_ms[s];
+    }
+    return ms;
+}
+
+static int cpu_state(size_t entry, int index, uint64_t window_ns, confd_tag_value_t *tv)
+{
+    int n = 0;
+
+    if (index < 0) {
+        CONFD_SET_TAG_ENUM_VALUE(&tv[n], oc_sys_index, oc_sys_ALL); n++;
+    } else {
+        CONFD_SET_TAG_UINT32(&tv[n], oc_sys_index, (uint32_t) index); n++;
+    }
+
+    for (int m = 0; m < CPU_METRICS; m++) {
+        const uint8_t *h = &history[(entry * CPU_METRICS + m) * CPU_STAT_WINDOW];
+        unsigned int sum = 0;
+        uint8_t lo = 100, hi = 0;
+
+        for (int s = 0; s < samples; s++) {
+            sum += h[s];
+            lo = (h[s] < lo) ? h[s] : lo;
+            hi = (h[s] > hi) ? h[s] : hi;
+        }
+
+        CONFD_SET_TAG_XMLBEGIN(&tv[n], metric_tags[m], oc_sys__ns); n++;
+        CONFD_SET_TAG_UINT8(&tv[n], oc_sys_instant, h[slot]); n++;
+        CONFD_SET_TAG_UINT8(&tv[n], oc_sys_avg, (uint8_t) ((sum + samples / 2) / samples)); n++;
+        CONFD_SET_TAG_UINT8(&tv[n], oc_sys_min, lo); n++;
+        CONFD_SET_TAG_UINT8(&tv[n], oc_sys_max, hi); n++;
+        CONFD_SET_TAG_UINT64(&tv[n], oc_sys_interval, window_ns); n++;
+        CONFD_SET_TAG_XMLEND(&tv[n], metric_tags[m], oc_sys__ns); n++;
+    }
+
+    return n;
+}
+
+static int populate_cpus(collector_t *c, scheduler_t *sched)
+{
+    const std::vector<cpu_usage_t>& cpus = sampler_cpu_usage(sched->sampler);
+
+    /* The first sample is the average since boot */
+    if (cpus.empty() || sched->sampler->cpu_period_ms == 0) {
+        return CONFD_OK;
+    }
+
+    if (cdb_sock < 0) {
+        cdb_sock = confd_agent_cdb_connect(sched->agent, CDB_DATA_SOCKET,
+                                           "system_cpus_state_monitor");
+    }
+    OK(cdb_start_session(cdb_sock, CDB_OPERATIONAL));
+    OK(cdb_set_namespace(cdb_sock, oc_sys__ns));
+
+    if (!same_cpus(cpus)) {
+        sync_cpus(cdb_sock, cpus);
+    }
+
+    record_sample(cpus, sched->sampler->cpu_period_ms);
+
+    uint64_t window_ns = window_ms() * 1000000;
+    confd_tag_value_t tv[CPU_TAGS];
+    char key[16];
+
+    for (size_t i = 0; i < cpus.size(); i++) {
+        int n = cpu_state(i, cpus[i].index, window_ns, tv);
+
+        cpu_key(cpus[i].index, key, sizeof(key));
+        OK(cdb_set_values(cdb_sock, tv, n, "/system/cpus/cpu{%s}/state", key));
+    }
+
+    OK(cdb_end_session(cdb_sock));
+
+    slot = (slot + 1) % CPU_STAT_WINDOW;
+
+    std::cout << "CPU busy: " << cpus[0].pct[CPU_TOTAL] << "% over "
+              << cpus.size() - 1 << " cores" << std::endl;
+
+    return CONFD_OK;
+}
+
+collector_t cpu_stat_collector = {
+    "cpu-stat",
+    false,                      /* adaptive */
+    CPU_STAT_INTERVAL,
+    false,                      /* on_demand */
+    NULL,
+    populate_cpus,
+    NULL,                       /* cadence */
+    0
+};
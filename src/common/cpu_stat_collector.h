@@ -0,0 +1,21 @@
+/**
+ * cpu_stat_collector.h
+ *
+ * Populates /oc-sys:system/oc-sys:cpus/oc-sys:cpu from /proc/stat
+ * counter deltas: one entry per online core plus cpu{ALL}, each with
+ * the instant, average, minimum and maximum utilization over the last
+ * CPU_STAT_WINDOW samples.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef CPU_STAT_COLLECTOR_H
+#define CPU_STAT_COLLECTOR_H
+
+#include "scheduler.h"
+
+#define CPU_STAT_INTERVAL 5
+#define CPU_STAT_WINDOW 12
+
+extern collector_t cpu_stat_collector;
+
+#endif
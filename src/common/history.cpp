@@ -0,0 +1,378 @@
+/**
+ * history.cpp
+ *
+ * Bounded metric history and its data provider.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <iostream>
+
+#include <sys/time.h>
+
+#include "openconfig-procmon-ext.h"
+#include "history.h"
+
+/* Samples returned per get_next_object() round-trip */
+#define HISTORY_OBJECTS_PER_REPLY 256
+
+/* seq, time, avg, min, max */
+#define SAMPLE_TAGS 5
+
+static std::vector<history_metric_t *> metrics;
+
+static const uint32_t tier_enums[HISTORY_TIERS] = {
+    oc_proc_ext_raw,
+    oc_proc_ext_one_minute,
+    oc_proc_ext_fifteen_minutes
+};
+
+static uint64_t wall_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void ring_init(history_ring_t *r, uint32_t capacity, uint64_t period_ms)
+{
+    r->points = (history_point_t *) calloc(capacity, sizeof(history_point_t));
+    if (r->points == NULL) {
+        confd_fatal("Failed to allocate %u history samples\n", capacity);
+    }
+    r->capacity = capacity;
+    r->period_ms = period_ms;
+    r->written = 0;
+    r->acc_count = 0;
+}
+
+static void ring_push(history_ring_t *r, const history_point_t *p)
+{
+    r->points[r->written % r->capacity] = *p;
+    r->written++;
+}
+
+static uint64_t ring_oldest(const history_ring_t *r)
+{
+    return (r->written > r->capacity) ? r->written - r->capacity : 0;
+}
+
+static const history_point_t *ring_at(const history_ring_t *r, uint64_t seq)
+{
+    return &r->points[seq % r->capacity];
+}
+
+/* Fold one value into the period in progress, closing the previous one */
+static void ring_downsample(history_ring_t *r, uint64_t now, float value)
+{
+    uint64_t start = now - now % r->period_ms;
+
+    if (r->acc_count > 0 && r->acc.time_ms != start) {
+        r->acc.avg /= r->acc_count;
+        ring_push(r, &r->acc);
+        r->acc_count = 0;
+    }
+
+    if (r->acc_count == 0) {
+        r->acc.time_ms = start;
+        r->acc.avg = 0;
+        r->acc.min = value;
+        r->acc.max = value;
+    }
+    r->acc.avg += value;
+    r->acc.min = (value < r->acc.min) ? value : r->acc.min;
+    r->acc.max = (value > r->acc.max) ? value : r->acc.max;
+    r->acc_count++;
+}
+
+/* A day at the base interval, an hour at the minimum one, whichever is more */
+static uint32_t raw_capacity(const adaptive_cfg_t *cfg)
+{
+    uint32_t base = (cfg->base_ms > 0) ? cfg->base_ms : 1;
+    uint32_t min = (cfg->min_ms > 0 && cfg->min_ms < base) ? cfg->min_ms : base;
+    uint32_t day = HISTORY_RAW_DAY_MS / base, hour = HISTORY_RAW_MIN_SPAN_MS / min;
+
+    return (day > hour) ? day : hour;
+}
+
+history_metric_t *history_register(const char *name, const adaptive_cfg_t *cfg)
+{
+    history_metric_t *m = new history_metric_t;
+
+    m->name = name;
+    ring_init(&m->tiers[HISTORY_RAW], raw_capacity(cfg), 0);
+    ring_init(&m->tiers[HISTORY_ONE_MINUTE], HISTORY_MINUTE_SAMPLES, 60 * 1000);
+    ring_init(&m->tiers[HISTORY_FIFTEEN_MINUTES], HISTORY_QUARTER_SAMPLES, 15 * 60 * 1000);
+
+    metrics.push_back(m);
+    return m;
+}
+
+void history_record(history_metric_t *m, float value)
+{
+    history_point_t p;
+
+    p.time_ms = wall_ms();
+    p.avg = p.min = p.max = value;
+    ring_push(&m->tiers[HISTORY_RAW], &p);
+
+    for (int t = HISTORY_ONE_MINUTE; t < HISTORY_TIERS; t++) {
+        ring_downsample(&m->tiers[t], p.time_ms, value);
+    }
+}
+
+/*
+ * Data provider
+ *
+ * Keypaths, leaf first:
+ *   metric{M}/name                        [name][{M}][metric]...
+ *   metric{M}/tier{T}/capacity            [capacity][{T}][tier][{M}][metric]...
+ *   metric{M}/tier{T}/sample{S}/avg       [avg][{S}][sample][{T}][tier][{M}][metric]...
+ * A sample is keyed, and its 'next' is, the sequence number of the
+ * point, so entries dropped between two calls do not shift the
+ * iteration and a wall clock step cannot give two points one key.
+ */
+static history_metric_t *find_metric(const confd_value_t *key)
+{
+    for (size_t i = 0; i < metrics.size(); i++) {
+        if (metrics[i]->name.size() == CONFD_GET_BUFSIZE(key) &&
+            memcmp(metrics[i]->name.data(), CONFD_GET_BUFPTR(key), CONFD_GET_BUFSIZE(key)) == 0) {
+            return metrics[i];
+        }
+    }
+    return NULL;
+}
+
+static history_ring_t *find_tier(history_metric_t *m, const confd_value_t *key)
+{
+    if (m == NULL) {
+        return NULL;
+    }
+    for (int t = 0; t < HISTORY_TIERS; t++) {
+        if (tier_enums[t] == (uint32_t) CONFD_GET_ENUM_VALUE(key)) {
+            return &m->tiers[t];
+        }
+    }
+    return NULL;
+}
+
+/* The point numbered 'seq', if it is still in the ring */
+static const history_point_t *find_sample(const history_ring_t *r, uint64_t seq)
+{
+    if (seq < ring_oldest(r) || seq >= r->written) {
+        return NULL;
+    }
+    return ring_at(r, seq);
+}
+
+static void set_decimal(confd_value_t *v, float value)
+{
+    struct confd_decimal64 d;
+    d.value = (int64_t) (value * 100 + (value < 0 ? -0.5f : 0.5f));
+    d.fraction_digits = 2;
+    CONFD_SET_DECIMAL64(v, d);
+}
+
+static int sample_to_tags(const history_ring_t *r, uint64_t seq, confd_tag_value_t *tv)
+{
+    const history_point_t *p = ring_at(r, seq);
+    int n = 0;
+
+    CONFD_SET_TAG_UINT64(&tv[n], oc_proc_ext_seq, seq); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_proc_ext_time, p->time_ms); n++;
+    tv[n].tag.tag = oc_proc_ext_avg; tv[n].tag.ns = 0;
+    set_decimal(&tv[n].v, p->avg); n++;
+    tv[n].tag.tag = oc_proc_ext_min; tv[n].tag.ns = 0;
+    set_decimal(&tv[n].v, p->min); n++;
+    tv[n].tag.tag = oc_proc_ext_max; tv[n].tag.ns = 0;
+    set_decimal(&tv[n].v, p->max); n++;
+
+    return n;
+}
+
+static int get_next(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp, long next)
+{
+    long i = (next == -1) ? 0 : next;
+    confd_value_t key;
+
+    switch (CONFD_GET_XMLTAG(&kp->v[0][0])) {
+    case oc_proc_ext_metric:
+        if (i >= (long) metrics.size()) {
+            break;
+        }
+        CONFD_SET_STR(&key, metrics[i]->name.c_str());
+        return confd_data_reply_next_key(tctx, &key, 1, i + 1);
+
+    case oc_proc_ext_tier:
+        if (i >= HISTORY_TIERS || find_metric(&kp->v[1][0]) == NULL) {
+            break;
+        }
+        CONFD_SET_ENUM_VALUE(&key, tier_enums[i]);
+        return confd_data_reply_next_key(tctx, &key, 1, i + 1);
+
+    case oc_proc_ext_sample: {
+        history_ring_t *r = find_tier(find_metric(&kp->v[3][0]), &kp->v[1][0]);
+        if (r == NULL) {
+            break;
+        }
+        uint64_t seq = (next == -1 || (uint64_t) next < ring_oldest(r)) ? ring_oldest(r) : next;
+        if (seq >= r->written) {
+            break;
+        }
+        CONFD_SET_UINT64(&key, seq);
+        return confd_data_reply_next_key(tctx, &key, 1, (long) seq + 1);
+    }
+    }
+
+    return confd_data_reply_next_key(tctx, NULL, -1, -1);
+}
+
+static int get_elem(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp)
+{
+    confd_value_t v;
+
+    switch (CONFD_GET_XMLTAG(&kp->v[0][0])) {
+    case oc_proc_ext_name: {
+        history_metric_t *m = find_metric(&kp->v[1][0]);
+        if (m == NULL) {
+            return confd_data_reply_not_found(tctx);
+        }
+        CONFD_SET_STR(&v, m->name.c_str());
+        break;
+    }
+    case oc_proc_ext_resolution:
+    case oc_proc_ext_capacity: {
+        history_ring_t *r = find_tier(find_metric(&kp->v[3][0]), &kp->v[1][0]);
+        if (r == NULL) {
+            return confd_data_reply_not_found(tctx);
+        }
+        if (CONFD_GET_XMLTAG(&kp->v[0][0]) == oc_proc_ext_capacity) {
+            CONFD_SET_UINT32(&v, r->capacity);
+        } else {
+            v = kp->v[1][0];
+        }
+        break;
+    }
+    default: {
+        history_ring_t *r = find_tier(find_metric(&kp->v[5][0]), &kp->v[3][0]);
+        const history_point_t *p = (r == NULL) ? NULL : find_sample(r, CONFD_GET_UINT64(&kp->v[1][0]));
+        if (p == NULL) {
+            return confd_data_reply_not_found(tctx);
+        }
+        switch (CONFD_GET_XMLTAG(&kp->v[0][0])) {
+        case oc_proc_ext_seq:
+            v = kp->v[1][0];
+            break;
+        case oc_proc_ext_time:
+            CONFD_SET_UINT64(&v, p->time_ms);
+            break;
+        case oc_proc_ext_avg:
+            set_decimal(&v, p->avg);
+            break;
+        case oc_proc_ext_min:
+            set_decimal(&v, p->min);
+            break;
+        case oc_proc_ext_max:
+            set_decimal(&v, p->max);
+            break;
+        default:
+            return confd_data_reply_not_found(tctx);
+        }
+    }
+    }
+
+    return confd_data_reply_value(tctx, &v);
+}
+
+/* Samples go HISTORY_OBJECTS_PER_REPLY to a round-trip, a day in a few */
+static int get_next_sample_objects(struct confd_trans_ctx *tctx, const history_ring_t *r, long next)
+{
+    uint64_t first = (next == -1 || (uint64_t) next < ring_oldest(r)) ? ring_oldest(r) : next;
+    uint64_t last = first + HISTORY_OBJECTS_PER_REPLY;
+
+    if (last > r->written) {
+        last = r->written;
+    }
+    if (first >= last) {
+        return confd_data_reply_next_object_tag_value_array(tctx, NULL, -1, -1);
+    }
+
+    std::vector<confd_tag_value_t> tv((last - first) * SAMPLE_TAGS);
+    std::vector<struct confd_tag_next_object> objs;
+    objs.reserve(last - first + 1);
+
+    for (uint64_t seq = first; seq < last; seq++) {
+        struct confd_tag_next_object obj;
+        obj.tv = &tv[(seq - first) * SAMPLE_TAGS];
+        obj.n = sample_to_tags(r, seq, obj.tv);
+        obj.next = (long) seq + 1;
+        objs.push_back(obj);
+    }
+
+    if (last == r->written) {
+        struct confd_tag_next_object end;
+        end.tv = NULL;
+        end.n = 0;
+        end.next = -1;
+        objs.push_back(end);
+    }
+
+    return confd_data_reply_next_object_tag_value_arrays(tctx, &objs[0], objs.size(), 0);
+}
+
+static int get_next_object(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp, long next)
+{
+    long i = (next == -1) ? 0 : next;
+    confd_tag_value_t tv[2];
+
+    switch (CONFD_GET_XMLTAG(&kp->v[0][0])) {
+    case oc_proc_ext_metric:
+        if (i >= (long) metrics.size()) {
+            break;
+        }
+        CONFD_SET_TAG_STR(&tv[0], oc_proc_ext_name, metrics[i]->name.c_str());
+        return confd_data_reply_next_object_tag_value_array(tctx, tv, 1, i + 1);
+
+    case oc_proc_ext_tier: {
+        history_metric_t *m = find_metric(&kp->v[1][0]);
+        if (i >= HISTORY_TIERS || m == NULL) {
+            break;
+        }
+        CONFD_SET_TAG_ENUM_VALUE(&tv[0], oc_proc_ext_resolution, tier_enums[i]);
+        CONFD_SET_TAG_UINT32(&tv[1], oc_proc_ext_capacity, m->tiers[i].capacity);
+        return confd_data_reply_next_object_tag_value_array(tctx, tv, 2, i + 1);
+    }
+
+    case oc_proc_ext_sample: {
+        history_ring_t *r = find_tier(find_metric(&kp->v[3][0]), &kp->v[1][0]);
+        if (r != NULL) {
+            return get_next_sample_objects(tctx, r, next);
+        }
+        break;
+    }
+    }
+
+    return confd_data_reply_next_object_tag_value_array(tctx, NULL, -1, -1);
+}
+
+void history_start(scheduler_t *sched)
+{
+    struct confd_data_cbs data;
+
+    memset(&data, 0, sizeof(data));
+    strcpy(data.callpoint, "history_cp");
+    data.get_elem = get_elem;
+    data.get_next = get_next;
+    data.get_next_object = get_next_object;
+    confd_agent_register_data(sched->agent, &data, NULL, NULL);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < metrics.size(); i++) {
+        for (int t = 0; t < HISTORY_TIERS; t++) {
+            bytes += metrics[i]->tiers[t].capacity * sizeof(history_point_t);
+        }
+    }
+    std::cout << "History: " << metrics.size() << " metrics, " << bytes / 1024 << " kB" << std::endl;
+}
@@ -0,0 +1,82 @@
+/**
+ * history.h
+ *
+ * Bounded in-memory history of the streamed metrics, served as
+ * /oc-proc-ext:history through the history_cp callpoint so that a
+ * subscriber can backfill the gap left by a reconnect in one read.
+ *
+ * Every metric keeps three tiers: the raw values, and 1-minute and
+ * 15-minute downsampled periods (average, minimum and maximum). Each
+ * tier is a ring of fixed-size points allocated once at registration
+ * and overwritten oldest first, so memory stays the same however long
+ * the agent runs. Points are keyed by their sequence number in the
+ * tier, not by their time, which the wall clock may step back to.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <inttypes.h>
+#include <string>
+
+#include "scheduler.h"
+
+/*
+ * The raw tier holds a day of samples at the base interval, and at
+ * least an hour of them at the minimum interval, however fast an
+ * adaptive collector streams
+ */
+#define HISTORY_RAW_DAY_MS 86400000
+#define HISTORY_RAW_MIN_SPAN_MS 3600000
+
+#define HISTORY_MINUTE_SAMPLES 1440     /* a day */
+#define HISTORY_QUARTER_SAMPLES 672     /* a week */
+
+enum {
+    HISTORY_RAW,
+    HISTORY_ONE_MINUTE,
+    HISTORY_FIFTEEN_MINUTES,
+    HISTORY_TIERS
+};
+
+struct history_point_t {
+    uint64_t time_ms;           /* wall clock; period start when downsampled */
+    float avg;
+    float min;
+    float max;
+};
+
+typedef struct history_point_t history_point_t;
+
+struct history_ring_t {
+    history_point_t *points;
+    uint32_t capacity;
+    uint64_t period_ms;         /* 0 for the raw tier */
+    uint64_t written;           /* points ever pushed; the newest is written - 1 */
+
+    /* Downsampling period in progress; avg holds the running sum */
+    history_point_t acc;
+    uint32_t acc_count;
+};
+
+typedef struct history_ring_t history_ring_t;
+
+struct history_metric_t {
+    std::string name;           /* <notification>/<leaf> */
+    history_ring_t tiers[HISTORY_TIERS];
+};
+
+typedef struct history_metric_t history_metric_t;
+
+/*
+ * 'cfg' holds the base and minimum interval of the collector; for a
+ * fixed interval, both are the same
+ */
+history_metric_t *history_register(const char *name, const adaptive_cfg_t *cfg);
+void history_record(history_metric_t *m, float value);
+
+/* Registers the history_cp callpoint, before confd_register_done() */
+void history_start(scheduler_t *sched);
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * intern.cpp
+ *
+ * Pool of interned, reference counted strings.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <set>
+
+#include "intern.h"
+
+struct entry_less {
+    bool operator()(const istr_entry_t *a, const istr_entry_t *b) const
+    {
+        return a->str < b->str;
+    }
+};
+
+typedef std::set<istr_entry_t *, entry_less> istr_pool_t;
+
+static istr_pool_t pool;
+static size_t pool_bytes;
+
+/* Lookup key; its buffer is reused, so a hit does not allocate */
+static istr_entry_t probe;
+
+static void release(istr_entry_t *e)
+{
+    if (e != NULL && --e->refs == 0) {
+        pool.erase(e);
+        pool_bytes -= e->str.size();
+        delete e;
+    }
+}
+
+istr_t::istr_t(const istr_t& other) : entry(other.entry)
+{
+    if (entry != NULL) {
+        entry->refs++;
+    }
+}
+
+istr_t::~istr_t()
+{
+    release(entry);
+}
+
+istr_t& istr_t::operator=(const istr_t& other)
+{
+    if (other.entry != NULL) {
+        other.entry->refs++;
+    }
+    release(entry);
+    entry = other.entry;
+    return *this;
+}
+
+static istr_t intern(const char *str, size_t len, unsigned int fields)
+{
+    istr_t s;
+
+    if (len == 0) {
+        return s;
+    }
+
+    probe.str.assign(str, len);
+    istr_pool_t::iterator it = pool.find(&probe);
+    if (it != pool.end()) {
+        s.entry = *it;
+    } else {
+        s.entry = new istr_entry_t;
+        s.entry->str = probe.str;
+        s.entry->refs = 0;
+        s.entry->fields = fields;
+        pool.insert(s.entry);
+        pool_bytes += len;
+    }
+
+    s.entry->refs++;
+    return s;
+}
+
+istr_t istr_intern(const char *str, size_t len)
+{
+    return intern(str, len, 1);
+}
+
+istr_t istr_intern_fields(const char *fields, size_t len)
+{
+    unsigned int n = (len > 0) ? 1 : 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (fields[i] == '\0') {
+            n++;
+        }
+    }
+    return intern(fields, len, n);
+}
+
+unsigned int istr_fields(const istr_t& s)
+{
+    return (s.entry != NULL) ? s.entry->fields : 0;
+}
+
+const char *istr_next_field(const istr_t& s, const char *prev)
+{
+    if (s.entry == NULL) {
+        return NULL;
+    }
+
+    const char *first = s.entry->str.c_str();
+    const char *next = (prev == NULL) ? first : prev + strlen(prev) + 1;
+    return (next < first + s.entry->str.size()) ? next : NULL;
+}
+
+size_t istr_pool_count(void)
+{
+    return pool.size();
+}
+
+size_t istr_pool_bytes(void)
+{
+    return pool_bytes;
+}
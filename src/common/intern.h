@@ -0,0 +1,65 @@
+/**
+ * intern.h
+ *
+ * Pool of interned, reference counted strings. Interning a string that
+ * is already pooled returns the same entry, so equal strings compare
+ * equal by pointer and copying an istr_t costs a reference count
+ * instead of an allocation. An entry is freed with its last reference.
+ *
+ * A string can also hold several NUL separated fields (an argv); the
+ * number of fields is counted once when it is interned.
+ *
+ * The pool is not thread safe.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <cstddef>
+#include <string>
+
+struct istr_entry_t {
+    std::string str;
+    unsigned int refs;
+    unsigned int fields;
+};
+
+typedef struct istr_entry_t istr_entry_t;
+
+/* A reference to a pooled string; the default is the empty string */
+struct istr_t {
+    istr_entry_t *entry;
+
+    istr_t() : entry(NULL) {}
+    istr_t(const istr_t& other);
+    ~istr_t();
+    istr_t& operator=(const istr_t& other);
+
+    bool operator==(const istr_t& other) const { return entry == other.entry; }
+    bool operator!=(const istr_t& other) const { return entry != other.entry; }
+
+    const char *c_str() const { return (entry != NULL) ? entry->str.c_str() : ""; }
+    size_t size() const { return (entry != NULL) ? entry->str.size() : 0; }
+};
+
+typedef struct istr_t istr_t;
+
+istr_t istr_intern(const char *str, size_t len);
+
+/*
+ * 'len' bytes of NUL separated fields, none of them empty and the last
+ * one not followed by a NUL, e.g. "ls\0-l".
+ */
+istr_t istr_intern_fields(const char *fields, size_t len);
+
+unsigned int istr_fields(const istr_t& s);
+
+/* The field after 'prev', the first one if NULL; NULL past the last */
+const char *istr_next_field(const istr_t& s, const char *prev);
+
+/* Pool size, for diagnostics */
+size_t istr_pool_count(void);
+size_t istr_pool_bytes(void);
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * intern_test.cpp
+ *
+ * Checks the interned string pool: equal strings share one entry, the
+ * entry is freed with its last reference, and the fields of an argv
+ * are walked in order.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "intern.h"
+#include "unit_test.h"
+
+static void test_sharing(void)
+{
+    size_t count = istr_pool_count();
+
+    istr_t a = istr_intern("sshd", 4);
+    istr_t b = istr_intern("sshd-extra", 4);    /* only the first 4 bytes */
+    istr_t c = istr_intern("confd", 5);
+
+    CHECK(a == b);
+    CHECK(a.entry == b.entry);
+    CHECK(a.c_str() == b.c_str());
+    CHECK(a != c);
+    CHECK(strcmp(a.c_str(), "sshd") == 0);
+    CHECK(a.size() == 4);
+    CHECK(a.entry->refs == 2);
+    CHECK(istr_pool_count() == count + 2);
+
+    /* The empty string is not pooled */
+    istr_t e = istr_intern("", 0);
+    istr_t d;
+    CHECK(e.entry == NULL);
+    CHECK(e == d);
+    CHECK(strcmp(e.c_str(), "") == 0);
+    CHECK(e.size() == 0);
+    CHECK(istr_pool_count() == count + 2);
+}
+
+static void test_release(void)
+{
+    size_t count = istr_pool_count();
+    size_t bytes = istr_pool_bytes();
+
+    {
+        istr_t a = istr_intern("telemetryd", 10);
+        CHECK(istr_pool_count() == count + 1);
+        CHECK(istr_pool_bytes() == bytes + 10);
+
+        {
+            istr_t b(a);                        /* copy */
+            istr_t c;
+            c = a;                              /* assignment */
+            CHECK(a.entry->refs == 3);
+            CHECK(b == a && c == a);
+        }
+        CHECK(a.entry->refs == 1);
+        CHECK(istr_pool_count() == count + 1);
+
+        /* Self-assignment keeps the entry */
+        a = a;
+        CHECK(a.entry != NULL && a.entry->refs == 1);
+        CHECK(strcmp(a.c_str(), "telemetryd") == 0);
+
+        /* Reassignment releases the last reference to the old entry */
+        a = istr_intern("confd", 5);
+        CHECK(istr_pool_count() == count + 1);
+        CHECK(istr_pool_bytes() == bytes + 5);
+    }
+
+    /* Released with its last reference */
+    CHECK(istr_pool_count() == count);
+    CHECK(istr_pool_bytes() == bytes);
+
+    /* Interned again after release: a new entry, the same string */
+    istr_t a = istr_intern("telemetryd", 10);
+    CHECK(a.entry->refs == 1);
+    CHECK(strcmp(a.c_str(), "telemetryd") == 0);
+
+    /* References held by a container */
+    {
+        std::vector<istr_t> v(100, a);
+        CHECK(a.entry->refs == 101);
+    }
+    CHECK(a.entry->refs == 1);
+}
+
+static std::vector<std::string> fields_of(const istr_t& s)
+{
+    std::vector<std::string> v;
+
+    for (const char *f = istr_next_field(s, NULL); f != NULL; f = istr_next_field(s, f)) {
+        v.push_back(f);
+    }
+    return v;
+}
+
+static void test_fields(void)
+{
+    const char argv[] = "/usr/sbin/sshd\0-D\0-o\0LogLevel=INFO";
+    istr_t s = istr_intern_fields(argv, sizeof(argv) - 1);
+
+    CHECK(istr_fields(s) == 4);
+
+    std::vector<std::string> v = fields_of(s);
+    CHECK(v.size() == 4);
+    CHECK(v.size() == 4 && v[0] == "/usr/sbin/sshd" && v[1] == "-D" &&
+          v[2] == "-o" && v[3] == "LogLevel=INFO");
+
+    /* The same argv is the same entry */
+    istr_t t = istr_intern_fields(argv, sizeof(argv) - 1);
+    CHECK(s == t);
+
+    /* One field */
+    istr_t one = istr_intern_fields("init", 4);
+    CHECK(istr_fields(one) == 1);
+    v = fields_of(one);
+    CHECK(v.size() == 1 && v[0] == "init");
+
+    /* A single character per field */
+    istr_t small = istr_intern_fields("a\0b\0c", 5);
+    CHECK(istr_fields(small) == 3);
+    v = fields_of(small);
+    CHECK(v.size() == 3 && v[0] == "a" && v[1] == "b" && v[2] == "c");
+
+    /* No fields */
+    istr_t none = istr_intern_fields("", 0);
+    CHECK(istr_fields(none) == 0);
+    CHECK(istr_next_field(none, NULL) == NULL);
+
+    istr_t empty;
+    CHECK(istr_fields(empty) == 0);
+    CHECK(istr_next_field(empty, NULL) == NULL);
+
+    /* istr_intern() makes a string of one field */
+    istr_t name = istr_intern("sshd", 4);
+    CHECK(istr_fields(name) == 1);
+    CHECK(istr_next_field(name, NULL) == name.c_str());
+    CHECK(istr_next_field(name, name.c_str()) == NULL);
+}
+
+int main(void)
+{
+    test_sharing();
+    test_release();
+    test_fields();
+
+    CHECK(istr_pool_count() == 0);
+    CHECK(istr_pool_bytes() == 0);
+
+    return test_result("intern_test");
+}
@@ -0,0 +1,98 @@
+/**
+ * load_avg_collector.cpp
+ *
+ * Streams the system load averages.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cmath>
+#include <iostream>
+
+#include "openconfig-procmon-ext.h"
+#include "load_avg_collector.h"
+#include "history.h"
+#include "summary_collector.h"
+
+/* Encode buffer reused by every system-load-average notification */
+static tv_arena_t load_avg_arena;
+
+static history_metric_t *history_1min, *history_5min, *history_15min;
+static summary_metric_t *summary_1min, *summary_5min, *summary_15min;
+
+static void start_load_avg(collector_t *c, scheduler_t *sched)
+{
+    const adaptive_cfg_t *cfg = &sched->adaptive.cfg;
+
+    tv_arena_init(&load_avg_arena, "system-load-average", 5);
+    confd_agent_register_stream(sched->agent);
+
+    history_1min = history_register("system-load-average/avg-1-min", cfg);
+    history_5min = history_register("system-load-average/avg-5-min", cfg);
+    history_15min = history_register("system-load-average/avg-15-min", cfg);
+
+    summary_1min = summary_register("system-load-average/avg-1-min");
+    summary_5min = summary_register("system-load-average/avg-5-min");
+    summary_15min = summary_register("system-load-average/avg-15-min");
+}
+
+static int send_notif_load_avg(collector_t *c, scheduler_t *sched)
+{
+    const load_avg_t& loadAverages = sampler_load_avg(sched->sampler);
+
+    history_record(history_1min, loadAverages.load_avg_1min);
+    history_record(history_5min, loadAverages.load_avg_5min);
+    history_record(history_15min, loadAverages.load_avg_15min);
+
+    summary_add(summary_1min, loadAverages.load_avg_1min);
+    summary_add(summary_5min, loadAverages.load_avg_5min);
+    summary_add(summary_15min, loadAverages.load_avg_15min);
+
+    if (!summary_raw(&sched->adaptive)) {
+        return CONFD_OK;
+    }
+
+    tv_arena_reset(&load_avg_arena);
+
+    confd_tag_value_t *loadAvg = tv_arena_next(&load_avg_arena);
+    CONFD_SET_TAG_XMLBEGIN(loadAvg, oc_proc_ext_system_load_average, oc_proc_ext__ns);
+
+    std::cout << "1-min: " << loadAverages.load_avg_1min << std::endl;
+    std::cout << "5-min: " << loadAverages.load_avg_5min << std::endl;
+    std::cout << "15-min: " << loadAverages.load_avg_15min << std::endl;
+
+    confd_tag_value_t *loadAvg1Min = tv_arena_next(&load_avg_arena);
+    struct confd_decimal64 min1;
+    min1.value = loadAverages.load_avg_1min * pow(10, 2);
+    min1.fraction_digits = 2;
+    CONFD_SET_TAG_DECIMAL64(loadAvg1Min, oc_proc_ext_avg_1_min, min1);
+
+    confd_tag_value_t *loadAvg5Min = tv_arena_next(&load_avg_arena);
+    struct confd_decimal64 min5;
+    min5.value = loadAverages.load_avg_5min * pow(10, 2);
+    min5.fraction_digits = 2;
+    CONFD_SET_TAG_DECIMAL64(loadAvg5Min, oc_proc_ext_avg_5_min, min5);
+
+    confd_tag_value_t *loadAvg15Min = tv_arena_next(&load_avg_arena);
+    struct confd_decimal64 min15;
+    min15.value = loadAverages.load_avg_15min * pow(10, 2);
+    min15.fraction_digits = 2;
+    CONFD_SET_TAG_DECIMAL64(loadAvg15Min, oc_proc_ext_avg_15_min, min15);
+
+    loadAvg = tv_arena_next(&load_avg_arena);
+    CONFD_SET_TAG_XMLEND(loadAvg, oc_proc_ext_system_load_average, oc_proc_ext__ns);
+
+    confd_agent_send_notification(sched->agent, &load_avg_arena);
+
+    return CONFD_OK;
+}
+
+collector_t load_avg_collector = {
+    "load-avg",
+    true,                       /* adaptive */
+    INTERVAL,
+    false,                      /* on_demand */
+    start_load_avg,
+    send_notif_load_avg,
+    NULL,                       /* cadence */
+    0
+};
@@ -0,0 +1,16 @@
+/**
+ * load_avg_collector.h
+ *
+ * Streams the system load averages (system-load-average notification)
+ * at the adaptive stream interval.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef LOAD_AVG_COLLECTOR_H
+#define LOAD_AVG_COLLECTOR_H
+
+#include "scheduler.h"
+
+extern collector_t load_avg_collector;
+
+#endif
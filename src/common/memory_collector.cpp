@@ -0,0 +1,205 @@
+/**
+ * memory_collector.cpp
+ *
+ * Streams the system memory utilization from /proc/meminfo.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <dirent.h>
+
+#include "openconfig-system.h"
+#include "openconfig-procmon-ext.h"
+#include "memory_collector.h"
+#include "history.h"
+#include "summary_collector.h"
+#include "proc_reader.h"
+
+#define SYS_MEMORY_ROOT "/sys/devices/system/memory"
+
+/* Shorten the interval by a third above 75% in use, and halve it above 90% */
+static const adaptive_band_t memory_bands[] = {
+    { "normal",   0.0f,  1.0f,        1.0f },
+    { "elevated", 0.75f, 1.0f / 1.5f, 1.0f },
+    { "critical", 0.9f,  1.0f / 2.0f, 1.0f }
+};
+
+#define MEMORY_BANDS ((int) (sizeof(memory_bands) / sizeof(memory_bands[0])))
+
+static adaptive_interval_t memory_cadence;
+
+/* Encode buffer reused by every system-memory notification */
+static tv_arena_t memory_arena;
+
+static history_metric_t *history_memory;
+static summary_metric_t *summary_memory;
+
+static int cdb_sock = -1;
+static uint64_t written_physical;
+static uint64_t written_reserved;
+
+/* The online memory, and the MemTotal it was counted for */
+static uint64_t online_bytes;
+static uint64_t online_total_kb;
+
+static void start_memory(collector_t *c, scheduler_t *sched)
+{
+    adaptive_cfg_t cfg;
+
+    adaptive_default_cfg(&cfg, (uint32_t) c->interval * 1000);
+    cfg.min_ms = MEMORY_MIN_MS;
+    cfg.max_ms = cfg.base_ms;
+    memcpy(cfg.bands, memory_bands, sizeof(memory_bands));
+    cfg.nbands = MEMORY_BANDS;
+    adaptive_init(&memory_cadence, &cfg);
+
+    tv_arena_init(&memory_arena, "system-memory", 6);
+    confd_agent_register_stream(sched->agent);
+
+    history_memory = history_register("system-memory/memory-utilization", &memory_cadence.cfg);
+    summary_memory = summary_register("system-memory/memory-utilization");
+}
+
+/*
+ * The memory handed to the kernel: the online memory blocks, 0 where
+ * the kernel does not list them (no memory hotplug)
+ */
+static uint64_t online_memory(void)
+{
+    proc_file_t file;
+    uint64_t blockSize = 0, blocks = 0;
+    char path[128];
+    struct dirent *de;
+    DIR *dir;
+
+    proc_file_init(&file);
+    if (proc_file_read_path(&file, SYS_MEMORY_ROOT "/block_size_bytes") > 0) {
+        std::string hex(file.buf, file.len);
+        blockSize = strtoull(hex.c_str(), NULL, 16);
+    }
+
+    if (blockSize > 0 && (dir = opendir(SYS_MEMORY_ROOT)) != NULL) {
+        while ((de = readdir(dir)) != NULL) {
+            if (strncmp(de->d_name, "memory", 6) != 0 || de->d_name[6] < '0' || de->d_name[6] > '9') {
+                continue;
+            }
+            snprintf(path, sizeof(path), SYS_MEMORY_ROOT "/%s/online", de->d_name);
+            if (proc_file_read_path(&file, path) > 0 && file.buf[0] == '1') {
+                blocks++;
+            }
+        }
+        closedir(dir);
+    }
+    proc_file_free(&file);
+
+    return blocks * blockSize;
+}
+
+/*
+ * Reserved for system use: online memory the kernel keeps out of
+ * MemTotal (its own image, the crash kernel, firmware regions). Only
+ * counted again when MemTotal changes, i.e. after a hotplug.
+ */
+static uint64_t reserved_memory(const mem_info_t& mem)
+{
+    if (mem.total != online_total_kb) {
+        online_bytes = online_memory();
+        online_total_kb = mem.total;
+    }
+    return (online_bytes > mem.total * 1024) ? online_bytes - mem.total * 1024 : 0;
+}
+
+/* Only rewritten when a value changed; physical hardly ever does */
+static void populate_memory_state(scheduler_t *sched, uint64_t physical, uint64_t reserved)
+{
+    confd_tag_value_t tv[2];
+    int n = 0;
+
+    if (cdb_sock < 0) {
+        cdb_sock = confd_agent_cdb_connect(sched->agent, CDB_DATA_SOCKET,
+                                           "system_memory_state_monitor");
+    } else if (physical == written_physical && reserved == written_reserved) {
+        return;
+    }
+
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_physical, physical); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_reserved, reserved); n++;
+
+    OK(cdb_start_session(cdb_sock, CDB_OPERATIONAL));
+    OK(cdb_set_namespace(cdb_sock, oc_sys__ns));
+    OK(cdb_set_values(cdb_sock, tv, n, "/system/memory/state"));
+    OK(cdb_end_session(cdb_sock));
+
+    written_physical = physical;
+    written_reserved = reserved;
+}
+
+static int send_notif_memory(collector_t *c, scheduler_t *sched)
+{
+    const mem_info_t& mem = sampler_meminfo(sched->sampler);
+
+    if (mem.total == 0) {
+        return CONFD_OK;
+    }
+
+    uint64_t physical = mem.total * 1024;
+    uint64_t available = (mem.available < mem.total ? mem.available : mem.total) * 1024;
+    uint64_t swapUsed = (mem.swap_total > mem.swap_free ? mem.swap_total - mem.swap_free : 0) * 1024;
+    float used = (float) (physical - available) / (float) physical;
+
+    std::cout << "Memory in use: " << used * 100 << "% of " << mem.total << " kB" << std::endl;
+
+    populate_memory_state(sched, physical, reserved_memory(mem));
+
+    history_record(history_memory, used * 100);
+    summary_add(summary_memory, used * 100);
+
+    /* Rising: above its recent average */
+    adaptive_update(&memory_cadence, used, !memory_cadence.primed || used > memory_cadence.demand,
+                    monotonic_ms());
+
+    if (!summary_raw(&memory_cadence)) {
+        return CONFD_OK;
+    }
+
+    tv_arena_reset(&memory_arena);
+
+    confd_tag_value_t *memTag = tv_arena_next(&memory_arena);
+    CONFD_SET_TAG_XMLBEGIN(memTag, oc_proc_ext_system_memory, oc_proc_ext__ns);
+
+    struct confd_decimal64 utilization;
+    utilization.value = (int64_t) (used * 10000 + 0.5f);
+    utilization.fraction_digits = 2;
+    memTag = tv_arena_next(&memory_arena);
+    CONFD_SET_TAG_DECIMAL64(memTag, oc_proc_ext_memory_utilization, utilization);
+
+    memTag = tv_arena_next(&memory_arena);
+    CONFD_SET_TAG_UINT64(memTag, oc_proc_ext_physical, physical);
+    memTag = tv_arena_next(&memory_arena);
+    CONFD_SET_TAG_UINT64(memTag, oc_proc_ext_available, available);
+    memTag = tv_arena_next(&memory_arena);
+    CONFD_SET_TAG_UINT64(memTag, oc_proc_ext_swap_used, swapUsed);
+
+    memTag = tv_arena_next(&memory_arena);
+    CONFD_SET_TAG_XMLEND(memTag, oc_proc_ext_system_memory, oc_proc_ext__ns);
+
+    confd_agent_send_notification(sched->agent, &memory_arena);
+
+    return CONFD_OK;
+}
+
+collector_t memory_collector = {
+    "memory",
+    false,                      /* adaptive */
+    MEMORY_INTERVAL,
+    false,                      /* on_demand */
+    start_memory,
+    send_notif_memory,
+    &memory_cadence,
+    0
+};
@@ -0,0 +1,28 @@
+/**
+ * memory_collector.h
+ *
+ * Populates /oc-sys:system/oc-sys:memory/oc-sys:state from
+ * /proc/meminfo and streams the system-memory notification. The
+ * collector runs at an adaptive interval of its own, driven by the
+ * share of memory in use: while memory use climbs past the
+ * thresholds the interval shortens, down to MEMORY_MIN_MS, so a memory
+ * pressure episode is streamed closely without any process scan.
+ *
+ * physical is MemTotal, and reserved is what the kernel holds back
+ * from it: the online memory blocks of /sys/devices/system/memory
+ * less MemTotal, or 0 without memory hotplug. The memory in use is in
+ * the notification, as physical less available.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef MEMORY_COLLECTOR_H
+#define MEMORY_COLLECTOR_H
+
+#include "scheduler.h"
+
+#define MEMORY_INTERVAL 10
+#define MEMORY_MIN_MS 1000
+
+extern collector_t memory_collector;
+
+#endif
@@ -0,0 +1,270 @@
+/**
+ * proc_bench.cpp
+ *
+ * Microbenchmark for the /proc sampling layer. Compares the
+ * original system("cat ... > tmpfile") + ifstream sampling used by
+ * the agents against the pread(2) based proc_reader, then times full
+ * process scans with 1, 2, 4 and 8 scan workers, over a synthetic
+ * /proc of many processes and over the real one.
+ *
+ * Usage: proc_bench [iterations] [fixture-processes]
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+
+#include "proc_reader.h"
+#include "proc_scan.h"
+
+#define ITERATIONS 2000
+#define FIXTURE_PROCESSES 4000
+
+static double now_sec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * The agents named the file with tmpnam(); mkstemp() takes its place
+ * here, as the linker warns about tmpnam() and the fork dominates the
+ * cost of the legacy path either way.
+ */
+static std::string createTempFileName(void)
+{
+    char buffer[] = "/tmp/proc_bench.XXXXXX";
+    int fd = mkstemp(buffer);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(1);
+    }
+    close(fd);
+    return std::string(buffer);
+}
+
+/* The sampling path the agents used before proc_reader */
+static load_avg_t legacy_load_average(void)
+{
+    std::string tmpFilename = createTempFileName();
+    std::string cmd = "cat /proc/loadavg > " + tmpFilename;
+    system(cmd.c_str());
+
+    load_avg_t loadAverages;
+    memset(&loadAverages, 0, sizeof(loadAverages));
+
+    std::ifstream inFile(tmpFilename.c_str());
+    std::string line;
+    if (std::getline(inFile, line)) {
+        std::istringstream iss(line);
+        std::string load1Min, load5Min, load15Min;
+
+        iss >> load1Min >> load5Min >> load15Min;
+        loadAverages.load_avg_1min = atof(load1Min.c_str());
+        loadAverages.load_avg_5min = atof(load5Min.c_str());
+        loadAverages.load_avg_15min = atof(load15Min.c_str());
+    }
+
+    inFile.close();
+    remove(tmpFilename.c_str());
+    return loadAverages;
+}
+
+static void legacy_usage_time(std::string pid, uint64_t& userTime, uint64_t& kernelTime)
+{
+    std::string statFilename = createTempFileName();
+    std::string cmd = "cat /proc/" + pid + "/stat" + " > " + statFilename;
+    system(cmd.c_str());
+
+    std::ifstream inFile(statFilename.c_str());
+    std::string line;
+    std::getline(inFile, line);
+    std::istringstream iss(line);
+
+    int count = 13;
+    std::string token;
+    while (count-- != 0) {
+        iss >> token;
+    }
+
+    iss >> token;
+    userTime = (uint64_t) atoi(token.c_str());
+    iss >> token;
+    kernelTime = (uint64_t) atoi(token.c_str());
+
+    inFile.close();
+    remove(statFilename.c_str());
+}
+
+static void report(const char *name, int samples, double elapsed)
+{
+    std::cout << "  " << name << ": " << samples << " samples in "
+              << elapsed << "s (" << (samples / elapsed) << " samples/sec)"
+              << std::endl;
+}
+
+static void write_file(const std::string& path, const char *data, size_t len)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (f != NULL) {
+        fwrite(data, 1, len, f);
+        fclose(f);
+    }
+}
+
+/* A /proc with the files the scanner reads, for 'processes' processes */
+static std::string make_fixture(int processes)
+{
+    char root[] = "/tmp/proc_bench.XXXXXX";
+    char buf[512];
+    int n;
+
+    if (mkdtemp(root) == NULL) {
+        return "";
+    }
+
+    std::string dir(root);
+    n = snprintf(buf, sizeof(buf), "MemTotal:       16303428 kB\n");
+    write_file(dir + "/meminfo", buf, n);
+    n = snprintf(buf, sizeof(buf), "864000.00 1700000.00\n");
+    write_file(dir + "/uptime", buf, n);
+
+    for (int pid = 1; pid <= processes; pid++) {
+        char pidDir[64];
+        snprintf(pidDir, sizeof(pidDir), "/%d", pid);
+        std::string d = dir + pidDir;
+        mkdir(d.c_str(), 0755);
+
+        n = snprintf(buf, sizeof(buf),
+                     "%d (agent-%d) S 1 %d %d 0 -1 4194560 %d 0 0 0 %d %d 0 0 20 0 4 0 %d "
+                     "123456789 2048 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 0 0 0 0 0 0\n",
+                     pid, pid % 97, pid, pid, pid * 3, pid % 500, pid % 200, 100 + pid);
+        write_file(d + "/stat", buf, n);
+        n = snprintf(buf, sizeof(buf), "30000 2048 512 64 0 4096 0\n");
+        write_file(d + "/statm", buf, n);
+        n = snprintf(buf, sizeof(buf), "/usr/bin/agent-%d%c--config%c/etc/agent.conf", pid % 97, 0, 0);
+        write_file(d + "/cmdline", buf, n);
+    }
+
+    return dir;
+}
+
+static void bench_scans(const char *root, int scans)
+{
+    static const unsigned int workers[] = { 1, 2, 4, 8 };
+    double single = 0;
+
+    for (size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); i++) {
+        proc_scanner_t ps;
+
+        if (proc_scanner_init(&ps, root) < 0) {
+            std::cout << "  cannot scan " << root << std::endl;
+            return;
+        }
+        int used = proc_scanner_set_workers(&ps, workers[i]);
+
+        /* The first scan resolves every identity, as an agent does once */
+        proc_scan_processes(&ps);
+
+        double start = now_sec();
+        for (int n = 0; n < scans; n++) {
+            proc_scan_processes(&ps);
+        }
+        double elapsed = now_sec() - start;
+        if (workers[i] == 1) {
+            single = elapsed;
+        }
+
+        std::cout << "  " << workers[i] << " worker(s) (" << used << " used): " << scans
+                  << " scans of " << proc_table_rows(&ps.table) << " processes in " << elapsed << "s ("
+                  << (scans / elapsed) << " scans/sec), speedup " << (single / elapsed) << "x"
+                  << std::endl;
+        proc_scanner_free(&ps);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = ITERATIONS;
+    if (argc > 1)
+        iterations = atoi(argv[1]);
+    if (iterations <= 0)
+        iterations = ITERATIONS;
+
+    int fixtureProcesses = FIXTURE_PROCESSES;
+    if (argc > 2)
+        fixtureProcesses = atoi(argv[2]);
+    if (fixtureProcesses <= 0)
+        fixtureProcesses = FIXTURE_PROCESSES;
+
+    /* The legacy path forks per sample, keep its run short */
+    int legacyIterations = iterations / 20 + 1;
+
+    char pid[32];
+    snprintf(pid, sizeof(pid), "%d", (int) getpid());
+
+    uint64_t userTime = 0, kernelTime = 0;
+    load_avg_t loadAverages;
+    double start, before, after;
+
+    std::cout << "/proc/loadavg" << std::endl;
+
+    start = now_sec();
+    for (int i = 0; i < legacyIterations; i++) {
+        loadAverages = legacy_load_average();
+    }
+    before = now_sec() - start;
+    report("before (system+tmpfile)", legacyIterations, before);
+
+    start = now_sec();
+    for (int i = 0; i < iterations; i++) {
+        proc_read_loadavg(&loadAverages);
+    }
+    after = now_sec() - start;
+    report("after  (pread)         ", iterations, after);
+    std::cout << "  speedup: " << (iterations / after) / (legacyIterations / before) << "x" << std::endl;
+
+    std::cout << "/proc/<pid>/stat" << std::endl;
+
+    start = now_sec();
+    for (int i = 0; i < legacyIterations; i++) {
+        legacy_usage_time(pid, userTime, kernelTime);
+    }
+    before = now_sec() - start;
+    report("before (system+tmpfile)", legacyIterations, before);
+
+    start = now_sec();
+    for (int i = 0; i < iterations; i++) {
+        proc_read_pid_times((uint64_t) getpid(), &userTime, &kernelTime);
+    }
+    after = now_sec() - start;
+    report("after  (pread)         ", iterations, after);
+    std::cout << "  speedup: " << (iterations / after) / (legacyIterations / before) << "x" << std::endl;
+
+    /* A scan reads every process, keep the runs comparable to the above */
+    int scans = iterations / 100 + 1;
+
+    std::string fixture = make_fixture(fixtureProcesses);
+    if (!fixture.empty()) {
+        std::cout << "process scan, synthetic /proc (" << fixture << ")" << std::endl;
+        bench_scans(fixture.c_str(), scans);
+
+        std::string cmd = "rm -rf " + fixture;
+        system(cmd.c_str());
+    }
+
+    std::cout << "process scan, " << PROC_ROOT << std::endl;
+    bench_scans(PROC_ROOT, scans);
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * proc_connector.cpp
+ *
+ * Process lifecycle events from the kernel proc connector.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include "proc_connector.h"
+
+/* Large enough for a batch of messages, each a single event */
+#define PROC_CONNECTOR_BUFSZ 8192
+
+static int send_op(int fd, enum proc_cn_mcast_op op)
+{
+    char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))];
+    struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+    struct cn_msg *msg = (struct cn_msg *) NLMSG_DATA(nlh);
+
+    memset(buf, 0, sizeof(buf));
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    nlh->nlmsg_type = NLMSG_DONE;
+    nlh->nlmsg_pid = getpid();
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(op);
+    memcpy(msg + 1, &op, sizeof(op));
+
+    return (send(fd, buf, nlh->nlmsg_len, 0) < 0) ? -1 : 0;
+}
+
+int proc_connector_open(void)
+{
+    struct sockaddr_nl addr;
+    int rcvbuf = PROC_CONNECTOR_RCVBUF;
+    int fd;
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = 0;            /* assigned by the kernel */
+
+    /* Best effort: a smaller buffer only drops events sooner */
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        send_op(fd, PROC_CN_MCAST_LISTEN) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    return fd;
+}
+
+void proc_connector_close(int fd)
+{
+    if (fd >= 0) {
+        send_op(fd, PROC_CN_MCAST_IGNORE);
+        close(fd);
+    }
+}
+
+/* Translate one kernel event; false for those not about a process */
+static bool translate(const struct proc_event *ev, proc_event_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->time_ns = ev->timestamp_ns;
+
+    switch (ev->what) {
+    case proc_event::PROC_EVENT_FORK:
+        if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid) {
+            return false;       /* a new thread */
+        }
+        out->type = PROC_EV_FORK;
+        out->pid = ev->event_data.fork.child_tgid;
+        out->ppid = ev->event_data.fork.parent_tgid;
+        return true;
+
+    case proc_event::PROC_EVENT_EXEC:
+        out->type = PROC_EV_EXEC;
+        out->pid = ev->event_data.exec.process_tgid;
+        return true;
+
+    case proc_event::PROC_EVENT_EXIT:
+        if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) {
+            return false;       /* a thread other than the leader */
+        }
+        out->type = PROC_EV_EXIT;
+        out->pid = ev->event_data.exit.process_tgid;
+
+        /* exit_code is a wait(2) status */
+        if ((ev->event_data.exit.exit_code & 0x7f) != 0) {
+            out->exit_status = -1;
+            out->exit_signal = ev->event_data.exit.exit_code & 0x7f;
+        } else {
+            out->exit_status = (ev->event_data.exit.exit_code >> 8) & 0xff;
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+int proc_connector_read(int fd, std::vector<proc_event_t>& events)
+{
+    /* Netlink messages are aligned on 4 bytes, the events on 8 */
+    uint64_t buf[PROC_CONNECTOR_BUFSZ / sizeof(uint64_t)];
+
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        size_t len = n;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, len);
+             nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_NOOP || nlh->nlmsg_type == NLMSG_ERROR) {
+                continue;
+            }
+
+            const struct cn_msg *msg = (const struct cn_msg *) NLMSG_DATA(nlh);
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC ||
+                msg->len < sizeof(struct proc_event)) {
+                continue;
+            }
+
+            proc_event_t ev;
+            if (translate((const struct proc_event *) (msg + 1), &ev)) {
+                events.push_back(ev);
+            }
+        }
+    }
+}
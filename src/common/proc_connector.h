@@ -0,0 +1,54 @@
+/**
+ * proc_connector.h
+ *
+ * Process lifecycle events from the kernel proc connector
+ * (NETLINK_CONNECTOR, CN_IDX_PROC). The kernel multicasts an event for
+ * every fork, exec and exit as it happens, with its time, so processes
+ * can be followed without scanning /proc. Listening needs
+ * CAP_NET_ADMIN and a kernel built with CONFIG_PROC_EVENTS.
+ *
+ * Only processes are reported: the creation and exit of a thread
+ * other than the thread group leader is filtered out.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROC_CONNECTOR_H
+#define PROC_CONNECTOR_H
+
+#include <inttypes.h>
+#include <vector>
+
+/* Receive buffer asked for, so that a burst of forks is not dropped */
+#define PROC_CONNECTOR_RCVBUF (1024 * 1024)
+
+enum proc_event_type_t {
+    PROC_EV_FORK,
+    PROC_EV_EXEC,
+    PROC_EV_EXIT
+};
+
+typedef enum proc_event_type_t proc_event_type_t;
+
+struct proc_event_t {
+    proc_event_type_t type;
+    uint64_t pid;
+    uint64_t ppid;              /* fork only */
+    uint64_t time_ns;           /* CLOCK_MONOTONIC */
+    int exit_status;            /* exit only: exit(3) status, -1 if signaled */
+    int exit_signal;            /* exit only: terminating signal, 0 if none */
+};
+
+typedef struct proc_event_t proc_event_t;
+
+/* A non-blocking socket listening to the events, or -1 with errno set */
+int proc_connector_open(void);
+void proc_connector_close(int fd);
+
+/*
+ * Append the events queued on 'fd' to 'events'. Returns 0 once the
+ * socket is drained and -1 with errno set on error; ENOBUFS means
+ * events were dropped, and the socket stays usable.
+ */
+int proc_connector_read(int fd, std::vector<proc_event_t>& events);
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * proc_fixture.cpp
+ *
+ * A synthetic /proc for the tests.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "proc_fixture.h"
+
+static void write_file(const std::string& path, const char *data, int len)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (f != NULL) {
+        if (len > 0) {
+            fwrite(data, 1, len, f);
+        }
+        fclose(f);
+    }
+}
+
+static std::string pid_dir(const std::string& root, uint64_t pid)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "/%" PRIu64, pid);
+    return root + buf;
+}
+
+static std::string task_dir(const std::string& root, uint64_t pid, uint64_t tid)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "/task/%" PRIu64, tid);
+    return pid_dir(root, pid) + buf;
+}
+
+static void write_stat(const std::string& path, uint64_t pid, const fixture_proc_t& p)
+{
+    char buf[512];
+    int n;
+
+    n = snprintf(buf, sizeof(buf),
+                 "%" PRIu64 " (%s) %c 1 %" PRIu64 " %" PRIu64 " 0 -1 4194560 0 0 0 0 %" PRIu64
+                 " %" PRIu64 " 0 0 20 0 1 0 %" PRIu64 " 123456789 2048 18446744073709551615 "
+                 "1 1 0 0 0 0 0 4096 0 0 0 0 17 0 0 0 0 0 0\n",
+                 pid, p.name.c_str(), p.state, pid, pid, p.utime, p.stime, p.start_ticks);
+    write_file(path, buf, n);
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+    remove(path);
+    return 0;
+}
+
+static void remove_tree(const std::string& path)
+{
+    nftw(path.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+void fixture_proc_init(fixture_proc_t *p, const std::string& name, uint64_t start_ticks)
+{
+    p->name = name;
+    p->state = 'S';
+    p->start_ticks = start_ticks;
+    p->utime = 0;
+    p->stime = 0;
+    p->size_pages = 30000;
+    p->text_pages = 64;
+    p->resident_pages = 2048;
+    p->read_bytes = 0;
+    p->write_bytes = 0;
+    p->wait_ns = 0;
+    p->voluntary_switches = 0;
+    p->involuntary_switches = 0;
+}
+
+std::string fixture_make(const char *name)
+{
+    std::string tmpl = std::string("/tmp/") + name + ".XXXXXX";
+    std::vector<char> dir(tmpl.begin(), tmpl.end());
+    char buf[128];
+    int n;
+
+    dir.push_back('\0');
+    if (mkdtemp(&dir[0]) == NULL) {
+        return "";
+    }
+
+    std::string d(&dir[0]);
+    n = snprintf(buf, sizeof(buf), "MemTotal:       16303428 kB\n");
+    write_file(d + "/meminfo", buf, n);
+    n = snprintf(buf, sizeof(buf), "%d.00 1700000.00\n", FIXTURE_UPTIME);
+    write_file(d + "/uptime", buf, n);
+    return d;
+}
+
+void fixture_remove(const std::string& root)
+{
+    if (!root.empty()) {
+        remove_tree(root);
+    }
+}
+
+void fixture_write_process(const std::string& root, uint64_t pid, const fixture_proc_t& p)
+{
+    std::string d = pid_dir(root, pid);
+    char buf[512];
+    int n;
+
+    mkdir(d.c_str(), 0755);
+    write_stat(d + "/stat", pid, p);
+
+    n = snprintf(buf, sizeof(buf), "%" PRIu64 " %" PRIu64 " 512 %" PRIu64 " 0 4096 0\n",
+                 p.size_pages, p.resident_pages, p.text_pages);
+    write_file(d + "/statm", buf, n);
+
+    n = snprintf(buf, sizeof(buf), "/usr/bin/%s%c--pid%c%" PRIu64, p.name.c_str(), 0, 0, pid);
+    write_file(d + "/cmdline", buf, n);
+
+    n = snprintf(buf, sizeof(buf),
+                 "rchar: 0\nwchar: 0\nsyscr: 0\nsyscw: 0\nread_bytes: %" PRIu64
+                 "\nwrite_bytes: %" PRIu64 "\ncancelled_write_bytes: 0\n",
+                 p.read_bytes, p.write_bytes);
+    write_file(d + "/io", buf, n);
+
+    n = snprintf(buf, sizeof(buf), "1000000 %" PRIu64 " 10\n", p.wait_ns);
+    write_file(d + "/schedstat", buf, n);
+
+    n = snprintf(buf, sizeof(buf),
+                 "Name:\t%s\nState:\t%c\nPid:\t%" PRIu64 "\nvoluntary_ctxt_switches:\t%" PRIu64
+                 "\nnonvoluntary_ctxt_switches:\t%" PRIu64 "\n",
+                 p.name.c_str(), p.state, pid, p.voluntary_switches, p.involuntary_switches);
+    write_file(d + "/status", buf, n);
+}
+
+void fixture_remove_process(const std::string& root, uint64_t pid)
+{
+    remove_tree(pid_dir(root, pid));
+}
+
+void fixture_write_thread(const std::string& root, uint64_t pid, uint64_t tid,
+                          const fixture_proc_t& t)
+{
+    std::string d = task_dir(root, pid, tid);
+
+    mkdir((pid_dir(root, pid) + "/task").c_str(), 0755);
+    mkdir(d.c_str(), 0755);
+    write_stat(d + "/stat", tid, t);
+}
+
+void fixture_remove_thread(const std::string& root, uint64_t pid, uint64_t tid)
+{
+    remove_tree(task_dir(root, pid, tid));
+}
@@ -0,0 +1,61 @@
+/**
+ * proc_fixture.h
+ *
+ * A synthetic /proc for the tests: a temporary directory with meminfo
+ * and uptime, and pid directories written from a description of each
+ * process (stat, statm, cmdline, io, schedstat, status and the stat of
+ * its threads), which the scanner reads like the real ones.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROC_FIXTURE_H
+#define PROC_FIXTURE_H
+
+#include <inttypes.h>
+#include <string>
+
+/* The uptime of the fixture, in seconds */
+#define FIXTURE_UPTIME 864000
+
+/* What the pid directory of a process says */
+struct fixture_proc_t {
+    std::string name;
+    char state;
+    uint64_t start_ticks;       /* clock ticks since boot */
+    uint64_t utime;             /* clock ticks */
+    uint64_t stime;
+    uint64_t size_pages;        /* statm; memory_usage is size - text */
+    uint64_t text_pages;
+    uint64_t resident_pages;
+    uint64_t read_bytes;        /* io */
+    uint64_t write_bytes;
+    uint64_t wait_ns;           /* schedstat */
+    uint64_t voluntary_switches;    /* status */
+    uint64_t involuntary_switches;
+};
+
+typedef struct fixture_proc_t fixture_proc_t;
+
+/* Sleeping, no CPU time or I/O, a few pages */
+void fixture_proc_init(fixture_proc_t *p, const std::string& name, uint64_t start_ticks);
+
+/* A new fixture under /tmp, named after 'name'; "" on failure */
+std::string fixture_make(const char *name);
+
+/* Remove the fixture and everything in it */
+void fixture_remove(const std::string& root);
+
+/*
+ * Write process 'pid', or rewrite it: a new program if the name
+ * changed, a reused pid if the start did. The command line is
+ * "/usr/bin/<name> --pid <pid>".
+ */
+void fixture_write_process(const std::string& root, uint64_t pid, const fixture_proc_t& p);
+void fixture_remove_process(const std::string& root, uint64_t pid);
+
+/* task/<tid>/stat of process 'pid', from the same description */
+void fixture_write_thread(const std::string& root, uint64_t pid, uint64_t tid,
+                          const fixture_proc_t& t);
+void fixture_remove_thread(const std::string& root, uint64_t pid, uint64_t tid);
+
+#endif
@@ -0,0 +1,411 @@
+/**
+ * proc_reader.cpp
+ *
+ * Fork-free access to the /proc pseudo filesystem.
+ * See proc_reader.h for the buffer ownership rules.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "proc_reader.h"
+
+/* Long-lived readers shared by the sampling helpers below */
+static proc_file_t loadavg_file = { -1, NULL, 0, 0 };
+static proc_file_t stat_file = { -1, NULL, 0, 0 };
+static proc_file_t meminfo_file = { -1, NULL, 0, 0 };
+static proc_file_t scratch_file = { -1, NULL, 0, 0 };
+
+void proc_file_init(proc_file_t *pf)
+{
+    pf->fd = -1;
+    pf->buf = NULL;
+    pf->len = 0;
+    pf->cap = 0;
+}
+
+int proc_file_open(proc_file_t *pf, const char *path)
+{
+    if (pf->fd >= 0) {
+        close(pf->fd);
+    }
+
+    pf->fd = open(path, O_RDONLY | O_CLOEXEC);
+    return (pf->fd < 0) ? -1 : 0;
+}
+
+static int proc_file_grow(proc_file_t *pf, size_t cap)
+{
+    char *buf = (char *) realloc(pf->buf, cap);
+    if (buf == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pf->buf = buf;
+    pf->cap = cap;
+    return 0;
+}
+
+static ssize_t proc_file_pread(proc_file_t *pf, int fd)
+{
+    if (pf->cap == 0 && proc_file_grow(pf, PROC_FILE_BUFSZ) < 0) {
+        return -1;
+    }
+
+    /*
+     * /proc files report a size of 0, so the only way to know the
+     * buffer was large enough is a short read. Keep one byte spare
+     * for the terminating NUL.
+     */
+    for (;;) {
+        ssize_t n = pread(fd, pf->buf, pf->cap - 1, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        if ((size_t) n < pf->cap - 1) {
+            pf->buf[n] = '\0';
+            pf->len = (size_t) n;
+            return n;
+        }
+
+        if (proc_file_grow(pf, pf->cap * 2) < 0) {
+            return -1;
+        }
+    }
+}
+
+ssize_t proc_file_read(proc_file_t *pf)
+{
+    if (pf->fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+
+    return proc_file_pread(pf, pf->fd);
+}
+
+ssize_t proc_file_read_path(proc_file_t *pf, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ssize_t n = proc_file_pread(pf, fd);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+
+    return n;
+}
+
+void proc_file_close(proc_file_t *pf)
+{
+    if (pf->fd >= 0) {
+        close(pf->fd);
+        pf->fd = -1;
+    }
+}
+
+void proc_file_free(proc_file_t *pf)
+{
+    proc_file_close(pf);
+    free(pf->buf);
+    proc_file_init(pf);
+}
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+const char *proc_skip_space(const char *p, const char *end)
+{
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+const char *proc_skip_fields(const char *p, const char *end, int count)
+{
+    p = proc_skip_space(p, end);
+    while (count-- > 0) {
+        if (p >= end) {
+            return NULL;
+        }
+        while (p < end && !is_space(*p)) {
+            p++;
+        }
+        p = proc_skip_space(p, end);
+    }
+    return p;
+}
+
+const char *proc_parse_u64(const char *p, const char *end, uint64_t *val)
+{
+    p = proc_skip_space(p, end);
+    if (p >= end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    uint64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t) (*p - '0');
+        p++;
+    }
+
+    *val = v;
+    return p;
+}
+
+const char *proc_parse_float(const char *p, const char *end, float *val)
+{
+    uint64_t whole = 0;
+    if ((p = proc_parse_u64(p, end, &whole)) == NULL) {
+        return NULL;
+    }
+
+    float v = (float) whole;
+    if (p < end && *p == '.') {
+        float scale = 0.1f;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            v += (float) (*p - '0') * scale;
+            scale *= 0.1f;
+        }
+    }
+
+    *val = v;
+    return p;
+}
+
+const char *proc_stat_fields(const char *p, const char *end)
+{
+    const char *q = end;
+    while (q > p && *(q - 1) != ')') {
+        q--;
+    }
+    if (q == p) {
+        return NULL;
+    }
+    return proc_skip_space(q, end);
+}
+
+int proc_read_loadavg(load_avg_t *loadAverages)
+{
+    if (loadavg_file.fd < 0 && proc_file_open(&loadavg_file, "/proc/loadavg") < 0) {
+        return -1;
+    }
+    if (proc_file_read(&loadavg_file) < 0) {
+        return -1;
+    }
+
+    /*
+     * /proc/loadavg has a single line:
+     * 0.29 0.50 0.48 1/1866 29717
+     */
+    const char *p = loadavg_file.buf;
+    const char *end = p + loadavg_file.len;
+
+    if ((p = proc_parse_float(p, end, &loadAverages->load_avg_1min)) == NULL ||
+        (p = proc_parse_float(p, end, &loadAverages->load_avg_5min)) == NULL ||
+        (p = proc_parse_float(p, end, &loadAverages->load_avg_15min)) == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int proc_read_cpu_times(cpu_times_t *times, int max)
+{
+    if (stat_file.fd < 0 && proc_file_open(&stat_file, "/proc/stat") < 0) {
+        return -1;
+    }
+    if (proc_file_read(&stat_file) < 0) {
+        return -1;
+    }
+
+    /*
+     * The cpu lines come first:
+     * cpu  4705 356 584 3699176 23060 0 277 0 0 0
+     * cpu0 1393 280 184 923374 4523 0 181 0 0 0
+     * Older kernels may have fewer columns; missing ones read as 0.
+     */
+    const char *p = stat_file.buf;
+    const char *end = p + stat_file.len;
+    int count = 0;
+
+    while (end - p > 3 && strncmp(p, "cpu", 3) == 0) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        cpu_times_t t;
+        uint64_t index;
+        const char *q = p + 3;
+
+        if (q < eol && *q >= '0' && *q <= '9') {
+            q = proc_parse_u64(q, eol, &index);
+            t.index = (int) index;
+        } else {
+            t.index = -1;
+        }
+
+        for (int f = 0; f < PROC_CPU_FIELDS; f++) {
+            t.ticks[f] = 0;
+            if (q != NULL) {
+                q = proc_parse_u64(q, eol, &t.ticks[f]);
+            }
+        }
+
+        if (count < max) {
+            times[count] = t;
+        }
+        count++;
+
+        p = (eol < end) ? eol + 1 : end;
+    }
+
+    if (count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return count;
+}
+
+struct meminfo_field_t {
+    const char *name;
+    size_t len;
+    size_t offset;
+};
+
+#define MEMINFO_FIELD(name, member) { name ":", sizeof(name), offsetof(mem_info_t, member) }
+
+static const struct meminfo_field_t meminfo_fields[] = {
+    MEMINFO_FIELD("MemTotal", total),
+    MEMINFO_FIELD("MemFree", free),
+    MEMINFO_FIELD("MemAvailable", available),
+    MEMINFO_FIELD("Buffers", buffers),
+    MEMINFO_FIELD("Cached", cached),
+    MEMINFO_FIELD("SwapTotal", swap_total),
+    MEMINFO_FIELD("SwapFree", swap_free)
+};
+
+#define MEMINFO_FIELDS ((int) (sizeof(meminfo_fields) / sizeof(meminfo_fields[0])))
+
+int proc_read_meminfo(mem_info_t *mem)
+{
+    if (meminfo_file.fd < 0 && proc_file_open(&meminfo_file, "/proc/meminfo") < 0) {
+        return -1;
+    }
+    if (proc_file_read(&meminfo_file) < 0) {
+        return -1;
+    }
+
+    /*
+     * One "Name:   value kB" per line. The fields we want are near the
+     * top, so stop as soon as all of them were seen.
+     */
+    const char *p = meminfo_file.buf;
+    const char *end = p + meminfo_file.len;
+    bool available = false;
+    int found = 0;
+
+    memset(mem, 0, sizeof(*mem));
+
+    while (p < end && found < MEMINFO_FIELDS) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        for (int i = 0; i < MEMINFO_FIELDS; i++) {
+            const struct meminfo_field_t *f = &meminfo_fields[i];
+            if ((size_t) (eol - p) > f->len && memcmp(p, f->name, f->len) == 0) {
+                uint64_t *val = (uint64_t *) ((char *) mem + f->offset);
+                if (proc_parse_u64(p + f->len, eol, val) != NULL) {
+                    found++;
+                    available |= (val == &mem->available);
+                }
+                break;
+            }
+        }
+
+        p = eol + 1;
+    }
+
+    if (mem->total == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* MemAvailable appeared in Linux 3.14 */
+    if (!available) {
+        mem->available = mem->free + mem->buffers + mem->cached;
+    }
+
+    return 0;
+}
+
+unsigned int proc_cpu_count(void)
+{
+    if (proc_file_read_path(&scratch_file, "/proc/cpuinfo") < 0) {
+        return 0;
+    }
+
+    /* Same semantics as "grep processor /proc/cpuinfo | wc -l" */
+    unsigned int count = 0;
+    const char *p = scratch_file.buf;
+    while ((p = strstr(p, "processor")) != NULL) {
+        count++;
+        if ((p = strchr(p, '\n')) == NULL) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+int proc_read_pid_times(uint64_t pid, uint64_t *userTime, uint64_t *kernelTime)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%lu/stat", (unsigned long) pid);
+
+    if (proc_file_read_path(&scratch_file, path) < 0) {
+        return -1;
+    }
+
+    /**
+     * Reference: https://linux.die.net/man/5/proc
+     *
+     * utime and stime are fields 14 and 15. Fields are counted from
+     * the state (field 3), since comm may contain whitespace.
+     */
+    const char *end = scratch_file.buf + scratch_file.len;
+    const char *p = proc_stat_fields(scratch_file.buf, end);
+
+    if (p == NULL ||
+        (p = proc_skip_fields(p, end, 11)) == NULL ||
+        (p = proc_parse_u64(p, end, userTime)) == NULL ||
+        (p = proc_parse_u64(p, end, kernelTime)) == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
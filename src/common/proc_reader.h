@@ -0,0 +1,117 @@
+/**
+ * proc_reader.h
+ *
+ * Fork-free access to the /proc pseudo filesystem.
+ *
+ * A proc_file_t keeps its descriptor open between samples and is
+ * re-read with pread(2) into a buffer owned by the reader. The buffer
+ * only grows (to the largest size seen so far), so in steady state a
+ * sample costs one system call and no heap allocation. The parsers
+ * below work directly on that buffer and never allocate either.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROC_READER_H
+#define PROC_READER_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#define PROC_FILE_BUFSZ 4096
+
+struct proc_file_t {
+    int fd;
+    char *buf;
+    size_t len;     /* bytes returned by the last read */
+    size_t cap;     /* allocated size of buf */
+};
+
+typedef struct proc_file_t proc_file_t;
+
+struct load_avg_t {
+    float load_avg_1min;
+    float load_avg_5min;
+    float load_avg_15min;
+};
+
+typedef struct load_avg_t load_avg_t;
+
+/* The /proc/meminfo fields we use, in kB */
+struct mem_info_t {
+    uint64_t total;
+    uint64_t free;
+    uint64_t available;         /* estimate; free + reclaimable on old kernels */
+    uint64_t buffers;
+    uint64_t cached;
+    uint64_t swap_total;
+    uint64_t swap_free;
+};
+
+typedef struct mem_info_t mem_info_t;
+
+/* The /proc/stat "cpu" columns, in USER_HZ ticks since boot */
+enum {
+    PROC_CPU_USER,
+    PROC_CPU_NICE,
+    PROC_CPU_SYSTEM,
+    PROC_CPU_IDLE,
+    PROC_CPU_IOWAIT,
+    PROC_CPU_IRQ,
+    PROC_CPU_SOFTIRQ,
+    PROC_CPU_STEAL,
+    PROC_CPU_FIELDS
+};
+
+struct cpu_times_t {
+    int index;                  /* core number, -1 for the "cpu" total line */
+    uint64_t ticks[PROC_CPU_FIELDS];
+};
+
+typedef struct cpu_times_t cpu_times_t;
+
+/*
+ * Reader lifecycle. All functions return 0 (or the number of bytes
+ * read) on success and -1 with errno set on failure.
+ */
+void proc_file_init(proc_file_t *pf);
+int proc_file_open(proc_file_t *pf, const char *path);
+ssize_t proc_file_read(proc_file_t *pf);
+void proc_file_close(proc_file_t *pf);
+void proc_file_free(proc_file_t *pf);
+
+/*
+ * Read a file that is not worth keeping open (e.g. /proc/<pid>/stat)
+ * into pf's buffer. Any descriptor held by pf is left untouched.
+ */
+ssize_t proc_file_read_path(proc_file_t *pf, const char *path);
+
+/*
+ * Zero-allocation parsers over [p, end). Each returns a pointer just
+ * past the parsed token or NULL if no token could be parsed.
+ */
+const char *proc_skip_space(const char *p, const char *end);
+const char *proc_skip_fields(const char *p, const char *end, int count);
+const char *proc_parse_u64(const char *p, const char *end, uint64_t *val);
+const char *proc_parse_float(const char *p, const char *end, float *val);
+
+/*
+ * Returns a pointer to the 3rd field (state) of a /proc/<pid>/stat
+ * line, i.e. just past the parenthesised comm which may itself
+ * contain spaces and parentheses.
+ */
+const char *proc_stat_fields(const char *p, const char *end);
+
+/* Well-known samples */
+int proc_read_loadavg(load_avg_t *loadAverages);
+unsigned int proc_cpu_count(void);
+
+/*
+ * Fills up to 'max' entries from the "cpu" lines of /proc/stat, the
+ * total line first. Returns the number of lines found, which may be
+ * more than 'max', or -1.
+ */
+int proc_read_cpu_times(cpu_times_t *times, int max);
+int proc_read_meminfo(mem_info_t *mem);
+int proc_read_pid_times(uint64_t pid, uint64_t *userTime, uint64_t *kernelTime);
+
+#endif
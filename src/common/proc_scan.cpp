@@ -0,0 +1,797 @@
+/**
+ * proc_scan.cpp
+ *
+ * Builds the process table directly from /proc/[pid].
+ * See proc_scan.h for the meaning of each column of the table.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "proc_scan.h"
+
+/* task flags, stat field 9, see include/linux/sched.h */
+#define PF_KTHREAD 0x00200000
+
+static bool cmp_tid(const tinfo_t& a, const tinfo_t& b)
+{
+    return a.tid < b.tid;
+}
+
+static bool is_pid_dir(const char *name)
+{
+    if (*name == '\0') {
+        return false;
+    }
+    for (; *name != '\0'; name++) {
+        if (*name < '0' || *name > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int read_mem_total(proc_scanner_t *ps)
+{
+    std::string path = ps->root + "/meminfo";
+    if (proc_file_read_path(&ps->file, path.c_str()) < 0) {
+        return -1;
+    }
+
+    const char *end = ps->file.buf + ps->file.len;
+    const char *p = strstr(ps->file.buf, "MemTotal:");
+    if (p == NULL || proc_parse_u64(p + strlen("MemTotal:"), end, &ps->mem_total_kb) == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int read_uptime(proc_scanner_t *ps, float *uptime)
+{
+    std::string path = ps->root + "/uptime";
+    if (proc_file_read_path(&ps->file, path.c_str()) < 0) {
+        return -1;
+    }
+
+    if (proc_parse_float(ps->file.buf, ps->file.buf + ps->file.len, uptime) == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int proc_scanner_init(proc_scanner_t *ps, const char *root)
+{
+    ps->root = (root != NULL) ? root : PROC_ROOT;
+    proc_file_init(&ps->file);
+
+    ps->clk_tck = sysconf(_SC_CLK_TCK);
+    ps->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    ps->mem_total_kb = 0;
+    proc_table_init(&ps->table);
+    ps->identities.clear();
+    ps->generation = 0;
+    ps->scan_ms = 0;
+    ps->io_sched = false;
+    ps->tracking = false;
+    ps->resync = false;
+    ps->scans_since_walk = 0;
+    ps->report_changes = false;
+    ps->started.clear();
+    ps->exited.clear();
+
+    work_pool_init(&ps->pool, 1, NULL);
+    ps->workers.resize(1);
+    proc_file_init(&ps->workers[0].file);
+    ps->pids.clear();
+    ps->threads.clear();
+    ps->thread_reads = 0;
+
+    return read_mem_total(ps);
+}
+
+static void free_workers(proc_scanner_t *ps)
+{
+    work_pool_free(&ps->pool);
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        proc_file_free(&ps->workers[w].file);
+    }
+    ps->workers.clear();
+}
+
+void proc_scanner_free(proc_scanner_t *ps)
+{
+    proc_file_free(&ps->file);
+    free_workers(ps);
+    ps->identities.clear();
+    proc_table_free(&ps->table);
+    ps->started.clear();
+    ps->exited.clear();
+    ps->pids.clear();
+    ps->threads.clear();
+}
+
+int proc_scanner_set_workers(proc_scanner_t *ps, unsigned int workers)
+{
+    cpu_set_t cpus;
+    int housekeeping = work_pool_housekeeping_cpus(&cpus);
+    int err = 0;
+
+    workers = std::min(std::max(workers, 1U), (unsigned int) PROC_SCAN_MAX_WORKERS);
+    if (housekeeping > 0) {
+        workers = std::min(workers, (unsigned int) housekeeping);
+    }
+
+    free_workers(ps);
+    if (work_pool_init(&ps->pool, workers, (housekeeping > 0) ? &cpus : NULL) < 0) {
+        err = errno;
+    }
+
+    ps->workers.resize(ps->pool.size);
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        proc_file_init(&ps->workers[w].file);
+    }
+
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return ps->pool.size;
+}
+
+/*
+ * /proc/<pid>/stat: comm, parent, flags, start time and CPU times.
+ * Workers call this and read_statm() on their own file and sample only.
+ */
+static bool read_stat(proc_file_t *file, const char *path, proc_sample_t *s)
+{
+    if (proc_file_read_path(file, path) <= 0) {
+        return false;
+    }
+
+    const char *buf = file->buf;
+    const char *end = buf + file->len;
+
+    const char *open = (const char *) memchr(buf, '(', file->len);
+    const char *fields = proc_stat_fields(buf, end);
+    if (open == NULL || fields == NULL) {
+        return false;
+    }
+
+    /* comm sits between the first '(' and the last ')' */
+    const char *close = fields;
+    while (close > open && *close != ')') {
+        close--;
+    }
+    s->comm_len = std::min((size_t) (close - open - 1), sizeof(s->comm));
+    memcpy(s->comm, open + 1, s->comm_len);
+
+    s->state = *fields;
+
+    const char *q = fields;
+    if ((q = proc_skip_fields(q, end, 1)) == NULL ||
+        (q = proc_parse_u64(q, end, &s->ppid)) == NULL ||
+        (q = proc_skip_fields(q, end, 4)) == NULL ||
+        (q = proc_parse_u64(q, end, &s->flags)) == NULL ||
+        (q = proc_skip_fields(q, end, 4)) == NULL ||
+        (q = proc_parse_u64(q, end, &s->cpu_usage_user)) == NULL ||
+        (q = proc_parse_u64(q, end, &s->cpu_usage_system)) == NULL ||
+        (q = proc_skip_fields(q, end, 6)) == NULL ||
+        (q = proc_parse_u64(q, end, &s->start_ticks)) == NULL) {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * /proc/<pid>/statm: size resident shared text lib data dt (pages)
+ */
+static bool read_statm(proc_file_t *file, const char *path, long page_kb, proc_sample_t *s)
+{
+    if (proc_file_read_path(file, path) <= 0) {
+        return false;
+    }
+
+    const char *q = file->buf;
+    const char *end = q + file->len;
+    uint64_t size = 0, resident = 0, text = 0;
+
+    if ((q = proc_parse_u64(q, end, &size)) == NULL ||
+        (q = proc_parse_u64(q, end, &resident)) == NULL ||
+        (q = proc_skip_fields(q, end, 1)) == NULL ||
+        (q = proc_parse_u64(q, end, &text)) == NULL) {
+        return false;
+    }
+
+    s->memory_usage = (size > text) ? (size - text) * page_kb : 0;
+    s->rss_kb = resident * page_kb;
+
+    return true;
+}
+
+/* The value of a "\nname: value" line of what 'file' holds */
+static bool parse_named(const proc_file_t *file, const char *name, uint64_t *val)
+{
+    const char *p = strstr(file->buf, name);
+    return p != NULL && proc_parse_u64(p + strlen(name), file->buf + file->len, val) != NULL;
+}
+
+/*
+ * /proc/<pid>/io, schedstat and status. A file that cannot be read
+ * leaves its counters 0: io needs ptrace access, schedstat a kernel
+ * with CONFIG_SCHED_INFO.
+ */
+static void read_io_sched(proc_file_t *file, char *path, size_t len, proc_sample_t *s)
+{
+    s->read_bytes = s->write_bytes = 0;
+    s->wait_ns = 0;
+    s->voluntary_switches = s->involuntary_switches = 0;
+
+    /* The leading newline keeps cancelled_write_bytes from matching */
+    strcpy(path + len, "io");
+    if (proc_file_read_path(file, path) > 0) {
+        parse_named(file, "\nread_bytes:", &s->read_bytes);
+        parse_named(file, "\nwrite_bytes:", &s->write_bytes);
+    }
+
+    /* run time, run-queue wait (both ns), time slices */
+    strcpy(path + len, "schedstat");
+    if (proc_file_read_path(file, path) > 0) {
+        const char *q = file->buf;
+        const char *end = q + file->len;
+        if ((q = proc_skip_fields(q, end, 1)) != NULL) {
+            proc_parse_u64(q, end, &s->wait_ns);
+        }
+    }
+
+    /* And nonvoluntary_ctxt_switches is not "\nvoluntary_ctxt_switches" */
+    strcpy(path + len, "status");
+    if (proc_file_read_path(file, path) > 0) {
+        parse_named(file, "\nvoluntary_ctxt_switches:", &s->voluntary_switches);
+        parse_named(file, "\nnonvoluntary_ctxt_switches:", &s->involuntary_switches);
+    }
+}
+
+/*
+ * Read one process. 'path' holds "<root>/<pid>/" in its first 'len'
+ * bytes. The process may exit at any point during the scan.
+ */
+static bool read_sample(proc_file_t *file, char *path, size_t len, long page_kb, bool ioSched,
+                        uint64_t pid, proc_sample_t *s)
+{
+    s->pid = pid;
+
+    strcpy(path + len, "stat");
+    if (!read_stat(file, path, s)) {
+        return false;
+    }
+
+    strcpy(path + len, "statm");
+    if (!read_statm(file, path, page_kb, s)) {
+        return false;
+    }
+
+    if (ioSched) {
+        read_io_sched(file, path, len, s);
+    }
+    return true;
+}
+
+/*
+ * /proc/<pid>/cmdline: NUL separated argv. Kernel threads have an
+ * empty command line and are shown as "[comm]", like ps does.
+ */
+static istr_t scan_cmdline(proc_scanner_t *ps, const char *path, const istr_t& name)
+{
+    std::string& args = ps->scratch;
+
+    args.clear();
+    if (proc_file_read_path(&ps->file, path) <= 0) {
+        args.append("[").append(name.c_str()).append("]");
+        return istr_intern(args.data(), args.size());
+    }
+
+    /* Drop empty arguments, as ps does */
+    const char *q = ps->file.buf;
+    const char *end = q + ps->file.len;
+    while (q < end) {
+        size_t n = strnlen(q, end - q);
+        if (n > 0) {
+            if (!args.empty()) {
+                args.push_back('\0');
+            }
+            args.append(q, n);
+        }
+        q += n + 1;
+    }
+    return istr_intern_fields(args.data(), args.size());
+}
+
+static void note_change(proc_scanner_t *ps, std::vector<proc_change_t>& changes, uint64_t pid,
+                        bool exec, const proc_identity_t& id)
+{
+    if (ps->report_changes) {
+        proc_change_t c;
+        c.pid = pid;
+        c.exec = exec;
+        c.identity = id;
+        changes.push_back(c);
+    }
+}
+
+/*
+ * The identity of a process from the cache, resolving and caching it
+ * if the pid is new, was reused or its comm changed.
+ */
+static proc_identity_t& resolve_identity(proc_scanner_t *ps, char *path, size_t len,
+                                         const proc_sample_t& s)
+{
+    proc_identity_t& id = ps->identities[s.pid];
+    bool fresh = id.generation == 0;
+    bool reused = !fresh && id.start_ticks != s.start_ticks;
+
+    if (fresh || reused || id.name.size() != s.comm_len ||
+        memcmp(id.name.c_str(), s.comm, s.comm_len) != 0) {
+        /* The previous owner of the pid exited unnoticed */
+        if (reused) {
+            note_change(ps, ps->exited, s.pid, false, id);
+        }
+        if (fresh || reused) {
+            id.sample_ms = 0;
+        }
+
+        id.start_ticks = s.start_ticks;
+        id.ppid = s.ppid;
+        id.name = istr_intern(s.comm, s.comm_len);
+
+        strcpy(path + len, "cmdline");
+        id.args = scan_cmdline(ps, path, id.name);
+
+        /* Kernel worker threads rename themselves all the time */
+        bool renamed = !fresh && !reused;
+        if (!id.announced && !(renamed && (s.flags & PF_KTHREAD))) {
+            note_change(ps, ps->started, s.pid, renamed, id);
+        }
+        id.announced = false;
+    }
+
+    id.generation = ps->generation;
+    return id;
+}
+
+/* Forget the processes that were not seen by the last scan */
+static void expire_identities(proc_scanner_t *ps)
+{
+    std::map<uint64_t, proc_identity_t>::iterator it = ps->identities.begin();
+
+    while (it != ps->identities.end()) {
+        if (it->second.generation != ps->generation) {
+            note_change(ps, ps->exited, it->first, false, it->second);
+            ps->identities.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static size_t pid_path(proc_scanner_t *ps, char *path, uint64_t pid)
+{
+    size_t rootLen = ps->root.size();
+    return rootLen + snprintf(path + rootLen, PATH_MAX - rootLen, "/%" PRIu64 "/", pid);
+}
+
+/*
+ * Turn what was read of a process into its row of the table. Unless
+ * 'sample', the CPU sample of the process is kept, see proc_scan_refresh().
+ */
+static void merge_sample(proc_scanner_t *ps, char *path, const proc_sample_t& s, float uptime,
+                         bool sample)
+{
+    proc_identity_t& id = resolve_identity(ps, path, pid_path(ps, path, s.pid), s);
+    proc_table_t *t = &ps->table;
+
+    uint32_t row = id.row;
+    if (row >= proc_table_rows(t) || t->pid[row] != s.pid) {
+        row = id.row = proc_table_add(t, s.pid);
+    }
+
+    t->cpu_usage_user[row] = s.cpu_usage_user;
+    t->cpu_usage_system[row] = s.cpu_usage_system;
+    t->memory_usage[row] = s.memory_usage;
+    t->start_ticks[row] = s.start_ticks;
+    if (ps->io_sched) {
+        t->read_bytes[row] = s.read_bytes;
+        t->write_bytes[row] = s.write_bytes;
+        t->wait_ns[row] = s.wait_ns;
+        t->voluntary_switches[row] = s.voluntary_switches;
+        t->involuntary_switches[row] = s.involuntary_switches;
+    }
+    t->memory_utilization[row] = (ps->mem_total_kb > 0) ?
+        (uint8_t) (s.rss_kb * 100 / ps->mem_total_kb) : 0;
+
+    float started = (float) s.start_ticks / ps->clk_tck;
+    float elapsed = (uptime > started) ? (uptime - started) : 0;
+    t->start_time[row] = (uint64_t) elapsed;
+
+    /* Over the interval since the previous scan, once there is one */
+    float pct;
+    uint64_t ticks = s.cpu_usage_user + s.cpu_usage_system;
+    if (id.sample_ms != 0 && ps->scan_ms > id.sample_ms && ticks >= id.sample_ticks) {
+        pct = (float) (ticks - id.sample_ticks) * 100000 / ps->clk_tck /
+              (float) (ps->scan_ms - id.sample_ms);
+    } else {
+        float cpuSeconds = (float) ticks / ps->clk_tck;
+        pct = (elapsed > 0) ? (cpuSeconds * 100 / elapsed) : 0;
+    }
+    if (sample || id.sample_ms == 0) {
+        id.sample_ticks = ticks;
+        id.sample_ms = ps->scan_ms;
+    }
+    t->cpu_pct[row] = pct;
+    t->cpu_utilization[row] = (uint8_t) std::min(pct + 0.5f, 255.0f);
+
+    /* Names and command lines are interned: compared by pointer */
+    if (proc_table_name(t, row) != id.name) {
+        proc_table_set_name(t, row, id.name);
+    }
+    if (t->args[row] != id.args) {
+        t->args[row] = id.args;
+    }
+    t->generation[row] = ps->generation;
+}
+
+/* Work item 'shard' of a scan: read its pids into the worker's partial */
+static void read_shard(unsigned int worker, size_t shard, void *opaque)
+{
+    proc_scanner_t *ps = (proc_scanner_t *) opaque;
+    proc_scan_worker_t& w = ps->workers[worker];
+    char path[PATH_MAX];
+    proc_sample_t s;
+
+    size_t first = shard * PROC_SCAN_SHARD;
+    size_t last = std::min(first + PROC_SCAN_SHARD, ps->pids.size());
+
+    memcpy(path, ps->root.c_str(), ps->root.size());
+    for (size_t i = first; i < last; i++) {
+        if (read_sample(&w.file, path, pid_path(ps, path, ps->pids[i]), ps->page_kb, ps->io_sched,
+                        ps->pids[i], &s)) {
+            w.samples.push_back(s);
+        }
+    }
+}
+
+/* Read the pids to visit, on the pool, and merge the partials */
+static void scan_pids(proc_scanner_t *ps, char *path, float uptime, bool sample)
+{
+    size_t shards = (ps->pids.size() + PROC_SCAN_SHARD - 1) / PROC_SCAN_SHARD;
+
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        ps->workers[w].samples.clear();
+    }
+    work_pool_run(&ps->pool, shards, read_shard, ps);
+
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        const std::vector<proc_sample_t>& samples = ps->workers[w].samples;
+
+        for (size_t i = 0; i < samples.size(); i++) {
+            merge_sample(ps, path, samples[i], uptime, sample);
+        }
+    }
+}
+
+/* Remove the rows of the processes the last scan did not find */
+static void expire_rows(proc_scanner_t *ps)
+{
+    proc_table_t *t = &ps->table;
+
+    /* Backwards, so that the row moved into a hole was already kept */
+    for (uint32_t row = proc_table_rows(t); row-- > 0; ) {
+        if (t->generation[row] == ps->generation) {
+            continue;
+        }
+
+        proc_table_remove(t, row);
+        if (row < proc_table_rows(t)) {
+            std::map<uint64_t, proc_identity_t>::iterator it = ps->identities.find(t->pid[row]);
+            if (it != ps->identities.end()) {
+                it->second.row = row;
+            }
+        }
+    }
+}
+
+/* Forget the threads of the processes that are gone */
+static void expire_threads(proc_scanner_t *ps)
+{
+    proc_threads_t::iterator it = ps->threads.begin();
+
+    while (it != ps->threads.end()) {
+        if (ps->identities.find(it->first.first) == ps->identities.end()) {
+            ps->threads.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/* Every pid directory under the root */
+static int walk_processes(proc_scanner_t *ps)
+{
+    DIR *dir = opendir(ps->root.c_str());
+    if (dir == NULL) {
+        return -1;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (is_pid_dir(entry->d_name)) {
+            ps->pids.push_back(strtoull(entry->d_name, NULL, 10));
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+/*
+ * The pids the events told about. One that cannot be read has exited
+ * and its exit event is on its way; it is dropped then.
+ */
+static void visit_processes(proc_scanner_t *ps)
+{
+    std::map<uint64_t, proc_identity_t>::iterator it;
+
+    for (it = ps->identities.begin(); it != ps->identities.end(); ++it) {
+        ps->pids.push_back(it->first);
+    }
+}
+
+static int scan_processes(proc_scanner_t *ps, bool sample)
+{
+    /* 0 marks an identity that was never resolved */
+    if (++ps->generation == 0) {
+        ps->generation = 1;
+    }
+
+    float uptime = 0;
+    if (read_uptime(ps, &uptime) < 0) {
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    ps->scan_ms = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    char path[PATH_MAX];
+    size_t rootLen = ps->root.size();
+    if (rootLen + 32 + NAME_MAX > sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(path, ps->root.c_str(), rootLen);
+
+    ps->pids.clear();
+    bool walk = !ps->tracking || ps->resync || ++ps->scans_since_walk >= PROC_RESYNC_SCANS;
+    if (walk) {
+        if (walk_processes(ps) < 0) {
+            return -1;
+        }
+        ps->resync = false;
+        ps->scans_since_walk = 0;
+    } else {
+        visit_processes(ps);
+    }
+
+    scan_pids(ps, path, uptime, sample);
+    expire_rows(ps);
+    if (walk) {
+        expire_identities(ps);
+    }
+    if (!ps->threads.empty()) {
+        expire_threads(ps);
+    }
+
+    proc_table_sort(&ps->table);
+    return 0;
+}
+
+int proc_scan_processes(proc_scanner_t *ps)
+{
+    return scan_processes(ps, true);
+}
+
+int proc_scan_refresh(proc_scanner_t *ps)
+{
+    return scan_processes(ps, false);
+}
+
+int proc_scan_threads(proc_scanner_t *ps, uint64_t pid, std::vector<tinfo_t>& threads)
+{
+    char path[PATH_MAX];
+    size_t len;
+    proc_sample_t s;
+    int count = 0;
+
+    if (ps->root.size() + 64 + NAME_MAX > sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(path, ps->root.c_str(), ps->root.size());
+    len = pid_path(ps, path, pid);
+    strcpy(path + len, "task");
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    /* 0 marks a thread never read */
+    if (++ps->thread_reads == 0) {
+        ps->thread_reads = 1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    uint64_t nowMs = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    size_t first = threads.size();
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!is_pid_dir(entry->d_name)) {
+            continue;
+        }
+
+        /* A thread may exit at any point too */
+        snprintf(path + len, PATH_MAX - len, "task/%s/stat", entry->d_name);
+        if (!read_stat(&ps->file, path, &s)) {
+            continue;
+        }
+
+        tinfo_t t;
+        t.tid = strtoull(entry->d_name, NULL, 10);
+        t.state = s.state;
+        t.cpu_usage_user = s.cpu_usage_user;
+        t.cpu_usage_system = s.cpu_usage_system;
+
+        proc_thread_t& th = ps->threads[std::make_pair(pid, t.tid)];
+        if (th.read == 0 || th.start_ticks != s.start_ticks) {
+            th.start_ticks = s.start_ticks;
+            th.sample_ms = 0;
+        }
+        if (th.name.size() != s.comm_len || memcmp(th.name.c_str(), s.comm, s.comm_len) != 0) {
+            th.name = istr_intern(s.comm, s.comm_len);
+        }
+
+        uint64_t ticks = s.cpu_usage_user + s.cpu_usage_system;
+        if (th.sample_ms != 0 && nowMs > th.sample_ms && ticks >= th.sample_ticks) {
+            t.cpu_pct = (float) (ticks - th.sample_ticks) * 100000 / ps->clk_tck /
+                        (float) (nowMs - th.sample_ms);
+        } else {
+            uint64_t startMs = s.start_ticks * 1000 / ps->clk_tck;
+            t.cpu_pct = (nowMs > startMs) ?
+                (float) ticks * 100000 / ps->clk_tck / (float) (nowMs - startMs) : 0;
+        }
+        th.sample_ticks = ticks;
+        th.sample_ms = nowMs;
+        th.read = ps->thread_reads;
+
+        t.name = th.name;
+        threads.push_back(t);
+        count++;
+    }
+    closedir(dir);
+
+    /* Forget the threads of the process that this read did not see */
+    proc_threads_t::iterator it = ps->threads.lower_bound(std::make_pair(pid, (uint64_t) 0));
+    while (it != ps->threads.end() && it->first.first == pid) {
+        if (it->second.read != ps->thread_reads) {
+            ps->threads.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    std::sort(threads.begin() + first, threads.end(), cmp_tid);
+    return count;
+}
+
+const proc_identity_t *proc_scanner_fork(proc_scanner_t *ps, uint64_t pid, uint64_t ppid)
+{
+    std::map<uint64_t, proc_identity_t>::iterator parent = ps->identities.find(ppid);
+    proc_identity_t& id = ps->identities[pid];
+
+    if (parent != ps->identities.end()) {
+        id.name = parent->second.name;
+        id.args = parent->second.args;
+    } else {
+        id.name = istr_t();
+        id.args = istr_t();
+    }
+    id.start_ticks = 0;
+    id.ppid = ppid;
+    id.generation = 0;
+    id.announced = true;
+    id.sample_ms = 0;
+    return &id;
+}
+
+const proc_identity_t *proc_scanner_exec(proc_scanner_t *ps, uint64_t pid)
+{
+    char path[PATH_MAX];
+    size_t len;
+    proc_sample_t s;
+
+    if (ps->root.size() + 32 + NAME_MAX > sizeof(path)) {
+        return NULL;
+    }
+    memcpy(path, ps->root.c_str(), ps->root.size());
+    len = pid_path(ps, path, pid);
+
+    s.pid = pid;
+    strcpy(path + len, "stat");
+    if (!read_stat(&ps->file, path, &s)) {
+        return NULL;
+    }
+
+    /* Re-resolved as if new, but the CPU time carries on */
+    proc_identity_t& id = ps->identities[pid];
+    bool same = id.generation != 0 && id.start_ticks == s.start_ticks;
+    uint64_t sampleTicks = id.sample_ticks, sampleMs = id.sample_ms;
+
+    id.generation = 0;
+    id.announced = true;
+    resolve_identity(ps, path, len, s);
+    if (same) {
+        id.sample_ticks = sampleTicks;
+        id.sample_ms = sampleMs;
+    }
+    return &id;
+}
+
+bool proc_scanner_exit(proc_scanner_t *ps, uint64_t pid, proc_identity_t *last)
+{
+    std::map<uint64_t, proc_identity_t>::iterator it = ps->identities.find(pid);
+
+    if (it == ps->identities.end()) {
+        return false;
+    }
+    *last = it->second;
+    ps->identities.erase(it);
+    return true;
+}
+
+void proc_scanner_take_changes(proc_scanner_t *ps, std::vector<proc_change_t>& started,
+                               std::vector<proc_change_t>& exited)
+{
+    started.clear();
+    exited.clear();
+    started.swap(ps->started);
+    exited.swap(ps->exited);
+}
+
+uint64_t proc_scanner_start_us(proc_scanner_t *ps, uint64_t start_ticks)
+{
+    struct timespec now, boot;
+
+    /* start_ticks count from boot, suspend included */
+    clock_gettime(CLOCK_REALTIME, &now);
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+
+    uint64_t nowUs = (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    uint64_t upUs = (uint64_t) boot.tv_sec * 1000000 + boot.tv_nsec / 1000;
+    uint64_t startUs = start_ticks * 1000000 / ps->clk_tck;
+
+    return nowUs - upUs + startUs;
+}
@@ -0,0 +1,261 @@
+/**
+ * proc_scan.h
+ *
+ * Builds the process table directly from /proc/[pid] without
+ * spawning ps(1). A single pass over the pid directories reads stat
+ * and statm for every process. The table (see proc_table.h) is kept
+ * by the scanner and updated in place by every scan.
+ *
+ * The name and command line of a process do not change during its
+ * lifetime, so they are resolved once per process identity (pid and
+ * start time) and kept, interned, in an identity cache. cmdline is
+ * only read for processes not seen before, or whose comm changed
+ * (exec, prctl); every other process costs its counters only.
+ *
+ * The set of pids normally comes from walking /proc. With tracking on,
+ * the proc connector (see proc_connector.h) reports every fork, exec
+ * and exit to the scanner, and a scan visits the pids it knows instead;
+ * /proc is only walked again on request (resync) and every
+ * PROC_RESYNC_SCANS scans.
+ *
+ * A consumer can also ask for the processes found started and exited
+ * by the scans (report_changes), e.g. when no connector is available.
+ *
+ * With thousands of tasks the per-pid reads dominate a scan, and they
+ * can be shared by a pool of workers (see work_pool.h). The pids to
+ * visit are split into shards of PROC_SCAN_SHARD consecutive pids; each
+ * worker reads stat and statm of its shards into a partial table of its
+ * own, and once all are done the scanning thread merges the partials,
+ * which is where the identity cache and the intern pool are used.
+ *
+ * On request (io_sched), a scan also reads the I/O counters
+ * (/proc/<pid>/io), the run-queue wait (/proc/<pid>/schedstat) and the
+ * context switches (/proc/<pid>/status) of every process. That is
+ * three more reads per process, and io needs the ptrace access that
+ * only root has to other users' processes; its counters stay 0 where
+ * it cannot be read.
+ *
+ * The threads of a few chosen processes can be read too, from
+ * /proc/<pid>/task, with the same read buffer; their names and CPU time
+ * at the last read are kept like the identities, by pid and tid.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROC_SCAN_H
+#define PROC_SCAN_H
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "proc_reader.h"
+#include "proc_table.h"
+#include "intern.h"
+#include "work_pool.h"
+
+#define PROC_ROOT "/proc"
+
+/* While tracking, walk /proc anyway every this many scans */
+#define PROC_RESYNC_SCANS 60
+
+/* Scan workers at most, whatever is asked for */
+#define PROC_SCAN_MAX_WORKERS 8
+
+/* Consecutive pids read by a worker at a time */
+#define PROC_SCAN_SHARD 64
+
+/* Longest comm kept; a kernel worker's can be longer than TASK_COMM_LEN */
+#define PROC_COMM_MAX 64
+
+/* A thread of a process, see proc_scan_threads() */
+struct tinfo_t {
+    float cpu_pct;
+    char state;                 /* R, S, D, ... as in /proc/<pid>/stat */
+    uint64_t tid;
+    uint64_t cpu_usage_user;
+    uint64_t cpu_usage_system;
+    istr_t name;
+};
+
+typedef struct tinfo_t tinfo_t;
+
+/*
+ * What does not change while a process runs, and its CPU time at the
+ * last scan that saw it
+ */
+struct proc_identity_t {
+    uint64_t start_ticks;       /* since boot; a reused pid starts later */
+    uint64_t ppid;              /* when it was resolved */
+    istr_t name;
+    istr_t args;
+    unsigned int generation;    /* last scan that saw the process, 0: unresolved */
+    bool announced;             /* reported by an event, not a scan change */
+
+    uint64_t sample_ticks;      /* user + system */
+    uint64_t sample_ms;         /* 0: no sample yet */
+
+    uint32_t row;               /* in the table, if that row has this pid */
+};
+
+typedef struct proc_identity_t proc_identity_t;
+
+/* A thread at the last read of its process */
+struct proc_thread_t {
+    uint64_t start_ticks;       /* a reused tid starts later */
+    istr_t name;
+    uint64_t sample_ticks;      /* user + system */
+    uint64_t sample_ms;
+    unsigned int read;          /* read of the process that saw it */
+};
+
+typedef struct proc_thread_t proc_thread_t;
+
+/* By pid, then tid */
+typedef std::map<std::pair<uint64_t, uint64_t>, proc_thread_t> proc_threads_t;
+
+/* A process a scan found started (or exec'd) or gone */
+struct proc_change_t {
+    uint64_t pid;
+    bool exec;                  /* same process, new program (or name) */
+    proc_identity_t identity;
+};
+
+typedef struct proc_change_t proc_change_t;
+
+/* What a worker read of a process, merged into its row by the scanner */
+struct proc_sample_t {
+    uint64_t pid;
+    uint64_t ppid;
+    uint64_t flags;
+    uint64_t start_ticks;
+    uint64_t cpu_usage_user;
+    uint64_t cpu_usage_system;
+    uint64_t memory_usage;
+    uint64_t rss_kb;
+    uint64_t read_bytes;        /* with io_sched only */
+    uint64_t write_bytes;
+    uint64_t wait_ns;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    char state;
+    size_t comm_len;
+    char comm[PROC_COMM_MAX];
+};
+
+typedef struct proc_sample_t proc_sample_t;
+
+struct proc_scan_worker_t {
+    proc_file_t file;
+    std::vector<proc_sample_t> samples;     /* partial table of this scan */
+};
+
+typedef struct proc_scan_worker_t proc_scan_worker_t;
+
+struct proc_scanner_t {
+    std::string root;           /* normally PROC_ROOT */
+    proc_file_t file;           /* reused for every per-pid read */
+    long clk_tck;
+    long page_kb;
+    uint64_t mem_total_kb;
+
+    proc_table_t table;
+    std::map<uint64_t, proc_identity_t> identities;    /* by pid */
+    unsigned int generation;
+    std::string scratch;        /* cmdline being assembled */
+    uint64_t scan_ms;           /* CLOCK_BOOTTIME of the last scan */
+    bool io_sched;              /* read the I/O and scheduling counters too */
+
+    bool tracking;              /* identities follow fork/exec/exit events */
+    bool resync;                /* walk /proc on the next scan */
+    unsigned int scans_since_walk;
+
+    bool report_changes;
+    std::vector<proc_change_t> started;     /* since proc_scanner_take_changes() */
+    std::vector<proc_change_t> exited;
+
+    work_pool_t pool;
+    std::vector<proc_scan_worker_t> workers;    /* one per pool worker */
+    std::vector<uint64_t> pids;                 /* to visit, in shards */
+
+    proc_threads_t threads;     /* of the processes whose threads are read */
+    unsigned int thread_reads;
+};
+
+typedef struct proc_scanner_t proc_scanner_t;
+
+int proc_scanner_init(proc_scanner_t *ps, const char *root);
+void proc_scanner_free(proc_scanner_t *ps);
+
+/*
+ * Share the scans among 'workers' threads (1: scan on the calling
+ * thread only), at most PROC_SCAN_MAX_WORKERS and one per housekeeping
+ * CPU. Returns the number of workers used, or -1 with errno set.
+ */
+int proc_scanner_set_workers(proc_scanner_t *ps, unsigned int workers);
+
+/*
+ * Bring the table up to date: a row per live process, and by_cpu
+ * ordered by CPU utilization (highest first).
+ *
+ *   start_time         seconds elapsed since the process started (etimes)
+ *   cpu_usage_*        clock ticks spent in user/kernel mode
+ *   cpu_pct            CPU time since the previous scan / time since
+ *                      the previous scan, in percent of one core; over
+ *                      the lifetime of the process (pcpu) the first
+ *                      time it is seen
+ *   cpu_utilization    cpu_pct rounded, at most 255
+ *   memory_usage       data resident size in KiB (drs)
+ *   memory_utilization resident set / MemTotal, in percent (pmem)
+ *   start_ticks        clock ticks since boot the process started at;
+ *                      with the pid, tells a reused pid apart
+ *
+ * and, with io_sched, the counters since the process started:
+ *
+ *   read_bytes         bytes it caused to be read from storage
+ *   write_bytes        bytes it caused to be written to storage
+ *   wait_ns            time spent runnable, waiting for a CPU
+ *   *_switches         context switches: voluntary (it blocked) and
+ *                      involuntary (it was preempted)
+ *
+ * On failure the table is left as the last scan that succeeded made it.
+ */
+int proc_scan_processes(proc_scanner_t *ps);
+
+/*
+ * The same, for a reader between the regular scans: the CPU samples of
+ * the processes are left as the last proc_scan_processes() took them,
+ * so cpu_pct is over the time since then, and so is it again at the
+ * next regular scan.
+ */
+int proc_scan_refresh(proc_scanner_t *ps);
+
+/*
+ * Append the threads of process 'pid' to 'threads', in tid order.
+ * cpu_pct is over the time since the previous read of the same
+ * process (the lifetime of the thread the first time). The threads of
+ * a process are forgotten when it exits. Returns the number of threads
+ * appended, or -1 if the process is gone.
+ */
+int proc_scan_threads(proc_scanner_t *ps, uint64_t pid, std::vector<tinfo_t>& threads);
+
+/*
+ * Events from the proc connector, while tracking. A forked child takes
+ * the identity of its parent until the next scan resolves it; an exec
+ * re-reads the identity at once. Each returns the identity (the last
+ * one known, for an exit), or NULL if the process is not known or
+ * already gone.
+ */
+const proc_identity_t *proc_scanner_fork(proc_scanner_t *ps, uint64_t pid, uint64_t ppid);
+const proc_identity_t *proc_scanner_exec(proc_scanner_t *ps, uint64_t pid);
+bool proc_scanner_exit(proc_scanner_t *ps, uint64_t pid, proc_identity_t *last);
+
+/* Move the changes noted by the scans since the last call */
+void proc_scanner_take_changes(proc_scanner_t *ps, std::vector<proc_change_t>& started,
+                               std::vector<proc_change_t>& exited);
+
+/* Wall clock time a process with 'start_ticks' started at, in microseconds */
+uint64_t proc_scanner_start_us(proc_scanner_t *ps, uint64_t start_ticks);
+
+#endif
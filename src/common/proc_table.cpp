@@ -0,0 +1,192 @@
+/**
+ * proc_table.cpp
+ *
+ * The process table as columns.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <algorithm>
+
+#include "proc_table.h"
+
+void proc_table_init(proc_table_t *t)
+{
+    proc_table_free(t);
+
+    /* Id 0 is the empty name */
+    t->names.push_back(istr_t());
+    t->name_rows.push_back(0);
+}
+
+void proc_table_free(proc_table_t *t)
+{
+    t->pid.clear();
+    t->cpu_pct.clear();
+    t->cpu_utilization.clear();
+    t->memory_utilization.clear();
+    t->start_time.clear();
+    t->cpu_usage_user.clear();
+    t->cpu_usage_system.clear();
+    t->memory_usage.clear();
+    t->start_ticks.clear();
+    t->read_bytes.clear();
+    t->write_bytes.clear();
+    t->wait_ns.clear();
+    t->voluntary_switches.clear();
+    t->involuntary_switches.clear();
+    t->name_id.clear();
+    t->args.clear();
+    t->generation.clear();
+    t->by_cpu.clear();
+    t->names.clear();
+    t->name_rows.clear();
+    t->free_names.clear();
+    t->name_ids.clear();
+}
+
+uint32_t proc_table_add(proc_table_t *t, uint64_t pid)
+{
+    uint32_t row = proc_table_rows(t);
+
+    t->pid.push_back(pid);
+    t->cpu_pct.push_back(0);
+    t->cpu_utilization.push_back(0);
+    t->memory_utilization.push_back(0);
+    t->start_time.push_back(0);
+    t->cpu_usage_user.push_back(0);
+    t->cpu_usage_system.push_back(0);
+    t->memory_usage.push_back(0);
+    t->start_ticks.push_back(0);
+    t->read_bytes.push_back(0);
+    t->write_bytes.push_back(0);
+    t->wait_ns.push_back(0);
+    t->voluntary_switches.push_back(0);
+    t->involuntary_switches.push_back(0);
+    t->name_id.push_back(PROC_NO_NAME);
+    t->args.push_back(istr_t());
+    t->generation.push_back(0);
+
+    return row;
+}
+
+static void release_name(proc_table_t *t, uint32_t id)
+{
+    if (id != PROC_NO_NAME && --t->name_rows[id] == 0) {
+        t->name_ids.erase(t->names[id].entry);
+        t->names[id] = istr_t();
+        t->free_names.push_back(id);
+    }
+}
+
+void proc_table_remove(proc_table_t *t, uint32_t row)
+{
+    uint32_t last = proc_table_rows(t) - 1;
+
+    release_name(t, t->name_id[row]);
+
+    if (row != last) {
+        t->pid[row] = t->pid[last];
+        t->cpu_pct[row] = t->cpu_pct[last];
+        t->cpu_utilization[row] = t->cpu_utilization[last];
+        t->memory_utilization[row] = t->memory_utilization[last];
+        t->start_time[row] = t->start_time[last];
+        t->cpu_usage_user[row] = t->cpu_usage_user[last];
+        t->cpu_usage_system[row] = t->cpu_usage_system[last];
+        t->memory_usage[row] = t->memory_usage[last];
+        t->start_ticks[row] = t->start_ticks[last];
+        t->read_bytes[row] = t->read_bytes[last];
+        t->write_bytes[row] = t->write_bytes[last];
+        t->wait_ns[row] = t->wait_ns[last];
+        t->voluntary_switches[row] = t->voluntary_switches[last];
+        t->involuntary_switches[row] = t->involuntary_switches[last];
+        t->name_id[row] = t->name_id[last];
+        t->args[row] = t->args[last];
+        t->generation[row] = t->generation[last];
+    }
+
+    t->pid.pop_back();
+    t->cpu_pct.pop_back();
+    t->cpu_utilization.pop_back();
+    t->memory_utilization.pop_back();
+    t->start_time.pop_back();
+    t->cpu_usage_user.pop_back();
+    t->cpu_usage_system.pop_back();
+    t->memory_usage.pop_back();
+    t->start_ticks.pop_back();
+    t->read_bytes.pop_back();
+    t->write_bytes.pop_back();
+    t->wait_ns.pop_back();
+    t->voluntary_switches.pop_back();
+    t->involuntary_switches.pop_back();
+    t->name_id.pop_back();
+    t->args.pop_back();
+    t->generation.pop_back();
+}
+
+void proc_table_set_name(proc_table_t *t, uint32_t row, const istr_t& name)
+{
+    uint32_t id = PROC_NO_NAME;
+
+    if (name.entry != NULL) {
+        std::map<const istr_entry_t *, uint32_t>::iterator it = t->name_ids.find(name.entry);
+
+        if (it != t->name_ids.end()) {
+            id = it->second;
+        } else {
+            if (t->free_names.empty()) {
+                id = t->names.size();
+                t->names.push_back(name);
+                t->name_rows.push_back(0);
+            } else {
+                id = t->free_names.back();
+                t->free_names.pop_back();
+                t->names[id] = name;
+            }
+            t->name_ids.insert(std::make_pair(name.entry, id));
+        }
+        t->name_rows[id]++;
+    }
+
+    release_name(t, t->name_id[row]);
+    t->name_id[row] = id;
+}
+
+struct by_cpu_t {
+    const proc_table_t *t;
+
+    bool operator()(uint32_t a, uint32_t b) const
+    {
+        if (t->cpu_pct[a] != t->cpu_pct[b]) {
+            return t->cpu_pct[a] > t->cpu_pct[b];
+        }
+        return t->pid[a] < t->pid[b];
+    }
+};
+
+void proc_table_sort(proc_table_t *t)
+{
+    uint32_t rows = proc_table_rows(t);
+    by_cpu_t cmp;
+
+    t->by_cpu.resize(rows);
+    for (uint32_t row = 0; row < rows; row++) {
+        t->by_cpu[row] = row;
+    }
+
+    cmp.t = t;
+    std::sort(t->by_cpu.begin(), t->by_cpu.end(), cmp);
+}
+
+void proc_table_row(const proc_table_t *t, uint32_t row, pinfo_t *p)
+{
+    p->cpu_pct = t->cpu_pct[row];
+    p->cpu_utilization = t->cpu_utilization[row];
+    p->memory_utilization = t->memory_utilization[row];
+    p->pid = t->pid[row];
+    p->start_time = t->start_time[row];
+    p->cpu_usage_user = t->cpu_usage_user[row];
+    p->cpu_usage_system = t->cpu_usage_system[row];
+    p->memory_usage = t->memory_usage[row];
+    p->name = proc_table_name(t, row);
+    p->args = t->args[row];
+}
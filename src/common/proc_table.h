@@ -0,0 +1,109 @@
+/**
+ * proc_table.h
+ *
+ * The process table as columns: one array per field, a row per
+ * process. The table lives as long as the scanner that fills it; a
+ * scan updates the row of each process in place, appends the rows of
+ * new processes and removes those of the processes that are gone, by
+ * moving the last row into their place. Once the table has reached the
+ * largest number of processes seen, a scan does not allocate.
+ *
+ * Passes that only look at a few fields (summing CPU use, ranking)
+ * stride through those arrays alone. The names are kept as ids into a
+ * pool of the names in use, so that a row carries four bytes for its
+ * name and no reference to count; the command lines, read only when a
+ * process is encoded, stay interned strings.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROC_TABLE_H
+#define PROC_TABLE_H
+
+#include <inttypes.h>
+#include <vector>
+#include <map>
+
+#include "intern.h"
+
+/* Name id of the empty name, never released */
+#define PROC_NO_NAME 0
+
+/* A process, as one row of the table */
+struct pinfo_t {
+    float cpu_pct;
+    uint8_t cpu_utilization;
+    uint8_t memory_utilization;
+    uint64_t pid;
+    uint64_t start_time;
+    uint64_t cpu_usage_user;
+    uint64_t cpu_usage_system;
+    uint64_t memory_usage;
+    istr_t name;
+    istr_t args;                /* NUL separated, see istr_next_field() */
+};
+
+typedef struct pinfo_t pinfo_t;
+
+struct proc_table_t {
+    /* See proc_scan_processes() for the meaning of each column */
+    std::vector<uint64_t> pid;
+    std::vector<float> cpu_pct;
+    std::vector<uint8_t> cpu_utilization;
+    std::vector<uint8_t> memory_utilization;
+    std::vector<uint64_t> start_time;
+    std::vector<uint64_t> cpu_usage_user;
+    std::vector<uint64_t> cpu_usage_system;
+    std::vector<uint64_t> memory_usage;
+    std::vector<uint64_t> start_ticks;
+    std::vector<uint64_t> read_bytes;
+    std::vector<uint64_t> write_bytes;
+    std::vector<uint64_t> wait_ns;
+    std::vector<uint64_t> voluntary_switches;
+    std::vector<uint64_t> involuntary_switches;
+    std::vector<uint32_t> name_id;
+    std::vector<istr_t> args;
+    std::vector<unsigned int> generation;   /* scan that last updated the row */
+
+    std::vector<uint32_t> by_cpu;           /* rows, highest cpu_pct first */
+
+    /* Names in use, by id; an id is reused once no row has its name */
+    std::vector<istr_t> names;
+    std::vector<uint32_t> name_rows;
+    std::vector<uint32_t> free_names;
+    std::map<const istr_entry_t *, uint32_t> name_ids;
+};
+
+typedef struct proc_table_t proc_table_t;
+
+void proc_table_init(proc_table_t *t);
+void proc_table_free(proc_table_t *t);
+
+static inline uint32_t proc_table_rows(const proc_table_t *t)
+{
+    return t->pid.size();
+}
+
+static inline const istr_t& proc_table_name(const proc_table_t *t, uint32_t row)
+{
+    return t->names[t->name_id[row]];
+}
+
+/* A row for 'pid', with no name and every counter 0 */
+uint32_t proc_table_add(proc_table_t *t, uint64_t pid);
+
+/*
+ * Remove a row. The last row takes its place, so the row index of the
+ * process that was last changes; 'row' is then that process's row, if
+ * there is one left after it.
+ */
+void proc_table_remove(proc_table_t *t, uint32_t row);
+
+void proc_table_set_name(proc_table_t *t, uint32_t row, const istr_t& name);
+
+/* Order the rows by CPU use into by_cpu, ties by pid */
+void proc_table_sort(proc_table_t *t);
+
+/* A copy of a row, for the consumers that keep processes around */
+void proc_table_row(const proc_table_t *t, uint32_t row, pinfo_t *p);
+
+#endif
@@ -0,0 +1,577 @@
+/**
+ * proc_table_test.cpp
+ *
+ * Scans a synthetic /proc while processes come and go, and checks the
+ * table after every scan: a row per live process with all of its
+ * columns, the identity of each process pointing at its row, and the
+ * name pool counting the rows of each name, with the ids of unused
+ * names reused. Run with one and with several scan workers, started
+ * whatever the number of CPUs: the workers read shards of the pids into
+ * partials, merged in a different order. A refresh between scans keeps
+ * the CPU samples the scans measure from, and cpu_pct is the share of
+ * the interval between scans, or of the lifetime of a process seen
+ * first. So is a thread's, between reads of its process, and a reused
+ * tid is read as a new thread.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "proc_scan.h"
+#include "proc_fixture.h"
+#include "unit_test.h"
+
+/* A process of the fixture */
+struct fproc_t {
+    std::string name;
+    uint64_t start_ticks;
+};
+
+typedef struct fproc_t fproc_t;
+
+static std::string root;
+static std::map<uint64_t, fproc_t> live;
+
+/* The scanner's notes stay out of the test output */
+static std::ofstream devnull("/dev/null");
+
+/* A new process, or a new program in the same one if 'pid' is live */
+static void add_process(uint64_t pid, const std::string& name, uint64_t start_ticks)
+{
+    fixture_proc_t p;
+
+    /* utime and stime tell the rows apart, see check_table() */
+    fixture_proc_init(&p, name, start_ticks);
+    p.utime = pid * 2;
+    p.stime = pid * 3;
+    fixture_write_process(root, pid, p);
+
+    fproc_t f;
+    f.name = name;
+    f.start_ticks = start_ticks;
+    live[pid] = f;
+}
+
+static void remove_process(uint64_t pid)
+{
+    fixture_remove_process(root, pid);
+    live.erase(pid);
+}
+
+static void check_table(proc_scanner_t *ps)
+{
+    const proc_table_t *t = &ps->table;
+    uint32_t rows = proc_table_rows(t);
+
+    CHECK(rows == live.size());
+
+    /* Every column has a value per row */
+    CHECK(t->cpu_pct.size() == rows && t->start_ticks.size() == rows &&
+          t->cpu_usage_user.size() == rows && t->cpu_usage_system.size() == rows &&
+          t->memory_usage.size() == rows && t->name_id.size() == rows &&
+          t->args.size() == rows && t->generation.size() == rows &&
+          t->read_bytes.size() == rows && t->involuntary_switches.size() == rows);
+    CHECK(t->by_cpu.size() == rows);
+
+    std::map<uint64_t, uint32_t> seen;
+    std::vector<uint32_t> name_rows(t->names.size(), 0);
+
+    for (uint32_t row = 0; row < rows; row++) {
+        uint64_t pid = t->pid[row];
+
+        CHECK(seen.insert(std::make_pair(pid, row)).second);   /* one row per pid */
+
+        std::map<uint64_t, fproc_t>::const_iterator p = live.find(pid);
+        CHECK(p != live.end());
+        if (p == live.end()) {
+            continue;
+        }
+
+        /* The columns of the row are those of its process */
+        CHECK(t->start_ticks[row] == p->second.start_ticks);
+        CHECK(t->cpu_usage_user[row] == pid * 2);
+        CHECK(t->cpu_usage_system[row] == pid * 3);
+        CHECK(t->generation[row] == ps->generation);
+        CHECK(proc_table_name(t, row).c_str() == p->second.name);
+        CHECK(istr_fields(t->args[row]) == 3);
+        CHECK(strcmp(istr_next_field(t->args[row], NULL),
+                     ("/usr/bin/" + p->second.name).c_str()) == 0);
+
+        /* The identity of the process points at its row */
+        std::map<uint64_t, proc_identity_t>::const_iterator id = ps->identities.find(pid);
+        CHECK(id != ps->identities.end());
+        if (id != ps->identities.end()) {
+            CHECK(id->second.row == row);
+            CHECK(id->second.row < rows && t->pid[id->second.row] == pid);
+            CHECK(id->second.name == proc_table_name(t, row));
+        }
+
+        CHECK(t->name_id[row] < t->names.size());
+        if (t->name_id[row] < t->names.size()) {
+            name_rows[t->name_id[row]]++;
+        }
+    }
+
+    /* The name pool counts the rows of each name */
+    CHECK(t->name_rows.size() == t->names.size());
+    CHECK(t->names[PROC_NO_NAME].entry == NULL);
+
+    size_t used = 0;
+    for (uint32_t id = 1; id < t->names.size(); id++) {
+        CHECK(t->name_rows[id] == name_rows[id]);
+        if (t->name_rows[id] > 0) {
+            used++;
+            std::map<const istr_entry_t *, uint32_t>::const_iterator it =
+                t->name_ids.find(t->names[id].entry);
+            CHECK(it != t->name_ids.end() && it->second == id);
+        } else {
+            CHECK(t->names[id].entry == NULL);
+        }
+    }
+    CHECK(t->name_ids.size() == used);
+    CHECK(used + t->free_names.size() + 1 == t->names.size());
+
+    /* by_cpu holds every row once */
+    std::vector<bool> ranked(rows, false);
+    for (size_t i = 0; i < t->by_cpu.size(); i++) {
+        CHECK(t->by_cpu[i] < rows && !ranked[t->by_cpu[i]]);
+        if (t->by_cpu[i] < rows) {
+            ranked[t->by_cpu[i]] = true;
+        }
+    }
+}
+
+static void scan(proc_scanner_t *ps)
+{
+    CHECK(proc_scan_processes(ps) == 0);
+    check_table(ps);
+
+    /* The partials of the workers hold each process read once */
+    size_t read = 0;
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        read += ps->workers[w].samples.size();
+    }
+    CHECK(read == live.size());
+}
+
+/*
+ * proc_scanner_set_workers() takes one worker per housekeeping CPU, so
+ * on a machine with a single one the pool is started here instead
+ */
+static void set_workers(proc_scanner_t *ps, unsigned int workers)
+{
+    if (proc_scanner_set_workers(ps, workers) == (int) workers) {
+        return;
+    }
+
+    work_pool_free(&ps->pool);
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        proc_file_free(&ps->workers[w].file);
+    }
+    CHECK(work_pool_init(&ps->pool, workers, NULL) == 0);
+    ps->workers.resize(ps->pool.size);
+    for (size_t w = 0; w < ps->workers.size(); w++) {
+        proc_file_init(&ps->workers[w].file);
+    }
+}
+
+static std::string agent_name(int i)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "agent-%d", i);
+    return buf;
+}
+
+static void run(unsigned int workers)
+{
+    proc_scanner_t ps;
+
+    root = fixture_make("proc_table_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        return;
+    }
+    CHECK(proc_scanner_init(&ps, root.c_str()) == 0);
+    if (workers > 1) {
+        set_workers(&ps, workers);
+        CHECK(ps.pool.size == workers && ps.workers.size() == workers);
+    }
+
+    /* 300 processes, seven names */
+    for (uint64_t pid = 1; pid <= 300; pid++) {
+        add_process(pid, agent_name(pid % 7), 100 + pid);
+    }
+    scan(&ps);
+    CHECK(ps.table.names.size() == 8);
+
+    /* Unchanged */
+    scan(&ps);
+
+    /* Holes all over the table, and its last rows */
+    for (uint64_t pid = 3; pid <= 300; pid += 3) {
+        remove_process(pid);
+    }
+    for (uint64_t pid = 290; pid <= 300; pid++) {
+        remove_process(pid);
+    }
+    scan(&ps);
+
+    /* Every process of a name gone: its id is freed */
+    for (uint64_t pid = 1; pid <= 300; pid++) {
+        if (pid % 7 == 4) {
+            remove_process(pid);
+        }
+    }
+    scan(&ps);
+    CHECK(ps.table.free_names.size() == 1);
+
+    /* A new name takes the freed id, the pool does not grow */
+    size_t names = ps.table.names.size();
+    for (uint64_t pid = 400; pid < 420; pid++) {
+        add_process(pid, "collector", 1000 + pid);
+    }
+    scan(&ps);
+    CHECK(ps.table.names.size() == names);
+    CHECK(ps.table.free_names.empty());
+
+    /* Reused pids: a later start and another name */
+    for (uint64_t pid = 3; pid <= 60; pid += 3) {
+        add_process(pid, "worker", 5000 + pid);
+    }
+    scan(&ps);
+
+    /* A new program in live processes (exec), and pids reused in place */
+    for (uint64_t pid = 1; pid <= 40; pid += 2) {
+        if (live.find(pid) != live.end()) {
+            add_process(pid, "exec-" + agent_name(pid % 3), live[pid].start_ticks);
+        }
+    }
+    for (uint64_t pid = 100; pid <= 140; pid++) {
+        if (live.find(pid) != live.end()) {
+            add_process(pid, agent_name(pid % 11), 9000 + pid);
+        }
+    }
+    scan(&ps);
+
+    /* Churn: remove and add at once, a few rounds */
+    for (uint64_t round = 0; round < 10; round++) {
+        std::vector<uint64_t> gone;
+        std::map<uint64_t, fproc_t>::iterator it;
+        uint64_t i = 0;
+        for (it = live.begin(); it != live.end(); ++it, i++) {
+            if ((i + round) % 5 == 0) {
+                gone.push_back(it->first);
+            }
+        }
+        for (size_t g = 0; g < gone.size(); g++) {
+            remove_process(gone[g]);
+        }
+        for (uint64_t pid = 500 + round * 30; pid < 530 + round * 30; pid++) {
+            add_process(pid, agent_name((pid + round) % 13), 20000 + pid);
+        }
+        scan(&ps);
+    }
+
+    /* All gone: only the empty name is left */
+    std::vector<uint64_t> all;
+    for (std::map<uint64_t, fproc_t>::iterator it = live.begin(); it != live.end(); ++it) {
+        all.push_back(it->first);
+    }
+    for (size_t i = 0; i < all.size(); i++) {
+        remove_process(all[i]);
+    }
+    scan(&ps);
+    CHECK(proc_table_rows(&ps.table) == 0);
+    CHECK(ps.table.name_ids.empty());
+    CHECK(ps.table.free_names.size() + 1 == ps.table.names.size());
+
+    proc_scanner_free(&ps);
+    fixture_remove(root);
+}
+
+/*
+ * A refresh between scans keeps the CPU samples of the processes it
+ * had, so the next scan still measures from the one before; a process
+ * it sees first is sampled by it.
+ */
+static void test_refresh(void)
+{
+    proc_scanner_t ps;
+
+    root = fixture_make("proc_table_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        return;
+    }
+    CHECK(proc_scanner_init(&ps, root.c_str()) == 0);
+
+    add_process(10, "agent", 100);
+    scan(&ps);
+    proc_identity_t before = ps.identities[10];
+    CHECK(before.sample_ms == ps.scan_ms && before.sample_ticks == 10 * 5);
+
+    add_process(10, "agent", 100);      /* same counters */
+    add_process(11, "worker", 200);
+    usleep(20000);
+    CHECK(proc_scan_refresh(&ps) == 0);
+    check_table(&ps);
+    CHECK(ps.scan_ms > before.sample_ms);
+    CHECK(ps.identities[10].sample_ms == before.sample_ms);
+    CHECK(ps.identities[10].sample_ticks == before.sample_ticks);
+    CHECK(ps.identities[11].sample_ms == ps.scan_ms);
+
+    scan(&ps);
+    CHECK(ps.identities[10].sample_ms == ps.scan_ms);
+
+    proc_scanner_free(&ps);
+    fixture_remove(root);
+    live.clear();
+}
+
+/* The row of 'pid' in the table */
+static uint32_t row_of(proc_scanner_t *ps, uint64_t pid)
+{
+    return ps->identities[pid].row;
+}
+
+static bool near(float a, float b)
+{
+    return a - b < 0.01f && b - a < 0.01f;
+}
+
+/*
+ * cpu_pct: the lifetime average for a process seen for the first time
+ * (or whose pid was reused), then the share of the interval between
+ * two scans, from the samples the scanner keeps per process.
+ */
+static void test_cpu_pct(void)
+{
+    proc_scanner_t ps;
+    fixture_proc_t busy, idle, future;
+
+    root = fixture_make("proc_table_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        return;
+    }
+    CHECK(proc_scanner_init(&ps, root.c_str()) == 0);
+    uint64_t hz = ps.clk_tck;
+
+    /* Up for 100 s, 25 s of it on the CPU; up for 1000 s, 1 s of it */
+    fixture_proc_init(&busy, "busy", (FIXTURE_UPTIME - 100) * hz);
+    busy.utime = 20 * hz;
+    busy.stime = 5 * hz;
+    fixture_write_process(root, 20, busy);
+    fixture_proc_init(&idle, "idle", (FIXTURE_UPTIME - 1000) * hz);
+    idle.utime = hz;
+    fixture_write_process(root, 21, idle);
+    /* Started after the uptime read: no lifetime to divide by */
+    fixture_proc_init(&future, "future", (FIXTURE_UPTIME + 10) * hz);
+    future.utime = hz;
+    fixture_write_process(root, 22, future);
+
+    CHECK(proc_scan_processes(&ps) == 0);
+    const proc_table_t *t = &ps.table;
+    CHECK(near(t->cpu_pct[row_of(&ps, 20)], 25.0f));
+    CHECK(t->cpu_utilization[row_of(&ps, 20)] == 25);
+    CHECK(near(t->cpu_pct[row_of(&ps, 21)], 0.1f));
+    CHECK(t->cpu_utilization[row_of(&ps, 21)] == 0);
+    CHECK(t->cpu_pct[row_of(&ps, 22)] == 0.0f);
+    CHECK(t->by_cpu.size() == 3 && t->by_cpu[0] == row_of(&ps, 20));
+    CHECK(ps.identities[20].sample_ticks == 25 * hz);
+
+    /*
+     * Over the interval: 20 idles, 21 uses half a second. The interval
+     * is the one the scanner measured between its two scans.
+     */
+    uint64_t sampled = ps.identities[21].sample_ms;
+    idle.utime += hz / 2;
+    fixture_write_process(root, 21, idle);
+    usleep(200000);
+    CHECK(proc_scan_processes(&ps) == 0);
+    CHECK(ps.scan_ms > sampled);
+    float expected = 50000.0f / (float) (ps.scan_ms - sampled);
+    CHECK(t->cpu_pct[row_of(&ps, 20)] == 0.0f);
+    CHECK(near(t->cpu_pct[row_of(&ps, 21)], expected));
+    CHECK(t->cpu_utilization[row_of(&ps, 21)] == (uint8_t) (expected + 0.5f));
+    CHECK(t->by_cpu[0] == row_of(&ps, 21));
+    CHECK(ps.identities[21].sample_ms == ps.scan_ms);
+
+    /* A reused pid measures from its own start, not the old counters */
+    fixture_proc_init(&busy, "busy", (FIXTURE_UPTIME - 10) * hz);
+    busy.utime = hz;
+    fixture_write_process(root, 20, busy);
+    usleep(20000);
+    CHECK(proc_scan_processes(&ps) == 0);
+    CHECK(near(t->cpu_pct[row_of(&ps, 20)], 10.0f));
+    CHECK(ps.identities[20].sample_ticks == hz);
+
+    proc_scanner_free(&ps);
+    fixture_remove(root);
+}
+
+/* Seconds since boot, as the thread reads measure */
+static uint64_t boot_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return now.tv_sec;
+}
+
+/* The sample the scanner keeps for a thread; NULL if it forgot it */
+static const proc_thread_t *thread_of(proc_scanner_t *ps, uint64_t pid, uint64_t tid)
+{
+    proc_threads_t::const_iterator it = ps->threads.find(std::make_pair(pid, tid));
+    return (it != ps->threads.end()) ? &it->second : NULL;
+}
+
+/* A thread's lifetime average, to the time the read sampled it at */
+static float lifetime_pct(const fixture_proc_t& t, uint64_t hz, uint64_t sample_ms)
+{
+    return (float) (t.utime + t.stime) * 100000 / hz /
+           (float) (sample_ms - t.start_ticks * 1000 / hz);
+}
+
+/*
+ * Threads: in tid order with their own counters, cpu_pct over their
+ * lifetime at the first read and over the interval since the last read
+ * of the process after, a reused tid measured from its own start, and
+ * the threads that went away forgotten, with their process or alone.
+ */
+static void test_threads(void)
+{
+    proc_scanner_t ps;
+    fixture_proc_t main, worker, helper, other;
+    std::vector<tinfo_t> threads;
+
+    root = fixture_make("proc_table_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        return;
+    }
+    CHECK(proc_scanner_init(&ps, root.c_str()) == 0);
+    uint64_t hz = ps.clk_tck;
+    uint64_t boot = boot_seconds();
+
+    /* Up for 10 s, 100 s and 20 s, on the clock of the reads */
+    add_process(50, "server", 100);
+    add_process(60, "client", 100);
+    fixture_proc_init(&main, "server", (boot - 10) * hz);
+    main.utime = 2 * hz;
+    main.stime = hz / 2;
+    fixture_proc_init(&worker, "server-worker", (boot - 100) * hz);
+    worker.utime = 10 * hz;
+    fixture_proc_init(&helper, "server-io", (boot - 20) * hz);
+    helper.utime = hz;
+    fixture_proc_init(&other, "client", (boot - 10) * hz);
+    fixture_write_thread(root, 50, 52, helper);
+    fixture_write_thread(root, 50, 50, main);
+    fixture_write_thread(root, 50, 51, worker);
+    fixture_write_thread(root, 60, 60, other);
+    scan(&ps);
+
+    /* Appended to what the vector holds, in tid order */
+    threads.resize(1);
+    threads[0].tid = 999;
+    CHECK(proc_scan_threads(&ps, 50, threads) == 3);
+    CHECK(threads.size() == 4 && threads[0].tid == 999);
+    CHECK(threads[1].tid == 50 && threads[2].tid == 51 && threads[3].tid == 52);
+    CHECK(strcmp(threads[1].name.c_str(), "server") == 0);
+    CHECK(strcmp(threads[2].name.c_str(), "server-worker") == 0);
+    CHECK(threads[2].state == 'S');
+    CHECK(threads[1].cpu_usage_user == 2 * hz && threads[1].cpu_usage_system == hz / 2);
+    CHECK(thread_of(&ps, 50, 50) != NULL);
+    CHECK(thread_of(&ps, 50, 50)->sample_ticks == 2 * hz + hz / 2);
+    CHECK(ps.threads.size() == 3);
+
+    /* The first read: over each thread's lifetime, about 25%, 10% and 5% */
+    uint64_t sampled = thread_of(&ps, 50, 50)->sample_ms;
+    CHECK(near(threads[1].cpu_pct, lifetime_pct(main, hz, sampled)));
+    CHECK(near(threads[2].cpu_pct, lifetime_pct(worker, hz, sampled)));
+    CHECK(near(threads[3].cpu_pct, lifetime_pct(helper, hz, sampled)));
+    CHECK(threads[1].cpu_pct > 22.5f && threads[1].cpu_pct <= 25.0f);   /* boot: whole seconds */
+
+    /* The next read: over the interval since, measured by the scanner */
+    threads.clear();
+    worker.utime += hz / 4;
+    fixture_write_thread(root, 50, 51, worker);
+    usleep(200000);
+    CHECK(proc_scan_threads(&ps, 50, threads) == 3);
+    const proc_thread_t *th = thread_of(&ps, 50, 51);
+    CHECK(th != NULL && th->sample_ms > sampled);
+    if (th != NULL && th->sample_ms > sampled) {
+        CHECK(near(threads[1].cpu_pct, 25000.0f / (float) (th->sample_ms - sampled)));
+    }
+    CHECK(threads[0].cpu_pct == 0.0f && threads[2].cpu_pct == 0.0f);
+
+    /*
+     * A reused tid: a later start and more CPU time than the thread
+     * before it. From the old sample, 52 would have used 100% of the
+     * interval; from its own start, 4 s ago, it used half of it.
+     */
+    threads.clear();
+    fixture_proc_init(&helper, "server-io2", (boot_seconds() - 4) * hz);
+    helper.utime = 2 * hz;
+    fixture_write_thread(root, 50, 52, helper);
+    usleep(20000);
+    CHECK(proc_scan_threads(&ps, 50, threads) == 3);
+    th = thread_of(&ps, 50, 52);
+    CHECK(th != NULL && th->start_ticks == helper.start_ticks && th->sample_ticks == 2 * hz);
+    if (th != NULL) {
+        CHECK(near(threads[2].cpu_pct, lifetime_pct(helper, hz, th->sample_ms)));
+    }
+    CHECK(threads[2].cpu_pct > 39.0f && threads[2].cpu_pct <= 50.0f);
+    CHECK(strcmp(threads[2].name.c_str(), "server-io2") == 0);
+
+    /* A thread that exited is forgotten; those of another process are not */
+    CHECK(proc_scan_threads(&ps, 60, threads) == 1);
+    fixture_remove_thread(root, 50, 51);
+    threads.clear();
+    CHECK(proc_scan_threads(&ps, 50, threads) == 2);
+    CHECK(threads.size() == 2 && threads[0].tid == 50 && threads[1].tid == 52);
+    CHECK(thread_of(&ps, 50, 51) == NULL);
+    CHECK(thread_of(&ps, 60, 60) != NULL);
+
+    /* A tid that comes back is new again: its lifetime, not the interval */
+    threads.clear();
+    fixture_write_thread(root, 50, 51, worker);
+    CHECK(proc_scan_threads(&ps, 50, threads) == 3);
+    th = thread_of(&ps, 50, 51);
+    if (th != NULL) {
+        CHECK(near(threads[1].cpu_pct, lifetime_pct(worker, hz, th->sample_ms)));
+    }
+
+    /* A process gone: no threads to read, and the scan forgets them */
+    remove_process(50);
+    threads.clear();
+    CHECK(proc_scan_threads(&ps, 50, threads) == -1);
+    CHECK(threads.empty());
+    scan(&ps);
+    CHECK(ps.threads.size() == 1 && thread_of(&ps, 60, 60) != NULL);
+
+    proc_scanner_free(&ps);
+    fixture_remove(root);
+    live.clear();
+}
+
+int main(void)
+{
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+
+    run(1);
+    run(3);
+    test_refresh();
+    test_cpu_pct();
+    test_threads();
+
+    std::cout.rdbuf(out);
+    return test_result("proc_table_test");
+}
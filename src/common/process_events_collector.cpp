@@ -0,0 +1,252 @@
+/**
+ * process_events_collector.cpp
+ *
+ * process-start and process-exit notifications, from the proc
+ * connector or from successive scans.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "openconfig-procmon-ext.h"
+#include "proc_connector.h"
+#include "process_events_collector.h"
+
+/* process-start: begin/end, pid, parent-pid, reason, name, args, source */
+#define START_TAGS 8
+
+static int connector_fd = -1;
+static bool catch_up;           /* events were dropped, rescan */
+
+static tv_arena_t events_arena;
+static std::vector<confd_value_t> event_args;
+
+static std::vector<proc_event_t> events;
+static std::vector<proc_change_t> started;
+static std::vector<proc_change_t> exited;
+
+static void timeval_from_us(struct timeval *tv, uint64_t us)
+{
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+}
+
+/* Wall clock time of a CLOCK_MONOTONIC time stamp */
+static void timeval_from_monotonic(struct timeval *tv, uint64_t time_ns)
+{
+    struct timespec now, mono;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+
+    uint64_t nowUs = (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    uint64_t monoNs = (uint64_t) mono.tv_sec * 1000000000 + mono.tv_nsec;
+    uint64_t agoUs = (monoNs > time_ns) ? (monoNs - time_ns) / 1000 : 0;
+
+    timeval_from_us(tv, nowUs - agoUs);
+}
+
+static void send_start(confd_agent_t *agent, uint64_t pid, bool exec, const proc_identity_t *id,
+                       int source, const struct timeval *when)
+{
+    tv_arena_reset(&events_arena);
+    tv_arena_reserve(&events_arena, START_TAGS);
+
+    confd_tag_value_t *tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_process_start, oc_proc_ext__ns);
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_pid, pid);
+    if (id != NULL && id->ppid != 0) {
+        tv = tv_arena_next(&events_arena);
+        CONFD_SET_TAG_UINT64(tv, oc_proc_ext_parent_pid, id->ppid);
+    }
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_ENUM_VALUE(tv, oc_proc_ext_reason, exec ? oc_proc_ext_exec : oc_proc_ext_fork);
+
+    if (id != NULL && id->name.size() > 0) {
+        tv = tv_arena_next(&events_arena);
+        CONFD_SET_TAG_STR(tv, oc_proc_ext_name, id->name.c_str());
+    }
+    if (id != NULL && istr_fields(id->args) > 0) {
+        event_args.clear();
+        for (const char *a = istr_next_field(id->args, NULL); a != NULL;
+             a = istr_next_field(id->args, a)) {
+            confd_value_t v;
+            CONFD_SET_STR(&v, a);
+            event_args.push_back(v);
+        }
+        tv = tv_arena_next(&events_arena);
+        CONFD_SET_TAG_LIST(tv, oc_proc_ext_args, &event_args[0], event_args.size());
+    }
+
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_ENUM_VALUE(tv, oc_proc_ext_source, source);
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_process_start, oc_proc_ext__ns);
+
+    confd_agent_send_notification_at(agent, &events_arena, when);
+}
+
+static void send_exit(confd_agent_t *agent, uint64_t pid, const proc_identity_t *id,
+                      int status, int signal, int source, const struct timeval *when)
+{
+    tv_arena_reset(&events_arena);
+    tv_arena_reserve(&events_arena, START_TAGS);
+
+    confd_tag_value_t *tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_process_exit, oc_proc_ext__ns);
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_pid, pid);
+    if (id != NULL && id->name.size() > 0) {
+        tv = tv_arena_next(&events_arena);
+        CONFD_SET_TAG_STR(tv, oc_proc_ext_name, id->name.c_str());
+    }
+    if (status >= 0) {
+        tv = tv_arena_next(&events_arena);
+        CONFD_SET_TAG_UINT8(tv, oc_proc_ext_exit_status, (uint8_t) status);
+    }
+    if (signal > 0) {
+        tv = tv_arena_next(&events_arena);
+        CONFD_SET_TAG_UINT8(tv, oc_proc_ext_exit_signal, (uint8_t) signal);
+    }
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_ENUM_VALUE(tv, oc_proc_ext_source, source);
+    tv = tv_arena_next(&events_arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_process_exit, oc_proc_ext__ns);
+
+    confd_agent_send_notification_at(agent, &events_arena, when);
+}
+
+static void stop_connector(scheduler_t *sched)
+{
+    reactor_del_fd(&sched->reactor, connector_fd);
+    proc_connector_close(connector_fd);
+    connector_fd = -1;
+    sched->sampler->scanner.tracking = false;
+}
+
+static void connector_ready(int fd, uint32_t mask, void *opaque)
+{
+    scheduler_t *sched = (scheduler_t *) opaque;
+    proc_scanner_t *ps = &sched->sampler->scanner;
+    struct timeval when;
+    proc_identity_t last;
+
+    events.clear();
+    if (proc_connector_read(fd, events) < 0) {
+        if (errno == ENOBUFS) {
+            std::cout << "Proc connector: events dropped, rescanning" << std::endl;
+            ps->resync = true;
+            catch_up = true;
+        } else {
+            std::cout << "Proc connector: " << strerror(errno)
+                      << ", reporting process changes from scans" << std::endl;
+            stop_connector(sched);
+        }
+    }
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const proc_event_t& ev = events[i];
+
+        timeval_from_monotonic(&when, ev.time_ns);
+
+        switch (ev.type) {
+        case PROC_EV_FORK:
+            send_start(sched->agent, ev.pid, false, proc_scanner_fork(ps, ev.pid, ev.ppid),
+                       oc_proc_ext_proc_connector, &when);
+            break;
+        case PROC_EV_EXEC:
+            send_start(sched->agent, ev.pid, true, proc_scanner_exec(ps, ev.pid),
+                       oc_proc_ext_proc_connector, &when);
+            break;
+        case PROC_EV_EXIT:
+            send_exit(sched->agent, ev.pid, proc_scanner_exit(ps, ev.pid, &last) ? &last : NULL,
+                      ev.exit_status, ev.exit_signal, oc_proc_ext_proc_connector, &when);
+            break;
+        }
+    }
+}
+
+static void start_process_events(collector_t *c, scheduler_t *sched)
+{
+    proc_scanner_t *ps = &sched->sampler->scanner;
+
+    tv_arena_init(&events_arena, "process-events", START_TAGS);
+    confd_agent_register_stream(sched->agent);
+
+    /* Listen before the baseline scan, so that nothing falls in between */
+    if ((connector_fd = proc_connector_open()) < 0) {
+        std::cout << "Proc connector: not available (" << strerror(errno)
+                  << "), reporting process changes from scans" << std::endl;
+    } else {
+        if (reactor_add_fd(&sched->reactor, connector_fd, EPOLLIN, connector_ready, sched) < 0) {
+            confd_fatal("Failed to watch the proc connector\n");
+        }
+        ps->tracking = true;
+        ps->resync = true;
+        std::cout << "Proc connector: following process events" << std::endl;
+    }
+
+    /* The processes already running are not news */
+    sampler_processes(sched->sampler);
+    ps->report_changes = true;
+}
+
+/*
+ * Report what the scans found changed. Without the connector this
+ * scans; with it, the scans that other collectors cause find nothing
+ * the events did not report, except after events were dropped.
+ */
+static int send_notif_process_events(collector_t *c, scheduler_t *sched)
+{
+    proc_scanner_t *ps = &sched->sampler->scanner;
+    struct timeval now, when;
+
+    if (connector_fd < 0 || catch_up) {
+        sampler_processes(sched->sampler);
+        catch_up = false;
+    }
+
+    proc_scanner_take_changes(ps, started, exited);
+    if (started.empty() && exited.empty()) {
+        return CONFD_OK;
+    }
+
+    gettimeofday(&now, NULL);
+
+    for (size_t i = 0; i < exited.size(); i++) {
+        send_exit(sched->agent, exited[i].pid, &exited[i].identity, -1, 0, oc_proc_ext_scan, &now);
+    }
+    for (size_t i = 0; i < started.size(); i++) {
+        const proc_change_t& s = started[i];
+
+        if (s.exec) {
+            when = now;
+        } else {
+            timeval_from_us(&when, proc_scanner_start_us(ps, s.identity.start_ticks));
+        }
+        send_start(sched->agent, s.pid, s.exec, &s.identity, oc_proc_ext_scan, &when);
+    }
+
+    std::cout << "Process events from scan: " << started.size() << " started, "
+              << exited.size() << " exited" << std::endl;
+
+    return CONFD_OK;
+}
+
+collector_t process_events_collector = {
+    "process-events",
+    true,                       /* adaptive */
+    INTERVAL,
+    false,                      /* on_demand */
+    start_process_events,
+    send_notif_process_events,
+    NULL,                       /* cadence */
+    0
+};
@@ -0,0 +1,26 @@
+/**
+ * process_events_collector.h
+ *
+ * Streams process-start and process-exit notifications, so that
+ * subscribers no longer infer exits by diffing successive snapshots.
+ *
+ * Where the proc connector is available (see proc_connector.h), each
+ * fork, exec and exit is sent as the kernel reports it, stamped with
+ * the time it happened, and the shared process scanner follows the
+ * same events instead of walking /proc on every scan. If events are
+ * dropped, the next scan walks /proc and reports what was missed.
+ *
+ * Without the connector (no CAP_NET_ADMIN, or a kernel without
+ * CONFIG_PROC_EVENTS) the processes found started and gone by
+ * successive scans are reported instead, at the stream interval.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROCESS_EVENTS_COLLECTOR_H
+#define PROCESS_EVENTS_COLLECTOR_H
+
+#include "scheduler.h"
+
+extern collector_t process_events_collector;
+
+#endif
@@ -0,0 +1,803 @@
+/**
+ * process_stats_collector.cpp
+ *
+ * Streams per-process statistics for all the processes, or for the
+ * selection made by name patterns and top-K ranking.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <map>
+
+#include <regex.h>
+
+#include "openconfig-procmon-ext.h"
+#include "process_stats_collector.h"
+
+process_stats_opts_t process_stats_opts = {
+    false,
+    DELTA_DEADBAND,
+    DELTA_SYNC_CYCLES,
+    0,                          /* top_k */
+    PROCESS_RANK_CPU,
+    false                       /* io_sched */
+};
+
+/* By process_rank_t */
+static const char *rank_keys[] = { "cpu", "memory", "io", "wait", "switches", NULL };
+
+/* I/O and scheduling counters of a process, see proc_scan_processes() */
+struct pio_t {
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint64_t wait_ns;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+};
+
+typedef struct pio_t pio_t;
+
+/* The counters of a process at the previous notification */
+struct pio_last_t {
+    uint64_t start_ticks;
+    pio_t counters;
+    unsigned int generation;    /* 0: not seen yet */
+};
+
+typedef struct pio_last_t pio_last_t;
+
+static std::map<uint64_t, pio_last_t> io_last;
+static unsigned int io_generation = 0;
+
+/* By row of the table: the counters since the previous notification */
+static std::vector<pio_t> io_deltas;
+
+/* Counters of a process as last reported to subscribers */
+struct preport_t {
+    uint64_t start_time;
+    uint64_t cpu_usage_user;
+    uint64_t cpu_usage_system;
+    uint64_t memory_usage;
+    float cpu_pct;
+    uint8_t memory_utilization;
+    pio_t io;
+    istr_t args;
+    unsigned int generation;
+    bool reported;              /* false: left the selection, kept until it exits */
+};
+
+typedef struct preport_t preport_t;
+
+static std::map<uint64_t, preport_t> reported_processes;
+static std::vector<confd_value_t> removed_pids;
+
+/* Tag values per process entry: begin/end plus ten leaves */
+#define PROCESS_TAGS 12
+
+/* The others container: begin/end plus six leaves */
+#define OTHERS_TAGS 8
+
+/* Tag values per thread entry: begin/end plus six leaves */
+#define THREAD_TAGS 8
+
+/* The I/O and scheduling leaves, per process entry and in others */
+#define IO_TAGS 5
+
+/* Totals of the processes left out of the selection */
+struct pothers_t {
+    uint32_t processes;
+    uint64_t cpu_usage_user;
+    uint64_t cpu_usage_system;
+    float cpu_pct;
+    uint64_t memory_usage;
+    uint32_t memory_utilization;
+    pio_t io;
+};
+
+typedef struct pothers_t pothers_t;
+
+/*
+ * Whether a process name passes the patterns, kept by name id. An id
+ * is reused for another name once no process has its name, so the
+ * verdict holds the name it was made for; the interned name, and so
+ * its address, cannot be reused while held.
+ */
+struct name_match_t {
+    istr_t name;
+    bool selected;
+    bool threads;               /* report its threads */
+};
+
+typedef struct name_match_t name_match_t;
+
+static std::vector<regex_t> include_patterns;
+static std::vector<regex_t> exclude_patterns;
+static std::vector<regex_t> thread_patterns;
+static std::vector<name_match_t> name_matches;
+
+/* The rows of the sampler's table streamed this cycle */
+static const proc_table_t *table;
+static std::vector<uint32_t> selection;
+static pothers_t others;
+
+/* The threads read this cycle, and the first and count of each selected process */
+static std::vector<tinfo_t> threads;
+static std::vector<std::pair<size_t, size_t> > thread_ranges;
+
+/* Encode buffer reused across cycles */
+static tv_arena_t process_arena;
+
+/* The args leaf-lists of the notification being built */
+static std::vector<confd_value_t> process_args;
+
+static bool add_pattern(std::vector<regex_t>& patterns, const char *pattern)
+{
+    std::string anchored = std::string("^(") + pattern + ")$";
+    regex_t re;
+
+    if (regcomp(&re, anchored.c_str(), REG_EXTENDED | REG_NOSUB) != 0) {
+        return false;
+    }
+    patterns.push_back(re);
+    return true;
+}
+
+bool process_stats_include(const char *pattern)
+{
+    return add_pattern(include_patterns, pattern);
+}
+
+bool process_stats_exclude(const char *pattern)
+{
+    return add_pattern(exclude_patterns, pattern);
+}
+
+bool process_stats_threads(const char *pattern)
+{
+    return add_pattern(thread_patterns, pattern);
+}
+
+bool process_stats_rank_by(const char *key)
+{
+    for (int i = 0; rank_keys[i] != NULL; i++) {
+        if (strcmp(key, rank_keys[i]) == 0) {
+            process_stats_opts.rank_by = (process_rank_t) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool selecting(void)
+{
+    return process_stats_opts.top_k > 0 || !include_patterns.empty() || !exclude_patterns.empty();
+}
+
+static bool matches_any(const std::vector<regex_t>& patterns, const char *name)
+{
+    for (size_t i = 0; i < patterns.size(); i++) {
+        if (regexec(&patterns[i], name, 0, NULL, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const name_match_t& name_match(uint32_t row)
+{
+    uint32_t id = table->name_id[row];
+    const istr_t& name = table->names[id];
+
+    if (id >= name_matches.size()) {
+        name_matches.resize(id + 1);
+    }
+
+    name_match_t& m = name_matches[id];
+    if (m.name != name || name.entry == NULL) {
+        m.name = name;
+        m.selected = (include_patterns.empty() || matches_any(include_patterns, name.c_str())) &&
+                     !matches_any(exclude_patterns, name.c_str());
+        m.threads = matches_any(thread_patterns, name.c_str());
+    }
+    return m;
+}
+
+static uint64_t counter_delta(uint64_t last, uint64_t now)
+{
+    return (now > last) ? now - last : 0;
+}
+
+/*
+ * The I/O and scheduling counters of every process since the previous
+ * notification. The first notification is the baseline; a process not
+ * seen before (nor with this start time) has started since, and counts
+ * from its start.
+ */
+static void update_io_deltas(void)
+{
+    const proc_table_t *t = table;
+    bool baseline = io_last.empty();
+
+    if (++io_generation == 0) {
+        io_generation = 1;
+    }
+
+    io_deltas.resize(proc_table_rows(t));
+    for (uint32_t row = 0; row < proc_table_rows(t); row++) {
+        pio_last_t& last = io_last[t->pid[row]];
+        pio_t& d = io_deltas[row];
+        pio_t now;
+
+        now.read_bytes = t->read_bytes[row];
+        now.write_bytes = t->write_bytes[row];
+        now.wait_ns = t->wait_ns[row];
+        now.voluntary_switches = t->voluntary_switches[row];
+        now.involuntary_switches = t->involuntary_switches[row];
+
+        if (last.generation == 0 || last.start_ticks != t->start_ticks[row]) {
+            if (baseline) {
+                memset(&d, 0, sizeof(d));
+            } else {
+                d = now;
+            }
+        } else {
+            d.read_bytes = counter_delta(last.counters.read_bytes, now.read_bytes);
+            d.write_bytes = counter_delta(last.counters.write_bytes, now.write_bytes);
+            d.wait_ns = counter_delta(last.counters.wait_ns, now.wait_ns);
+            d.voluntary_switches = counter_delta(last.counters.voluntary_switches,
+                                                 now.voluntary_switches);
+            d.involuntary_switches = counter_delta(last.counters.involuntary_switches,
+                                                   now.involuntary_switches);
+        }
+
+        last.start_ticks = t->start_ticks[row];
+        last.counters = now;
+        last.generation = io_generation;
+    }
+
+    std::map<uint64_t, pio_last_t>::iterator it = io_last.begin();
+    while (it != io_last.end()) {
+        if (it->second.generation != io_generation) {
+            io_last.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/* The I/O or scheduling key a row is ranked by */
+static uint64_t io_rank(uint32_t row)
+{
+    const pio_t& d = io_deltas[row];
+
+    switch (process_stats_opts.rank_by) {
+    case PROCESS_RANK_IO:
+        return d.read_bytes + d.write_bytes;
+    case PROCESS_RANK_WAIT:
+        return d.wait_ns;
+    default:
+        return d.voluntary_switches + d.involuntary_switches;
+    }
+}
+
+/* Highest first; the pid breaks ties so that the selection is stable */
+static bool ranks_higher(uint32_t a, uint32_t b)
+{
+    const proc_table_t *t = table;
+
+    if (process_stats_opts.rank_by == PROCESS_RANK_MEMORY) {
+        if (t->memory_usage[a] != t->memory_usage[b]) {
+            return t->memory_usage[a] > t->memory_usage[b];
+        }
+    } else if (process_stats_opts.rank_by == PROCESS_RANK_CPU) {
+        if (t->cpu_pct[a] != t->cpu_pct[b]) {
+            return t->cpu_pct[a] > t->cpu_pct[b];
+        }
+        uint64_t ta = t->cpu_usage_user[a] + t->cpu_usage_system[a];
+        uint64_t tb = t->cpu_usage_user[b] + t->cpu_usage_system[b];
+        if (ta != tb) {
+            return ta > tb;
+        }
+    } else {
+        uint64_t ka = io_rank(a), kb = io_rank(b);
+        if (ka != kb) {
+            return ka > kb;
+        }
+    }
+    return t->pid[a] < t->pid[b];
+}
+
+static void add_other(uint32_t row)
+{
+    others.processes++;
+    others.cpu_usage_user += table->cpu_usage_user[row];
+    others.cpu_usage_system += table->cpu_usage_system[row];
+    others.cpu_pct += table->cpu_pct[row];
+    others.memory_usage += table->memory_usage[row];
+    others.memory_utilization += table->memory_utilization[row];
+
+    if (process_stats_opts.io_sched) {
+        const pio_t& d = io_deltas[row];
+
+        others.io.read_bytes += d.read_bytes;
+        others.io.write_bytes += d.write_bytes;
+        others.io.wait_ns += d.wait_ns;
+        others.io.voluntary_switches += d.voluntary_switches;
+        others.io.involuntary_switches += d.involuntary_switches;
+    }
+}
+
+/*
+ * The processes passing the name patterns, and of those the top K,
+ * found with nth_element in linear time. Only the K selected are
+ * sorted, also when there are K or fewer. Everything else goes into
+ * the others totals.
+ */
+static void filter_processes(unsigned int k)
+{
+    for (uint32_t row = 0; row < proc_table_rows(table); row++) {
+        if (name_match(row).selected) {
+            selection.push_back(row);
+        } else {
+            add_other(row);
+        }
+    }
+
+    if (k > 0 && selection.size() > k) {
+        std::nth_element(selection.begin(), selection.begin() + k, selection.end(), ranks_higher);
+        for (size_t i = k; i < selection.size(); i++) {
+            add_other(selection[i]);
+        }
+        selection.resize(k);
+    }
+    if (k > 0) {
+        std::sort(selection.begin(), selection.end(), ranks_higher);
+    }
+}
+
+/* Pick the processes to stream, highest CPU first when not ranked */
+static void select_processes(const proc_table_t& processes)
+{
+    selection.clear();
+    memset(&others, 0, sizeof(others));
+
+    if (!selecting()) {
+        selection = processes.by_cpu;
+    } else {
+        filter_processes(process_stats_opts.top_k);
+    }
+}
+
+/* Read the threads of the selected processes that are watched per thread */
+static void read_threads(proc_scanner_t *ps)
+{
+    threads.clear();
+    thread_ranges.clear();
+
+    if (thread_patterns.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < selection.size(); i++) {
+        size_t first = threads.size();
+
+        if (name_match(selection[i]).threads) {
+            proc_scan_threads(ps, table->pid[selection[i]], threads);
+        }
+        thread_ranges.push_back(std::make_pair(first, threads.size() - first));
+    }
+}
+
+static void set_percent(tv_arena_t *arena, uint32_t tag, float pct)
+{
+    struct confd_decimal64 d;
+    d.value = (int64_t) (pct * 100 + 0.5f);
+    d.fraction_digits = 2;
+
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_DECIMAL64(tv, tag, d);
+}
+
+static void append_io(tv_arena_t *arena, const pio_t& io)
+{
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_io_read_bytes, io.read_bytes);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_io_write_bytes, io.write_bytes);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_run_queue_wait, io.wait_ns / 1000);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_voluntary_context_switches, io.voluntary_switches);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_involuntary_context_switches, io.involuntary_switches);
+}
+
+static void append_others(tv_arena_t *arena)
+{
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_others, oc_proc_ext__ns);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT32(tv, oc_proc_ext_processes, others.processes);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_usage_user, others.cpu_usage_user);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_usage_system, others.cpu_usage_system);
+    set_percent(arena, oc_proc_ext_cpu_utilization, others.cpu_pct);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_memory_usage, others.memory_usage);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT32(tv, oc_proc_ext_memory_utilization, others.memory_utilization);
+    if (process_stats_opts.io_sched) {
+        append_io(arena, others.io);
+    }
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_others, oc_proc_ext__ns);
+}
+
+/* Make room for the tag values of 'processes' entries and their threads */
+static void reserve_tags(size_t processes, size_t extra)
+{
+    size_t io = process_stats_opts.io_sched ? IO_TAGS : 0;
+
+    tv_arena_reserve(&process_arena, processes * (PROCESS_TAGS + io) + threads.size() * THREAD_TAGS +
+                     OTHERS_TAGS + io + extra);
+}
+
+/* Make room for the args of every process, so that none is reallocated */
+static void reserve_args(const std::vector<uint32_t>& rows)
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < rows.size(); i++) {
+        total += istr_fields(table->args[rows[i]]);
+    }
+    process_args.clear();
+    process_args.reserve(total);
+}
+
+static int thread_state(char state)
+{
+    switch (state) {
+    case 'R': return oc_proc_ext_running;
+    case 'S': return oc_proc_ext_sleeping;
+    case 'D': return oc_proc_ext_disk_sleep;
+    case 'T': return oc_proc_ext_stopped;
+    case 't': return oc_proc_ext_tracing_stop;
+    case 'Z': return oc_proc_ext_zombie;
+    case 'X': return oc_proc_ext_dead;
+    case 'I': return oc_proc_ext_idle;
+    default: return -1;
+    }
+}
+
+static void append_thread(tv_arena_t *arena, const tinfo_t& thread)
+{
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_thread, oc_proc_ext__ns);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_tid, thread.tid);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_STR(tv, oc_proc_ext_name, thread.name.c_str());
+
+    int state = thread_state(thread.state);
+    if (state >= 0) {
+        tv = tv_arena_next(arena);
+        CONFD_SET_TAG_ENUM_VALUE(tv, oc_proc_ext_state, state);
+    }
+
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_usage_user, thread.cpu_usage_user);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(tv, oc_proc_ext_cpu_usage_system, thread.cpu_usage_system);
+    set_percent(arena, oc_proc_ext_cpu_usage_percent, thread.cpu_pct);
+    tv = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_thread, oc_proc_ext__ns);
+}
+
+/* The threads read for selection[index], if any */
+static void append_threads(tv_arena_t *arena, size_t index)
+{
+    if (index < thread_ranges.size()) {
+        for (size_t t = 0; t < thread_ranges[index].second; t++) {
+            append_thread(arena, threads[thread_ranges[index].first + t]);
+        }
+    }
+}
+
+/* 'index' is the position of the process in the selection */
+static void append_process(tv_arena_t *arena, uint32_t row, bool withArgs, size_t index)
+{
+    const proc_table_t *t = table;
+
+    confd_tag_value_t *proc = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLBEGIN(proc,oc_proc_ext_process, oc_proc_ext__ns);
+
+    confd_tag_value_t *pid = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(pid, oc_proc_ext_pid, t->pid[row]);
+
+    confd_tag_value_t *name = tv_arena_next(arena);
+    CONFD_SET_TAG_STR(name, oc_proc_ext_name, proc_table_name(t, row).c_str());
+
+    /* Interned: the values point at the pooled strings, nothing is copied */
+    const istr_t& argv = t->args[row];
+    if (withArgs && istr_fields(argv) > 0) {
+        size_t first = process_args.size();
+        for (const char *a = istr_next_field(argv, NULL); a != NULL; a = istr_next_field(argv, a)) {
+            confd_value_t v;
+            CONFD_SET_STR(&v, a);
+            process_args.push_back(v);
+        }
+
+        confd_tag_value_t *args = tv_arena_next(arena);
+        CONFD_SET_TAG_LIST(args, oc_proc_ext_args, &process_args[first], process_args.size() - first);
+    }
+
+    confd_tag_value_t *start_time = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(start_time, oc_proc_ext_start_time, t->start_time[row]);
+
+    confd_tag_value_t *cpu_usage_user = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(cpu_usage_user, oc_proc_ext_cpu_usage_user, t->cpu_usage_user[row]);
+
+    confd_tag_value_t *cpu_usage_system = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(cpu_usage_system, oc_proc_ext_cpu_usage_system, t->cpu_usage_system[row]);
+
+    confd_tag_value_t *cpu_utilization = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT8(cpu_utilization, oc_proc_ext_cpu_utilization, t->cpu_utilization[row]);
+
+    set_percent(arena, oc_proc_ext_cpu_usage_percent, t->cpu_pct[row]);
+
+    confd_tag_value_t *memory_usage = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT64(memory_usage, oc_proc_ext_memory_usage, t->memory_usage[row]);
+
+    confd_tag_value_t *memory_utilization = tv_arena_next(arena);
+    CONFD_SET_TAG_UINT8(memory_utilization, oc_proc_ext_memory_utilization, t->memory_utilization[row]);
+
+    if (process_stats_opts.io_sched) {
+        append_io(arena, io_deltas[row]);
+    }
+
+    append_threads(arena, index);
+
+    proc = tv_arena_next(arena);
+    CONFD_SET_TAG_XMLEND(proc, oc_proc_ext_process, oc_proc_ext__ns);
+}
+
+/* A counter moved by more than 'deadband' percent of its last reported value */
+static bool outside_deadband(uint64_t reported, uint64_t current)
+{
+    uint64_t diff = (current > reported) ? (current - reported) : (reported - current);
+    return diff * 100 > reported * process_stats_opts.deadband;
+}
+
+/* A percentage moved by more than 'deadband' percentage points */
+static bool outside_deadband_pct(float reported, float current)
+{
+    float diff = current - reported;
+    return (diff < 0 ? -diff : diff) > process_stats_opts.deadband;
+}
+
+static bool io_changed(const pio_t& reported, const pio_t& current)
+{
+    return outside_deadband(reported.read_bytes, current.read_bytes) ||
+           outside_deadband(reported.write_bytes, current.write_bytes) ||
+           outside_deadband(reported.wait_ns, current.wait_ns) ||
+           outside_deadband(reported.voluntary_switches, current.voluntary_switches) ||
+           outside_deadband(reported.involuntary_switches, current.involuntary_switches);
+}
+
+static bool process_changed(const preport_t& reported, uint32_t row)
+{
+    const proc_table_t *t = table;
+
+    return reported.start_time > t->start_time[row] ||  // pid was reused
+           reported.args != t->args[row] ||                 // exec
+           outside_deadband(reported.cpu_usage_user, t->cpu_usage_user[row]) ||
+           outside_deadband(reported.cpu_usage_system, t->cpu_usage_system[row]) ||
+           outside_deadband(reported.memory_usage, t->memory_usage[row]) ||
+           outside_deadband_pct(reported.cpu_pct, t->cpu_pct[row]) ||
+           outside_deadband_pct(reported.memory_utilization, t->memory_utilization[row]) ||
+           (process_stats_opts.io_sched && io_changed(reported.io, io_deltas[row]));
+}
+
+static void remember_process(preport_t& reported, uint32_t row)
+{
+    const proc_table_t *t = table;
+
+    reported.start_time = t->start_time[row];
+    reported.cpu_usage_user = t->cpu_usage_user[row];
+    reported.cpu_usage_system = t->cpu_usage_system[row];
+    reported.memory_usage = t->memory_usage[row];
+    reported.cpu_pct = t->cpu_pct[row];
+    reported.memory_utilization = t->memory_utilization[row];
+    reported.args = t->args[row];
+    if (process_stats_opts.io_sched) {
+        reported.io = io_deltas[row];
+    }
+}
+
+/*
+ * Delta mode: emit only processes that were added or whose counters
+ * left the deadband since they were last reported, plus the pids that
+ * went away. Every 'sync_cycles' cycles a full "sync" snapshot is
+ * sent instead so that late subscribers can rebuild their state.
+ *
+ * A process that leaves the selection (top K, say) is reported removed
+ * but its entry is kept, unreported, until it exits, so that one that
+ * moves in and out of the selection does not allocate every time.
+ */
+static void send_notif_process_delta(confd_agent_t *agent, const std::vector<uint32_t>& processes,
+                                     size_t total,
+                                     const std::map<uint64_t, proc_identity_t>& identities)
+{
+    static unsigned int cycle = 0;
+
+    bool sync = (cycle++ % process_stats_opts.sync_cycles) == 0;
+    unsigned int generation = cycle;
+    int added = 0, changed = 0;
+
+    tv_arena_reset(&process_arena);
+    reserve_tags(processes.size(), 4);
+    reserve_args(processes);
+
+    confd_tag_value_t *outer = tv_arena_next(&process_arena);
+    CONFD_SET_TAG_XMLBEGIN(outer, oc_proc_ext_process_statistics, oc_proc_ext__ns);
+
+    confd_tag_value_t *updateType = tv_arena_next(&process_arena);
+    CONFD_SET_TAG_ENUM_VALUE(updateType, oc_proc_ext_update_type,
+                             sync ? oc_proc_ext_sync : oc_proc_ext_delta);
+
+    for (int i = 0; i < (int) processes.size(); i++) {
+        uint32_t row = processes[i];
+        uint64_t pid = table->pid[row];
+        std::map<uint64_t, preport_t>::iterator it = reported_processes.find(pid);
+
+        if (it == reported_processes.end()) {
+            it = reported_processes.insert(std::make_pair(pid, preport_t())).first;
+        }
+
+        if (!it->second.reported) {
+            added++;
+        } else if (!sync && !process_changed(it->second, row) &&
+                   (i >= (int) thread_ranges.size() || thread_ranges[i].second == 0)) {
+            it->second.generation = generation;
+            continue;
+        } else {
+            changed++;
+        }
+
+        /* The command line only when the receiver may not have it */
+        bool withArgs = sync || !it->second.reported || it->second.args != table->args[row];
+
+        it->second.generation = generation;
+        it->second.reported = true;
+        remember_process(it->second, row);
+        append_process(&process_arena, row, withArgs, i);
+    }
+
+    /* Anything not seen in this scan has exited, or left the selection */
+    removed_pids.clear();
+    std::map<uint64_t, preport_t>::iterator it = reported_processes.begin();
+    while (it != reported_processes.end()) {
+        if (it->second.generation == generation) {
+            ++it;
+            continue;
+        }
+        if (it->second.reported) {
+            confd_value_t pid;
+            CONFD_SET_UINT64(&pid, it->first);
+            removed_pids.push_back(pid);
+            it->second.reported = false;
+        }
+        if (identities.find(it->first) == identities.end()) {
+            reported_processes.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!removed_pids.empty()) {
+        confd_tag_value_t *removedPids = tv_arena_next(&process_arena);
+        CONFD_SET_TAG_LIST(removedPids, oc_proc_ext_removed_pid, &removed_pids[0], removed_pids.size());
+    }
+
+    if (selecting()) {
+        append_others(&process_arena);
+    }
+
+    outer = tv_arena_next(&process_arena);
+    CONFD_SET_TAG_XMLEND(outer, oc_proc_ext_process_statistics, oc_proc_ext__ns);
+
+    std::cout << (sync ? "Sync" : "Delta") << ": " << added << " added, "
+              << changed << " changed, " << removed_pids.size() << " removed ("
+              << processes.size() << " of " << total << " processes)" << std::endl;
+
+    /* Nothing to say between syncs on a quiet system */
+    if (sync || added > 0 || changed > 0 || !removed_pids.empty()) {
+        confd_agent_send_notification(agent, &process_arena);
+    }
+}
+
+static void start_process_stats(collector_t *c, scheduler_t *sched)
+{
+    if (process_stats_opts.sync_cycles == 0)
+        process_stats_opts.sync_cycles = DELTA_SYNC_CYCLES;
+
+    tv_arena_init(&process_arena, "process-statistics", 0);
+    confd_agent_register_stream(sched->agent);
+
+    if (process_stats_opts.rank_by >= PROCESS_RANK_IO) {
+        process_stats_opts.io_sched = true;
+    }
+    if (process_stats_opts.io_sched) {
+        sched->sampler->scanner.io_sched = true;
+        std::cout << "Process I/O and scheduling counters: on" << std::endl;
+    }
+
+    if (selecting()) {
+        std::cout << "Process selection: ";
+        if (process_stats_opts.top_k > 0) {
+            std::cout << "top " << process_stats_opts.top_k << " by "
+                      << rank_keys[process_stats_opts.rank_by] << ", ";
+        }
+        std::cout << include_patterns.size() << " include and "
+                  << exclude_patterns.size() << " exclude patterns" << std::endl;
+    }
+    if (!thread_patterns.empty()) {
+        std::cout << "Per-thread statistics: " << thread_patterns.size() << " patterns" << std::endl;
+    }
+}
+
+static int send_notif_process_statistics(collector_t *c, scheduler_t *sched)
+{
+    const proc_table_t& processes = sampler_processes(sched->sampler);
+
+    table = &processes;
+    if (process_stats_opts.io_sched) {
+        update_io_deltas();
+    }
+    select_processes(processes);
+    read_threads(&sched->sampler->scanner);
+
+    if (process_stats_opts.delta_mode) {
+        send_notif_process_delta(sched->agent, selection, proc_table_rows(&processes),
+                                 sched->sampler->scanner.identities);
+        return CONFD_OK;
+    }
+
+    tv_arena_reset(&process_arena);
+    reserve_tags(selection.size(), 2);
+    reserve_args(selection);
+
+    confd_tag_value_t *outer = tv_arena_next(&process_arena);
+    CONFD_SET_TAG_XMLBEGIN(outer, oc_proc_ext_process_statistics, oc_proc_ext__ns);
+
+    for (int i = 0; i < (int) selection.size() ; i++) {
+        append_process(&process_arena, selection[i], true, i);
+    }
+
+    if (selecting()) {
+        append_others(&process_arena);
+    }
+
+    outer = tv_arena_next(&process_arena);
+    CONFD_SET_TAG_XMLEND(outer, oc_proc_ext_process_statistics, oc_proc_ext__ns);
+
+    /* Emit the notification */
+    confd_agent_send_notification(sched->agent, &process_arena);
+
+    return CONFD_OK;
+}
+
+collector_t process_stats_collector = {
+    "process-stats",
+    true,                       /* adaptive */
+    INTERVAL,
+    false,                      /* on_demand */
+    start_process_stats,
+    send_notif_process_statistics,
+    NULL,                       /* cadence */
+    0
+};
@@ -0,0 +1,84 @@
+/**
+ * process_stats_collector.h
+ *
+ * Streams per-process statistics (process-statistics notification) at
+ * the adaptive stream interval, either as full snapshots or, in delta
+ * mode, as the processes that changed since the last notification.
+ *
+ * The processes streamed can be narrowed to those whose name matches
+ * include patterns and none of the exclude patterns, and to the top K
+ * of those by CPU or memory. The K are picked by partial selection,
+ * so the cost past the filters is linear in the number of processes
+ * and the notification grows with K only; the processes left out are
+ * summed into the "others" totals.
+ *
+ * On request, each process also carries its I/O and scheduling
+ * counters (bytes read and written, run-queue wait, context switches)
+ * over the interval since the previous notification, which can then
+ * rank the top K too.
+ *
+ * The threads of the streamed processes whose name matches a thread
+ * pattern are listed under them, with their state and CPU use since
+ * the previous notification (see proc_scan_threads()).
+ *
+ * Once its buffers have grown to the largest notification, a cycle
+ * allocates nothing for the processes it has seen before, whether they
+ * stay in the selection or move in and out of it (see tv_arena_test).
+ * What still allocates: a new process, for its entry in the delta mode
+ * and I/O maps; a name not seen before, which regexec() may allocate
+ * for when patterns are set; and reading threads, which opens
+ * /proc/<pid>/task. Outside the collector, walking /proc allocates in
+ * opendir(), and so does the replay log when it opens a segment (see
+ * replay_log.h).
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROCESS_STATS_COLLECTOR_H
+#define PROCESS_STATS_COLLECTOR_H
+
+#include "scheduler.h"
+
+#define DELTA_DEADBAND 1
+#define DELTA_SYNC_CYCLES 10
+
+/* The I/O and scheduling keys imply io_sched */
+enum process_rank_t {
+    PROCESS_RANK_CPU,           /* cpu_utilization, then CPU time */
+    PROCESS_RANK_MEMORY,        /* memory_usage */
+    PROCESS_RANK_IO,            /* bytes read and written */
+    PROCESS_RANK_WAIT,          /* run-queue wait */
+    PROCESS_RANK_SWITCHES       /* voluntary and involuntary context switches */
+};
+
+typedef enum process_rank_t process_rank_t;
+
+struct process_stats_opts_t {
+    bool delta_mode;
+    unsigned int deadband;      /* percent, or percentage points */
+    unsigned int sync_cycles;   /* full snapshot every N notifications */
+    unsigned int top_k;         /* 0: every process */
+    process_rank_t rank_by;
+    bool io_sched;              /* add the I/O and scheduling counters */
+};
+
+typedef struct process_stats_opts_t process_stats_opts_t;
+
+extern process_stats_opts_t process_stats_opts;
+
+/*
+ * Add a process name pattern, a POSIX extended regular expression
+ * matched against the whole name (so a plain name matches exactly
+ * that name). False if the pattern does not compile.
+ */
+bool process_stats_include(const char *pattern);
+bool process_stats_exclude(const char *pattern);
+
+/* Report the threads of the processes whose name matches 'pattern' */
+bool process_stats_threads(const char *pattern);
+
+/* "cpu", "memory", "io", "wait" or "switches"; false for anything else */
+bool process_stats_rank_by(const char *key);
+
+extern collector_t process_stats_collector;
+
+#endif
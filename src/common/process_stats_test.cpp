@@ -0,0 +1,699 @@
+/**
+ * process_stats_test.cpp
+ *
+ * Runs the process-stats collector over a synthetic /proc and decodes
+ * the notifications it sends. In delta mode: a sync snapshot first, no
+ * notification while nothing leaves the deadband, only the processes
+ * that did otherwise (measured from what was last reported, so a slow
+ * drift is reported in the end), the command line only when it is
+ * new, the pids that went away, and a full sync again every
+ * sync_cycles notifications. With top K: the K best by the ranking
+ * key in order, ties to the lower pid, the rest summed into others,
+ * and in delta mode a process that moves into the K added and the one
+ * it displaced removed. The I/O and scheduling counters are deltas
+ * since the previous notification, from a zero baseline; a counter
+ * that goes backwards counts nothing, and a new or reused pid counts
+ * from its start.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <unistd.h>
+
+#include "openconfig-procmon-ext.h"
+#include "process_stats_collector.h"
+#include "proc_fixture.h"
+#include "test_agent.h"
+#include "unit_test.h"
+
+/* A process entry of a notification: its leaves by tag */
+struct entry_t {
+    std::map<uint32_t, uint64_t> leaves;
+    std::string name;
+    std::vector<std::string> args;
+    bool has_args;
+};
+
+typedef struct entry_t entry_t;
+
+struct notif_t {
+    int update_type;            /* -1: not in the notification */
+    std::vector<uint64_t> order;                /* pids, as encoded */
+    std::map<uint64_t, entry_t> processes;      /* by pid */
+    std::vector<uint64_t> removed;
+    bool has_others;
+    std::map<uint32_t, uint64_t> others;
+};
+
+typedef struct notif_t notif_t;
+
+static std::string root;
+static std::map<uint64_t, fixture_proc_t> live;
+
+static confd_agent_t agent;
+static sampler_t sampler;
+static scheduler_t sched;
+
+/* The collector's notes stay out of the test output */
+static std::ofstream devnull("/dev/null");
+
+static uint64_t leaf_value(const confd_value_t *v)
+{
+    switch (v->type) {
+    case C_UINT8: return v->val.u8;
+    case C_UINT32: return v->val.u32;
+    case C_UINT64: return v->val.u64;
+    case C_ENUM_VALUE: return v->val.enumvalue;
+    case C_DECIMAL64: return v->val.d64.value;     /* hundredths */
+    default: return 0;
+    }
+}
+
+/* The last notification sent; false if it is not a process-statistics one */
+static bool decode(notif_t *n)
+{
+    const tv_arena_t *a = test_agent_last;
+    entry_t *e = NULL;
+    bool inOthers = false;
+    int depth = 0;
+
+    n->update_type = -1;
+    n->order.clear();
+    n->processes.clear();
+    n->removed.clear();
+    n->has_others = false;
+    n->others.clear();
+
+    if (a == NULL || a->nvals < 2 ||
+        CONFD_GET_TAG_TAG(&a->vals[0]) != oc_proc_ext_process_statistics) {
+        return false;
+    }
+
+    for (int i = 1; i < a->nvals - 1; i++) {
+        const confd_tag_value_t *tv = &a->vals[i];
+        const confd_value_t *v = CONFD_GET_TAG_VALUE(tv);
+        uint32_t tag = CONFD_GET_TAG_TAG(tv);
+
+        if (v->type == C_XMLBEGIN) {
+            if (depth++ > 0) {
+                continue;                       /* a thread */
+            }
+            if (tag == oc_proc_ext_others) {
+                n->has_others = inOthers = true;
+            } else {
+                e = NULL;
+            }
+        } else if (v->type == C_XMLEND) {
+            if (--depth == 0) {
+                e = NULL;
+                inOthers = false;
+            }
+        } else if (depth > 1) {
+            continue;
+        } else if (inOthers) {
+            n->others[tag] = leaf_value(v);
+        } else if (depth == 1 && tag == oc_proc_ext_pid) {
+            e = &n->processes[v->val.u64];
+            e->has_args = false;
+            n->order.push_back(v->val.u64);
+        } else if (depth == 1 && e != NULL && tag == oc_proc_ext_name) {
+            e->name = v->val.s;
+        } else if (depth == 1 && e != NULL && tag == oc_proc_ext_args) {
+            e->has_args = true;
+            for (unsigned int f = 0; f < v->val.list.size; f++) {
+                e->args.push_back(v->val.list.ptr[f].val.s);
+            }
+        } else if (depth == 1 && e != NULL) {
+            e->leaves[tag] = leaf_value(v);
+        } else if (depth == 0 && tag == oc_proc_ext_update_type) {
+            n->update_type = v->val.enumvalue;
+        } else if (depth == 0 && tag == oc_proc_ext_removed_pid) {
+            for (unsigned int p = 0; p < v->val.list.size; p++) {
+                n->removed.push_back(v->val.list.ptr[p].val.u64);
+            }
+        }
+    }
+    return true;
+}
+
+static void set_process(uint64_t pid, const fixture_proc_t& p)
+{
+    fixture_write_process(root, pid, p);
+    live[pid] = p;
+}
+
+static void remove_process(uint64_t pid)
+{
+    fixture_remove_process(root, pid);
+    live.erase(pid);
+}
+
+/* What the scheduler does on every tick: expire the samples, collect */
+static void tick(void)
+{
+    sampler_expire(&sampler);
+    CHECK(process_stats_collector.collect(&process_stats_collector, &sched) == CONFD_OK);
+}
+
+static uint64_t memory_kb(const fixture_proc_t& p)
+{
+    return (p.size_pages - p.text_pages) * sampler.scanner.page_kb;
+}
+
+/* An entry carries the counters of its process */
+static void check_entry(const notif_t& n, uint64_t pid)
+{
+    std::map<uint64_t, entry_t>::const_iterator e = n.processes.find(pid);
+    std::map<uint64_t, fixture_proc_t>::const_iterator p = live.find(pid);
+
+    CHECK(e != n.processes.end() && p != live.end());
+    if (e == n.processes.end() || p == live.end()) {
+        return;
+    }
+
+    const std::map<uint32_t, uint64_t>& l = e->second.leaves;
+    CHECK(e->second.name == p->second.name);
+    CHECK(l.count(oc_proc_ext_cpu_usage_user) && l.find(oc_proc_ext_cpu_usage_user)->second ==
+          p->second.utime);
+    CHECK(l.count(oc_proc_ext_cpu_usage_system) && l.find(oc_proc_ext_cpu_usage_system)->second ==
+          p->second.stime);
+    CHECK(l.count(oc_proc_ext_memory_usage) && l.find(oc_proc_ext_memory_usage)->second ==
+          memory_kb(p->second));
+    CHECK(l.count(oc_proc_ext_start_time) && l.find(oc_proc_ext_start_time)->second ==
+          (uint64_t) (FIXTURE_UPTIME - p->second.start_ticks / sampler.scanner.clk_tck));
+    if (e->second.has_args) {
+        CHECK(e->second.args.size() == 3 && e->second.args[0] == "/usr/bin/" + p->second.name);
+    }
+}
+
+/* A sync snapshot: every live process, each with its command line */
+static void check_sync(const notif_t& n)
+{
+    CHECK(n.update_type == oc_proc_ext_sync);
+    CHECK(n.processes.size() == live.size());
+    CHECK(n.removed.empty());
+
+    for (std::map<uint64_t, fixture_proc_t>::const_iterator p = live.begin(); p != live.end(); ++p) {
+        check_entry(n, p->first);
+        CHECK(n.processes.count(p->first) && n.processes.find(p->first)->second.has_args);
+    }
+}
+
+/* Another notification was sent, and decodes */
+static bool sent(unsigned long *count, notif_t *n)
+{
+    bool more = test_agent_sent == *count + 1;
+
+    CHECK(more);
+    *count = test_agent_sent;
+    CHECK(decode(n));
+    return more;
+}
+
+static void test_delta(void)
+{
+    unsigned long count = test_agent_sent;
+    notif_t n;
+
+    process_stats_opts.delta_mode = true;
+    process_stats_opts.deadband = 1;
+    process_stats_opts.sync_cycles = 6;
+
+    /* Twenty processes that use no CPU: the per-interval pct stays 0 */
+    for (uint64_t pid = 100; pid < 120; pid++) {
+        fixture_proc_t p;
+        fixture_proc_init(&p, (pid % 2) ? "agent" : "worker", pid * 100);
+        p.utime = 1000 + pid;
+        p.stime = 500;
+        set_process(pid, p);
+    }
+
+    /* Cycle 0: the first notification is a sync */
+    tick();
+    if (sent(&count, &n)) {
+        check_sync(n);
+    }
+
+    /* Cycle 1: nothing changed, nothing sent */
+    tick();
+    CHECK(test_agent_sent == count);
+
+    /*
+     * Cycle 2: memory of 100 moves by 1% of what was reported, which is
+     * inside the deadband; 101 moves by more, and is sent alone. Its
+     * command line did not change and is left out.
+     */
+    uint64_t used = live[100].size_pages - live[100].text_pages;
+    live[100].size_pages += used / 100;
+    set_process(100, live[100]);
+    live[101].size_pages += used / 100 + 1;
+    set_process(101, live[101]);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.update_type == oc_proc_ext_delta);
+        CHECK(n.processes.size() == 1 && n.processes.count(101));
+        check_entry(n, 101);
+        CHECK(!n.processes[101].has_args);
+        CHECK(n.removed.empty());
+        CHECK(!n.has_others);
+    }
+
+    /* Cycle 3: 100 drifts as much again, past the deadband of what was reported */
+    live[100].size_pages += used / 100;
+    set_process(100, live[100]);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.update_type == oc_proc_ext_delta);
+        CHECK(n.processes.size() == 1 && n.processes.count(100));
+        check_entry(n, 100);
+    }
+
+    /*
+     * Cycle 4: 119 exits, 200 starts, 102 runs a new program and 105 is
+     * a reused pid, started later. The new and the exec'd process come
+     * with their command lines.
+     */
+    remove_process(119);
+    fixture_proc_t p;
+    fixture_proc_init(&p, "collector", 80000000);
+    set_process(200, p);
+    live[102].name = "exec-worker";
+    set_process(102, live[102]);
+    live[105].start_ticks += 50000000;
+    set_process(105, live[105]);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.update_type == oc_proc_ext_delta);
+        CHECK(n.processes.size() == 3);
+        CHECK(n.removed.size() == 1 && n.removed[0] == 119);
+        check_entry(n, 200);
+        check_entry(n, 102);
+        check_entry(n, 105);
+        CHECK(n.processes[200].has_args && n.processes[102].has_args);
+        CHECK(!n.processes[105].has_args);
+    }
+
+    /* Cycle 5: quiet */
+    tick();
+    CHECK(test_agent_sent == count);
+
+    /* Cycle 6: a sync again, with everything, whether it changed or not */
+    tick();
+    if (sent(&count, &n)) {
+        check_sync(n);
+    }
+
+    /* Cycle 7: quiet again; a sync does not leave anything to report */
+    tick();
+    CHECK(test_agent_sent == count);
+
+    /* Everything exits: one delta with all of the pids, then quiet */
+    std::vector<uint64_t> all;
+    for (std::map<uint64_t, fixture_proc_t>::iterator it = live.begin(); it != live.end(); ++it) {
+        all.push_back(it->first);
+    }
+    for (size_t i = 0; i < all.size(); i++) {
+        remove_process(all[i]);
+    }
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.update_type == oc_proc_ext_delta);
+        CHECK(n.processes.empty());
+        CHECK(n.removed.size() == all.size());
+    }
+    tick();
+    CHECK(test_agent_sent == count);
+
+    process_stats_opts.delta_mode = false;
+}
+
+/* The memory ranking: most memory first, the lower pid first on a tie */
+static bool more_memory(uint64_t a, uint64_t b)
+{
+    uint64_t ma = memory_kb(live[a]), mb = memory_kb(live[b]);
+    return (ma != mb) ? ma > mb : a < b;
+}
+
+/* Most CPU time first; the per-interval pct is 0 for all of them */
+static bool more_cpu(uint64_t a, uint64_t b)
+{
+    uint64_t ta = live[a].utime + live[a].stime, tb = live[b].utime + live[b].stime;
+    return (ta != tb) ? ta > tb : a < b;
+}
+
+/* The live pids, best first by 'ranks_higher' */
+static std::vector<uint64_t> ranked(bool (*ranks_higher)(uint64_t, uint64_t))
+{
+    std::vector<uint64_t> pids;
+
+    for (std::map<uint64_t, fixture_proc_t>::iterator it = live.begin(); it != live.end(); ++it) {
+        pids.push_back(it->first);
+    }
+    std::sort(pids.begin(), pids.end(), ranks_higher);
+    return pids;
+}
+
+/*
+ * The others totals are what the entries left out would have said:
+ * 'all' holds the leaves of every process, from a notification
+ * without selection.
+ */
+static void check_others(const notif_t& n, const std::map<uint64_t, entry_t>& all)
+{
+    static const uint32_t summed[] = {
+        oc_proc_ext_cpu_usage_user, oc_proc_ext_cpu_usage_system, oc_proc_ext_cpu_utilization,
+        oc_proc_ext_memory_usage, oc_proc_ext_memory_utilization
+    };
+    std::map<uint32_t, uint64_t> expected;
+    uint64_t left = 0;
+
+    for (std::map<uint64_t, entry_t>::const_iterator it = all.begin(); it != all.end(); ++it) {
+        if (n.processes.count(it->first)) {
+            continue;
+        }
+        left++;
+        for (size_t t = 0; t < sizeof(summed) / sizeof(summed[0]); t++) {
+            std::map<uint32_t, uint64_t>::const_iterator l = it->second.leaves.find(summed[t]);
+            expected[summed[t]] += (l != it->second.leaves.end()) ? l->second : 0;
+        }
+    }
+
+    CHECK(n.has_others);
+    CHECK(n.others.count(oc_proc_ext_processes) && n.others.find(oc_proc_ext_processes)->second == left);
+    for (size_t t = 0; t < sizeof(summed) / sizeof(summed[0]); t++) {
+        std::map<uint32_t, uint64_t>::const_iterator o = n.others.find(summed[t]);
+        uint64_t want = expected[summed[t]];
+
+        CHECK(o != n.others.end());
+        if (o == n.others.end()) {
+            continue;
+        }
+        /* The pct is rounded once for others, and per entry: a hundredth each */
+        if (summed[t] == oc_proc_ext_cpu_utilization) {
+            CHECK(o->second <= want + left && want <= o->second + left);
+        } else {
+            CHECK(o->second == want);
+        }
+    }
+}
+
+static void test_top_k(void)
+{
+    unsigned long count = test_agent_sent;
+    notif_t n;
+
+    /*
+     * Thirty processes, with memory and CPU time in no particular
+     * order of pid; 303 and 317 tie on memory, and so do the CPU times
+     * of 310 and 320
+     */
+    for (uint64_t pid = 300; pid < 330; pid++) {
+        fixture_proc_t p;
+        fixture_proc_init(&p, "ranked", pid * 100);
+        p.size_pages = 20000 + (pid * 37 % 30) * 100;
+        p.utime = 1000 + pid * 53 % 30 * 10;
+        p.stime = 200;
+        set_process(pid, p);
+    }
+    live[317].size_pages = live[303].size_pages = 25000;
+    set_process(303, live[303]);
+    set_process(317, live[317]);
+    live[320].utime = live[310].utime;
+    set_process(320, live[320]);
+
+    /* Every process, and no others, without a selection */
+    process_stats_opts.top_k = 0;
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.processes.size() == live.size() && !n.has_others);
+    }
+    std::map<uint64_t, entry_t> all = n.processes;
+
+    /* The top 5 by memory, in order, the rest summed */
+    process_stats_opts.top_k = 5;
+    process_stats_opts.rank_by = PROCESS_RANK_MEMORY;
+    std::vector<uint64_t> byMemory = ranked(more_memory);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.order == std::vector<uint64_t>(byMemory.begin(), byMemory.begin() + 5));
+        CHECK(n.order[0] == 303 && n.order[1] == 317);
+        for (size_t i = 0; i < n.order.size(); i++) {
+            check_entry(n, n.order[i]);
+        }
+        check_others(n, all);
+    }
+
+    /* The top 7 by CPU time: the tie goes to the lower pid */
+    process_stats_opts.top_k = 7;
+    process_stats_opts.rank_by = PROCESS_RANK_CPU;
+    std::vector<uint64_t> byCpu = ranked(more_cpu);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.order == std::vector<uint64_t>(byCpu.begin(), byCpu.begin() + 7));
+        check_others(n, all);
+    }
+
+    /* K past the number of processes: all of them, and others empty */
+    process_stats_opts.top_k = 50;
+    process_stats_opts.rank_by = PROCESS_RANK_MEMORY;
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.order == byMemory);
+        check_others(n, all);
+        CHECK(n.others[oc_proc_ext_processes] == 0);
+    }
+
+    /*
+     * Delta mode: a process that climbs into the top 5 is added with
+     * its command line and the one it displaces is removed; once it
+     * drops out again, the other comes back the same way.
+     */
+    process_stats_opts.top_k = 5;
+    process_stats_opts.delta_mode = true;
+    process_stats_opts.sync_cycles = 1000;
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.update_type == oc_proc_ext_delta);
+        CHECK(n.order == std::vector<uint64_t>(byMemory.begin(), byMemory.begin() + 5));
+        check_others(n, all);
+    }
+
+    uint64_t climber = byMemory.back(), fifth = byMemory[4];
+    uint64_t saved = live[climber].size_pages;
+    live[climber].size_pages = 30000;
+    set_process(climber, live[climber]);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.update_type == oc_proc_ext_delta);
+        CHECK(n.processes.size() == 1 && n.processes.count(climber));
+        check_entry(n, climber);
+        CHECK(n.processes[climber].has_args);
+        CHECK(n.removed.size() == 1 && n.removed[0] == fifth);
+        CHECK(n.has_others && n.others[oc_proc_ext_processes] == live.size() - 5);
+    }
+
+    live[climber].size_pages = saved;
+    set_process(climber, live[climber]);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.processes.size() == 1 && n.processes.count(fifth));
+        CHECK(n.processes[fifth].has_args);
+        CHECK(n.removed.size() == 1 && n.removed[0] == climber);
+    }
+
+    /* Quiet: nothing moved, nothing sent, even with others */
+    tick();
+    CHECK(test_agent_sent == count);
+
+    for (uint64_t pid = 300; pid < 330; pid++) {
+        remove_process(pid);
+    }
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.removed.size() == 5);
+    }
+
+    process_stats_opts.delta_mode = false;
+    process_stats_opts.top_k = 0;
+    process_stats_opts.rank_by = PROCESS_RANK_CPU;
+}
+
+/* The I/O and scheduling leaves of an entry, or of others, are these deltas */
+static bool io_is(const std::map<uint32_t, uint64_t>& l, uint64_t read, uint64_t write,
+                  uint64_t wait_ns, uint64_t voluntary, uint64_t involuntary)
+{
+    std::map<uint32_t, uint64_t>::const_iterator r = l.find(oc_proc_ext_io_read_bytes);
+    std::map<uint32_t, uint64_t>::const_iterator w = l.find(oc_proc_ext_io_write_bytes);
+    std::map<uint32_t, uint64_t>::const_iterator q = l.find(oc_proc_ext_run_queue_wait);
+    std::map<uint32_t, uint64_t>::const_iterator v =
+        l.find(oc_proc_ext_voluntary_context_switches);
+    std::map<uint32_t, uint64_t>::const_iterator i =
+        l.find(oc_proc_ext_involuntary_context_switches);
+
+    return r != l.end() && r->second == read && w != l.end() && w->second == write &&
+           q != l.end() && q->second == wait_ns / 1000 && v != l.end() && v->second == voluntary &&
+           i != l.end() && i->second == involuntary;
+}
+
+static bool io_is(const notif_t& n, uint64_t pid, uint64_t read, uint64_t write,
+                  uint64_t wait_ns, uint64_t voluntary, uint64_t involuntary)
+{
+    std::map<uint64_t, entry_t>::const_iterator e = n.processes.find(pid);
+    return e != n.processes.end() &&
+           io_is(e->second.leaves, read, write, wait_ns, voluntary, involuntary);
+}
+
+/*
+ * The I/O and scheduling counters go out as deltas since the previous
+ * notification: zero for the baseline, a counter that went backwards
+ * counts nothing rather than wrapping, and a process new since the
+ * baseline (or a reused pid) counts from its start.
+ */
+static void test_io(void)
+{
+    unsigned long count = test_agent_sent;
+    notif_t n;
+
+    process_stats_opts.io_sched = true;
+    sampler.scanner.io_sched = true;
+
+    for (uint64_t pid = 400; pid < 404; pid++) {
+        fixture_proc_t p;
+        fixture_proc_init(&p, "io", pid * 100);
+        p.read_bytes = pid * 4096;
+        p.write_bytes = pid * 512;
+        p.wait_ns = pid * 1000000;
+        p.voluntary_switches = pid;
+        p.involuntary_switches = pid / 2;
+        set_process(pid, p);
+    }
+
+    /* The baseline: the counters so far are not this interval's */
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.processes.size() == live.size());
+        for (uint64_t pid = 400; pid < 404; pid++) {
+            check_entry(n, pid);
+            CHECK(io_is(n, pid, 0, 0, 0, 0, 0));
+        }
+    }
+
+    /* What moved since */
+    fixture_proc_t& p = live[400];
+    p.read_bytes += 4096;
+    p.write_bytes += 8192;
+    p.wait_ns += 3000000;
+    p.voluntary_switches += 5;
+    p.involuntary_switches += 2;
+    set_process(400, p);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(io_is(n, 400, 4096, 8192, 3000000, 5, 2));
+        CHECK(io_is(n, 401, 0, 0, 0, 0, 0));
+    }
+
+    /* Since the previous notification, not since the baseline */
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(io_is(n, 400, 0, 0, 0, 0, 0));
+    }
+
+    /* Counters that went backwards count nothing, then count from there */
+    fixture_proc_t& back = live[401];
+    back.read_bytes = 100;
+    back.wait_ns = 0;
+    back.voluntary_switches = 1;
+    set_process(401, back);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(io_is(n, 401, 0, 0, 0, 0, 0));
+    }
+    back.read_bytes += 50;
+    back.voluntary_switches += 3;
+    set_process(401, back);
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(io_is(n, 401, 50, 0, 0, 3, 0));
+    }
+
+    /*
+     * A reused pid, with less I/O than the process before it, and a new
+     * one: both count from their start
+     */
+    fixture_proc_t reused, started;
+    fixture_proc_init(&reused, "io-reused", 402 * 1000);
+    reused.read_bytes = 1000;
+    reused.wait_ns = 2000000;
+    set_process(402, reused);
+    fixture_proc_init(&started, "io-new", 404 * 1000);
+    started.write_bytes = 7000;
+    started.involuntary_switches = 9;
+    set_process(404, started);
+    tick();
+    if (sent(&count, &n)) {
+        check_entry(n, 402);
+        CHECK(io_is(n, 402, 1000, 0, 2000000, 0, 0));
+        CHECK(io_is(n, 404, 0, 7000, 0, 0, 9));
+    }
+
+    /* Ranked by I/O over the interval, the rest of it summed into others */
+    live[403].read_bytes += 300;
+    set_process(403, live[403]);
+    live[401].write_bytes += 200;
+    set_process(401, live[401]);
+    live[400].read_bytes += 100;
+    set_process(400, live[400]);
+    process_stats_opts.top_k = 1;
+    process_stats_opts.rank_by = PROCESS_RANK_IO;
+    tick();
+    if (sent(&count, &n)) {
+        CHECK(n.order.size() == 1 && n.order[0] == 403);
+        CHECK(io_is(n, 403, 300, 0, 0, 0, 0));
+        CHECK(n.has_others && io_is(n.others, 100, 200, 0, 0, 0));
+    }
+
+    for (uint64_t pid = 400; pid < 405; pid++) {
+        remove_process(pid);
+    }
+    tick();
+    CHECK(sent(&count, &n));
+
+    process_stats_opts.top_k = 0;
+    process_stats_opts.rank_by = PROCESS_RANK_CPU;
+    process_stats_opts.io_sched = false;
+    sampler.scanner.io_sched = false;
+}
+
+int main(void)
+{
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+
+    root = fixture_make("process_stats_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        return test_result("process_stats_test");
+    }
+
+    test_agent_init(&agent);
+    CHECK(sampler_init(&sampler, root.c_str()) == 0);
+    sched.agent = &agent;
+    sched.sampler = &sampler;
+    process_stats_collector.start(&process_stats_collector, &sched);
+
+    test_delta();
+    test_top_k();
+    test_io();
+
+    sampler_free(&sampler);
+    fixture_remove(root);
+
+    std::cout.rdbuf(out);
+    return test_result("process_stats_test");
+}
@@ -0,0 +1,430 @@
+/**
+ * process_table_collector.cpp
+ *
+ * Populates /oc-sys:system/oc-sys:processes/oc-sys:process with the
+ * current set of processes running on the operating system.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <map>
+
+#include "openconfig-system.h"
+#include "process_table_collector.h"
+
+process_table_opts_t process_table_opts = {
+    false,
+    CACHE_TTL_MS
+};
+
+/* The number of leaves under /system/processes/process/state */
+#define PROCESS_LEAVES 9
+
+/* A process entry as last written to CDB */
+struct pentry_t {
+    pinfo_t info;
+    bool stale;                 /* contents unknown, rewrite every leaf */
+    unsigned int generation;
+};
+
+typedef struct pentry_t pentry_t;
+
+static int cdb_sock = -1;
+static std::map<uint64_t, pentry_t> written_processes;
+
+/*
+ * Entries left behind by a previous run are unknown to us. Track them
+ * as stale so they are either rewritten in full or deleted on the
+ * first cycle.
+ */
+static void load_written_processes(int sock)
+{
+    int n = cdb_num_instances(sock, "/system/processes/process");
+
+    for (int i = 0; i < n; i++) {
+        confd_value_t pid;
+        if (cdb_get(sock, &pid, "/system/processes/process[%d]/pid", i) != CONFD_OK) {
+            continue;
+        }
+
+        pentry_t& entry = written_processes[CONFD_GET_UINT64(&pid)];
+        entry.info.pid = CONFD_GET_UINT64(&pid);
+        entry.stale = true;
+        entry.generation = 0;
+    }
+
+    std::cout << "Found " << written_processes.size() << " process entries in CDB" << std::endl;
+}
+
+/* 'args' has room for every field of p.args */
+static void set_args(const pinfo_t& p, confd_value_t *args, confd_value_t *v)
+{
+    unsigned int n = 0;
+
+    for (const char *a = istr_next_field(p.args, NULL); a != NULL; a = istr_next_field(p.args, a)) {
+        CONFD_SET_STR(&args[n], a); n++;
+    }
+    CONFD_SET_LIST(v, (n > 0) ? args : NULL, n);
+}
+
+/*
+ * Fill 'tv' with the leaves of 'cur' that differ from what was last
+ * written ('prev'), or with every leaf if 'prev' is NULL.
+ * Returns the number of tag values set.
+ */
+static int diff_process(const pentry_t *prev, const pinfo_t& cur,
+                        confd_tag_value_t *tv, std::vector<confd_value_t>& args)
+{
+    const pinfo_t *old = (prev != NULL && !prev->stale) ? &prev->info : NULL;
+    int n = 0;
+
+    if (old == NULL) {
+        CONFD_SET_TAG_UINT64(&tv[n], oc_sys_pid, cur.pid); n++;
+    }
+    if (old == NULL || old->name != cur.name) {
+        CONFD_SET_TAG_STR(&tv[n], oc_sys_name, cur.name.c_str()); n++;
+    }
+    if (old == NULL || old->args != cur.args) {
+        args.resize(istr_fields(cur.args) + 1);
+        tv[n].tag.tag = oc_sys_args;
+        tv[n].tag.ns = 0;
+        set_args(cur, &args[0], &tv[n].v); n++;
+    }
+    if (old == NULL || old->start_time != cur.start_time) {
+        CONFD_SET_TAG_UINT64(&tv[n], oc_sys_start_time, cur.start_time); n++;
+    }
+    if (old == NULL || old->cpu_usage_user != cur.cpu_usage_user) {
+        CONFD_SET_TAG_UINT64(&tv[n], oc_sys_cpu_usage_user, cur.cpu_usage_user); n++;
+    }
+    if (old == NULL || old->cpu_usage_system != cur.cpu_usage_system) {
+        CONFD_SET_TAG_UINT64(&tv[n], oc_sys_cpu_usage_system, cur.cpu_usage_system); n++;
+    }
+    if (old == NULL || old->cpu_utilization != cur.cpu_utilization) {
+        CONFD_SET_TAG_UINT8(&tv[n], oc_sys_cpu_utilization, cur.cpu_utilization); n++;
+    }
+    if (old == NULL || old->memory_usage != cur.memory_usage) {
+        CONFD_SET_TAG_UINT64(&tv[n], oc_sys_memory_usage, cur.memory_usage); n++;
+    }
+    if (old == NULL || old->memory_utilization != cur.memory_utilization) {
+        CONFD_SET_TAG_UINT8(&tv[n], oc_sys_memory_utilization, cur.memory_utilization); n++;
+    }
+
+    return n;
+}
+
+/*
+ * Bring /system/processes/process in line with the current process
+ * table. Only leaves that changed since the last cycle are written,
+ * with a single cdb_set_values() per entry, and entries of exited
+ * processes are deleted.
+ */
+static int populate_processes(collector_t *c, scheduler_t *sched)
+{
+    static unsigned int generation = 0;
+
+    if (cdb_sock < 0) {
+        cdb_sock = confd_agent_cdb_connect(sched->agent, CDB_DATA_SOCKET,
+                                           "system_processes_state_monitor");
+        OK(cdb_start_session(cdb_sock, CDB_OPERATIONAL));
+        OK(cdb_set_namespace(cdb_sock, oc_sys__ns));
+        load_written_processes(cdb_sock);
+    } else {
+        OK(cdb_start_session(cdb_sock, CDB_OPERATIONAL));
+        OK(cdb_set_namespace(cdb_sock, oc_sys__ns));
+    }
+
+    generation++;
+
+    int created = 0, updated = 0, deleted = 0, unchanged = 0;
+    confd_tag_value_t tv[PROCESS_LEAVES];
+    std::vector<confd_value_t> args;
+
+    /*
+     * Get all processes on the NOS
+     */
+    const proc_table_t& processList = sampler_processes(sched->sampler);
+    pinfo_t cur;
+    for (uint32_t row = 0; row < proc_table_rows(&processList); row++) {
+        proc_table_row(&processList, row, &cur);
+
+        unsigned int pid = (unsigned int) cur.pid;
+        std::map<uint64_t, pentry_t>::iterator w = written_processes.find(cur.pid);
+        int n;
+
+        if (w == written_processes.end()) {
+            OK(cdb_create(cdb_sock, "/system/processes/process{%u}", pid));
+            n = diff_process(NULL, cur, tv, args);
+            w = written_processes.insert(std::make_pair(cur.pid, pentry_t())).first;
+            created++;
+        } else {
+            n = diff_process(&w->second, cur, tv, args);
+            if (n == 0) {
+                unchanged++;
+            } else {
+                updated++;
+            }
+        }
+
+        if (n > 0) {
+            OK(cdb_set_values(cdb_sock, tv, n, "/system/processes/process{%u}/state", pid));
+        }
+
+        w->second.info = cur;
+        w->second.stale = false;
+        w->second.generation = generation;
+    }
+
+    std::map<uint64_t, pentry_t>::iterator w = written_processes.begin();
+    while (w != written_processes.end()) {
+        if (w->second.generation != generation) {
+            OK(cdb_delete(cdb_sock, "/system/processes/process{%u}", (unsigned int) w->first));
+            written_processes.erase(w++);
+            deleted++;
+        } else {
+            ++w;
+        }
+    }
+
+    OK(cdb_end_session(cdb_sock));
+
+    std::cout << "Processes: " << created << " created, " << updated << " updated, "
+              << deleted << " deleted, " << unchanged << " unchanged" << std::endl;
+
+    return CONFD_OK;
+}
+
+/*
+ * Data provider mode
+ *
+ * Instead of pushing the process table into CDB every interval, serve
+ * /system/processes/process on demand through the process_mon_cp
+ * callpoint (see yang/openconfig-system-ann.yang). Reads are answered
+ * from a snapshot that is rescanned only when a transaction starts and
+ * the snapshot is older than the TTL, so an idle NE does no work.
+ */
+#define OBJECTS_PER_REPLY 64
+#define PROCESS_TAGS (PROCESS_LEAVES + 3)
+
+static scheduler_t *dp_sched;
+static std::vector<pinfo_t> cached_processes;   /* sorted by pid */
+static unsigned int cached_generation = 0;
+
+static bool cmp_pid(const pinfo_t& a, const pinfo_t& b)
+{
+    return a.pid < b.pid;
+}
+
+static void refresh_cache(void *opaque)
+{
+    sampler_t *sampler = dp_sched->sampler;
+
+    /* The other samples, and the CPU baselines of the streams, are left alone */
+    if (sampler_processes_age_ms(sampler) >= process_table_opts.cache_ttl_ms) {
+        sampler_refresh_processes(sampler);
+    }
+
+    const proc_table_t& processes = sampler_processes(sampler);
+    if (cached_generation == sampler->processes_generation) {
+        return;
+    }
+
+    cached_processes.resize(proc_table_rows(&processes));
+    for (uint32_t row = 0; row < proc_table_rows(&processes); row++) {
+        proc_table_row(&processes, row, &cached_processes[row]);
+    }
+    std::sort(cached_processes.begin(), cached_processes.end(), cmp_pid);
+    cached_generation = sampler->processes_generation;
+}
+
+static const pinfo_t *find_process(const confd_value_t *key)
+{
+    pinfo_t p;
+    p.pid = CONFD_GET_UINT64(key);
+
+    std::vector<pinfo_t>::const_iterator it =
+        std::lower_bound(cached_processes.begin(), cached_processes.end(), p, cmp_pid);
+    if (it == cached_processes.end() || it->pid != p.pid) {
+        return NULL;
+    }
+    return &(*it);
+}
+
+/*
+ * The list key is at v[1] for /process{K}/pid and at v[2] for
+ * /process{K}/state/<leaf>.
+ */
+static const confd_value_t *process_key(const confd_hkeypath_t *kp)
+{
+    return (kp->v[1][0].type == C_XMLTAG) ? &kp->v[2][0] : &kp->v[1][0];
+}
+
+/* A whole list entry: pid followed by the state container */
+static int process_to_tags(const pinfo_t& p, confd_tag_value_t *tv, confd_value_t *args)
+{
+    int n = 0;
+
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_pid, p.pid); n++;
+    CONFD_SET_TAG_XMLBEGIN(&tv[n], oc_sys_state, oc_sys__ns); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_pid, p.pid); n++;
+    CONFD_SET_TAG_STR(&tv[n], oc_sys_name, p.name.c_str()); n++;
+    tv[n].tag.tag = oc_sys_args;
+    tv[n].tag.ns = 0;
+    set_args(p, args, &tv[n].v); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_start_time, p.start_time); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_cpu_usage_user, p.cpu_usage_user); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_cpu_usage_system, p.cpu_usage_system); n++;
+    CONFD_SET_TAG_UINT8(&tv[n], oc_sys_cpu_utilization, p.cpu_utilization); n++;
+    CONFD_SET_TAG_UINT64(&tv[n], oc_sys_memory_usage, p.memory_usage); n++;
+    CONFD_SET_TAG_UINT8(&tv[n], oc_sys_memory_utilization, p.memory_utilization); n++;
+    CONFD_SET_TAG_XMLEND(&tv[n], oc_sys_state, oc_sys__ns); n++;
+
+    return n;
+}
+
+static int get_next(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp, long next)
+{
+    long i = (next == -1) ? 0 : next;
+
+    if (i >= (long) cached_processes.size()) {
+        return confd_data_reply_next_key(tctx, NULL, -1, -1);
+    }
+
+    confd_value_t key;
+    CONFD_SET_UINT64(&key, cached_processes[i].pid);
+    return confd_data_reply_next_key(tctx, &key, 1, i + 1);
+}
+
+static int get_elem(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp)
+{
+    const pinfo_t *p = find_process(process_key(kp));
+    if (p == NULL) {
+        return confd_data_reply_not_found(tctx);
+    }
+
+    confd_value_t v;
+    std::vector<confd_value_t> args(istr_fields(p->args) + 1);
+
+    switch (CONFD_GET_XMLTAG(&kp->v[0][0])) {
+    case oc_sys_pid:
+        CONFD_SET_UINT64(&v, p->pid);
+        break;
+    case oc_sys_name:
+        CONFD_SET_STR(&v, p->name.c_str());
+        break;
+    case oc_sys_args:
+        set_args(*p, &args[0], &v);
+        break;
+    case oc_sys_start_time:
+        CONFD_SET_UINT64(&v, p->start_time);
+        break;
+    case oc_sys_cpu_usage_user:
+        CONFD_SET_UINT64(&v, p->cpu_usage_user);
+        break;
+    case oc_sys_cpu_usage_system:
+        CONFD_SET_UINT64(&v, p->cpu_usage_system);
+        break;
+    case oc_sys_cpu_utilization:
+        CONFD_SET_UINT8(&v, p->cpu_utilization);
+        break;
+    case oc_sys_memory_usage:
+        CONFD_SET_UINT64(&v, p->memory_usage);
+        break;
+    case oc_sys_memory_utilization:
+        CONFD_SET_UINT8(&v, p->memory_utilization);
+        break;
+    default:
+        return confd_data_reply_not_found(tctx);
+    }
+
+    return confd_data_reply_value(tctx, &v);
+}
+
+static int get_object(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp)
+{
+    const pinfo_t *p = find_process(&kp->v[0][0]);
+    if (p == NULL) {
+        return confd_data_reply_not_found(tctx);
+    }
+
+    confd_tag_value_t tv[PROCESS_TAGS];
+    std::vector<confd_value_t> args(istr_fields(p->args) + 1);
+
+    int n = process_to_tags(*p, tv, &args[0]);
+    return confd_data_reply_tag_value_array(tctx, tv, n);
+}
+
+/* Return up to OBJECTS_PER_REPLY entries per round-trip */
+static int get_next_object(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp, long next)
+{
+    long first = (next == -1) ? 0 : next;
+    long total = (long) cached_processes.size();
+    long last = std::min(first + OBJECTS_PER_REPLY, total);
+
+    if (first >= total) {
+        return confd_data_reply_next_object_tag_value_array(tctx, NULL, -1, -1);
+    }
+
+    size_t nargs = 0;
+    for (long i = first; i < last; i++) {
+        nargs += istr_fields(cached_processes[i].args);
+    }
+
+    std::vector<confd_tag_value_t> tv((last - first) * PROCESS_TAGS);
+    std::vector<confd_value_t> args(nargs + 1);
+    std::vector<struct confd_tag_next_object> objs;
+    objs.reserve(last - first + 1);
+
+    confd_value_t *a = &args[0];
+    for (long i = first; i < last; i++) {
+        struct confd_tag_next_object obj;
+        obj.tv = &tv[(i - first) * PROCESS_TAGS];
+        obj.n = process_to_tags(cached_processes[i], obj.tv, a);
+        obj.next = i + 1;
+        objs.push_back(obj);
+        a += istr_fields(cached_processes[i].args);
+    }
+
+    if (last == total) {
+        struct confd_tag_next_object end;
+        end.tv = NULL;
+        end.n = 0;
+        end.next = -1;
+        objs.push_back(end);
+    }
+
+    return confd_data_reply_next_object_tag_value_arrays(tctx, &objs[0], objs.size(), 0);
+}
+
+static void start_process_table(collector_t *c, scheduler_t *sched)
+{
+    struct confd_data_cbs data;
+
+    if (!process_table_opts.data_provider) {
+        return;
+    }
+
+    dp_sched = sched;
+    c->on_demand = true;
+
+    memset(&data, 0, sizeof(data));
+    strcpy(data.callpoint, "process_mon_cp");
+    data.get_elem = get_elem;
+    data.get_next = get_next;
+    data.get_object = get_object;
+    data.get_next_object = get_next_object;
+    confd_agent_register_data(sched->agent, &data, refresh_cache, NULL);
+}
+
+collector_t process_table_collector = {
+    "process-table",
+    false,                      /* adaptive */
+    PROCESS_TABLE_INTERVAL,
+    false,                      /* on_demand, set in data provider mode */
+    start_process_table,
+    populate_processes,
+    NULL,                       /* cadence */
+    0
+};
@@ -0,0 +1,29 @@
+/**
+ * process_table_collector.h
+ *
+ * Populates the openconfig-system.yang subtree
+ * /oc-sys:system/oc-sys:processes/oc-sys:process, either by pushing
+ * the process table into CDB at a fixed interval or by serving it on
+ * demand as a data provider.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PROCESS_TABLE_COLLECTOR_H
+#define PROCESS_TABLE_COLLECTOR_H
+
+#include "scheduler.h"
+
+#define PROCESS_TABLE_INTERVAL 10
+#define CACHE_TTL_MS 1000
+
+struct process_table_opts_t {
+    bool data_provider;         /* serve through the process_mon_cp callpoint */
+    unsigned int cache_ttl_ms;  /* data provider snapshot lifetime */
+};
+
+typedef struct process_table_opts_t process_table_opts_t;
+
+extern process_table_opts_t process_table_opts;
+extern collector_t process_table_collector;
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * psi.cpp
+ *
+ * Pressure stall triggers driving burst cadence.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "psi.h"
+
+struct psi_trigger_t {
+    const char *resource;
+    unsigned int stall_us;
+    bool cadences;              /* also burst the collectors' own cadences */
+    int fd;
+    unsigned long events;
+};
+
+typedef struct psi_trigger_t psi_trigger_t;
+
+static psi_trigger_t triggers[] = {
+    { "cpu",    PSI_CPU_STALL_US,    false, -1, 0 },
+    { "memory", PSI_MEMORY_STALL_US, true,  -1, 0 },
+    { "io",     PSI_IO_STALL_US,     false, -1, 0 }
+};
+
+#define PSI_TRIGGERS ((int) (sizeof(triggers) / sizeof(triggers[0])))
+
+static scheduler_t *psi_sched;
+
+/*
+ * The trigger lives as long as the descriptor it was written to stays
+ * open, see Documentation/accounting/psi.rst.
+ */
+static int open_trigger(psi_trigger_t *t)
+{
+    char path[64], trigger[64];
+    int fd, len;
+
+    snprintf(path, sizeof(path), "%s/%s", PSI_ROOT, t->resource);
+    len = snprintf(trigger, sizeof(trigger), "some %u %u", t->stall_us, PSI_WINDOW_US);
+
+    if ((fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0) {
+        return -1;
+    }
+    if (write(fd, trigger, len + 1) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+static void psi_stall(int fd, uint32_t events, void *opaque)
+{
+    psi_trigger_t *t = (psi_trigger_t *) opaque;
+    scheduler_t *sched = psi_sched;
+
+    if (events & EPOLLERR) {
+        std::cout << "PSI: " << t->resource << " trigger went away" << std::endl;
+        reactor_del_fd(&sched->reactor, fd);
+        close(fd);
+        t->fd = -1;
+        return;
+    }
+
+    t->events++;
+    std::cout << "PSI: " << t->resource << " stall threshold crossed ("
+              << t->events << "), bursting for " << PSI_BURST_MS << "ms" << std::endl;
+
+    scheduler_burst(sched, &sched->adaptive, PSI_BURST_MS);
+
+    if (t->cadences) {
+        for (size_t i = 0; i < sched->collectors.size(); i++) {
+            collector_t *c = sched->collectors[i];
+            if (c->cadence != NULL) {
+                scheduler_burst(sched, c->cadence, PSI_BURST_MS);
+            }
+        }
+    }
+}
+
+int psi_start(scheduler_t *sched)
+{
+    int registered = 0;
+
+    psi_sched = sched;
+
+    for (int i = 0; i < PSI_TRIGGERS; i++) {
+        psi_trigger_t *t = &triggers[i];
+
+        if ((t->fd = open_trigger(t)) < 0) {
+            std::cout << "PSI: no " << t->resource << " trigger (" << strerror(errno) << ")"
+                      << std::endl;
+            continue;
+        }
+        if (reactor_add_fd(&sched->reactor, t->fd, EPOLLPRI, psi_stall, t) < 0) {
+            confd_fatal("Failed to watch the %s pressure trigger\n", t->resource);
+        }
+        registered++;
+    }
+
+    if (registered == 0) {
+        std::cout << "PSI: not available, adapting to the load average only" << std::endl;
+    }
+    return registered;
+}
@@ -0,0 +1,40 @@
+/**
+ * psi.h
+ *
+ * Pressure stall information (PSI) triggers. The load average is
+ * updated every 5 seconds and smoothed over a minute, so it lags a
+ * spike by about as long as the spike lasts. A PSI trigger on
+ * /proc/pressure/{cpu,memory,io} instead wakes the reactor (POLLPRI)
+ * as soon as tasks stalled for longer than the threshold within the
+ * window, and the affected streams switch to burst cadence, i.e. their
+ * minimum interval, for PSI_BURST_MS.
+ *
+ * CPU and I/O stalls burst the shared adaptive interval; memory stalls
+ * burst it and every collector's own cadence. On kernels without PSI
+ * (before 4.20, or booted with psi=0) nothing is registered and the
+ * load average alone drives the interval.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef PSI_H
+#define PSI_H
+
+#include "scheduler.h"
+
+#define PSI_ROOT "/proc/pressure"
+
+/*
+ * Stall thresholds in microseconds of "some" stall per window. A window
+ * of 2 seconds is the shortest unprivileged processes may use.
+ */
+#define PSI_WINDOW_US 2000000
+#define PSI_CPU_STALL_US 200000
+#define PSI_MEMORY_STALL_US 100000
+#define PSI_IO_STALL_US 200000
+
+#define PSI_BURST_MS 10000
+
+/* Returns the number of triggers registered, 0 without PSI */
+int psi_start(scheduler_t *sched);
+
+#endif
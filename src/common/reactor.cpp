@@ -0,0 +1,167 @@
+/**
+ * reactor.cpp
+ *
+ * epoll(7) based event loop with a timerfd for absolute deadlines.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "reactor.h"
+
+int reactor_init(reactor_t *r)
+{
+    r->epfd = -1;
+    r->timerfd = -1;
+    r->deadline_ms = 0;
+    r->timer.fd = -1;
+    r->timer.cb = NULL;
+    r->timer.opaque = NULL;
+    r->handlers.clear();
+
+    if ((r->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        return -1;
+    }
+
+    if ((r->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+        close(r->epfd);
+        r->epfd = -1;
+        return -1;
+    }
+    r->timer.fd = r->timerfd;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &r->timer;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->timerfd, &ev) < 0) {
+        reactor_free(r);
+        return -1;
+    }
+
+    return 0;
+}
+
+void reactor_free(reactor_t *r)
+{
+    for (size_t i = 0; i < r->handlers.size(); i++) {
+        delete r->handlers[i];
+    }
+    r->handlers.clear();
+
+    if (r->timerfd >= 0) {
+        close(r->timerfd);
+        r->timerfd = -1;
+    }
+    if (r->epfd >= 0) {
+        close(r->epfd);
+        r->epfd = -1;
+    }
+}
+
+int reactor_add_fd(reactor_t *r, int fd, uint32_t events, reactor_cb_t cb, void *opaque)
+{
+    reactor_handler_t *h = new reactor_handler_t;
+    h->fd = fd;
+    h->cb = cb;
+    h->opaque = opaque;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = h;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        delete h;
+        return -1;
+    }
+
+    r->handlers.push_back(h);
+    return 0;
+}
+
+int reactor_del_fd(reactor_t *r, int fd)
+{
+    for (size_t i = 0; i < r->handlers.size(); i++) {
+        if (r->handlers[i]->fd == fd) {
+            epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL);
+            /* Events for it may still be pending in this batch */
+            r->handlers[i]->fd = -1;
+            r->handlers[i]->cb = NULL;
+            return 0;
+        }
+    }
+
+    errno = ENOENT;
+    return -1;
+}
+
+int reactor_set_timer(reactor_t *r, reactor_cb_t cb, void *opaque)
+{
+    r->timer.cb = cb;
+    r->timer.opaque = opaque;
+    return 0;
+}
+
+int reactor_arm(reactor_t *r, uint64_t deadline_ms)
+{
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    /* An all-zero it_value disarms, so a deadline of "now or earlier" is 1ns */
+    if (deadline_ms > 0) {
+        its.it_value.tv_sec = deadline_ms / 1000;
+        its.it_value.tv_nsec = (deadline_ms % 1000) * 1000000;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+            its.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(r->timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        return -1;
+    }
+
+    r->deadline_ms = deadline_ms;
+    return 0;
+}
+
+int reactor_poll(reactor_t *r, int timeout_ms)
+{
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    int n = epoll_wait(r->epfd, events, REACTOR_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        reactor_handler_t *h = (reactor_handler_t *) events[i].data.ptr;
+
+        if (h == &r->timer) {
+            uint64_t expirations;
+            if (read(r->timerfd, &expirations, sizeof(expirations)) < 0 && errno == EAGAIN) {
+                continue;       /* re-armed by an earlier callback in this batch */
+            }
+            r->deadline_ms = 0;
+        }
+
+        if (h->cb != NULL) {
+            h->cb(h->fd, events[i].events, h->opaque);
+        }
+    }
+
+    /* Reap handlers removed while dispatching */
+    for (size_t i = 0; i < r->handlers.size(); ) {
+        if (r->handlers[i]->fd < 0) {
+            delete r->handlers[i];
+            r->handlers.erase(r->handlers.begin() + i);
+        } else {
+            i++;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,61 @@
+/**
+ * reactor.h
+ *
+ * epoll(7) based event loop. File descriptors (the ConfD control and
+ * worker sockets, and anything else a collector wants to watch) are
+ * dispatched to a callback as they become ready. A single timerfd,
+ * armed with absolute CLOCK_MONOTONIC deadlines, drives the scheduler
+ * so that tick times do not drift by the time spent collecting.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#define REACTOR_MAX_EVENTS 16
+
+typedef void (*reactor_cb_t)(int fd, uint32_t events, void *opaque);
+
+struct reactor_handler_t {
+    int fd;
+    reactor_cb_t cb;
+    void *opaque;
+};
+
+typedef struct reactor_handler_t reactor_handler_t;
+
+struct reactor_t {
+    int epfd;
+    int timerfd;
+    uint64_t deadline_ms;       /* armed deadline, 0 if disarmed */
+    reactor_handler_t timer;
+    std::vector<reactor_handler_t *> handlers;
+};
+
+typedef struct reactor_t reactor_t;
+
+/* All functions return 0 on success and -1 with errno set on failure */
+int reactor_init(reactor_t *r);
+void reactor_free(reactor_t *r);
+
+int reactor_add_fd(reactor_t *r, int fd, uint32_t events, reactor_cb_t cb, void *opaque);
+int reactor_del_fd(reactor_t *r, int fd);
+
+/*
+ * The timer callback is called once 'deadline_ms' (monotonic_ms()
+ * time base) has passed. Arming replaces the previous deadline and a
+ * deadline of 0 disarms the timer. A deadline in the past fires on the
+ * next reactor_poll().
+ */
+int reactor_set_timer(reactor_t *r, reactor_cb_t cb, void *opaque);
+int reactor_arm(reactor_t *r, uint64_t deadline_ms);
+
+/* Dispatch one batch of events, waiting up to 'timeout_ms' (-1 forever) */
+int reactor_poll(reactor_t *r, int timeout_ms);
+
+#endif
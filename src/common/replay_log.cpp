@@ -0,0 +1,757 @@
+/**
+ * replay_log.cpp
+ *
+ * Memory-mapped notification log backing NETCONF replay.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/eventfd.h>
+
+#include "replay_log.h"
+
+#define SEGMENT_MAGIC "TLMRPLY1"
+#define SEGMENT_HEADER_BYTES 64
+
+/* Names taken by files load_segments() ignored, skipped before giving up */
+#define SEGMENT_CREATE_TRIES 16
+
+/* At the start of every segment file */
+struct segment_header_t {
+    char magic[8];
+    uint64_t seq;
+    uint64_t opened_us;         /* when this segment was created */
+    uint64_t created_us;        /* carried over from segment to segment */
+    uint64_t aged_us;
+    uint32_t used;              /* bytes of complete records, header included */
+};
+
+/*
+ * Followed by 'nvals' encoded tag values: tag, namespace, type and the
+ * value. Records are 8-byte aligned; 'len' includes the padding.
+ */
+struct record_header_t {
+    uint32_t len;
+    uint32_t nvals;
+    uint32_t nlist;             /* leaf-list elements in the record */
+    uint32_t reserved;
+    uint64_t time_us;
+};
+
+#define ALIGN8(n) (((n) + 7) & ~((size_t) 7))
+
+static uint64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static segment_header_t *header(replay_segment_t *seg)
+{
+    return (segment_header_t *) seg->base;
+}
+
+/* Encoded size of a value, -1 for a type the log does not store */
+static long value_size(const confd_value_t *v, bool in_list)
+{
+    switch (v->type) {
+    case C_XMLBEGIN:
+    case C_XMLEND:
+    case C_XMLTAG:
+    case C_NOEXISTS:
+        return 1;
+    case C_INT8:
+    case C_UINT8:
+        return 1 + 1;
+    case C_INT16:
+    case C_UINT16:
+        return 1 + 2;
+    case C_INT32:
+    case C_UINT32:
+    case C_ENUM_VALUE:
+    case C_BOOL:
+        return 1 + 4;
+    case C_INT64:
+    case C_UINT64:
+    case C_DOUBLE:
+        return 1 + 8;
+    case C_DECIMAL64:
+        return 1 + 8 + 1;
+    case C_STR:
+        return 1 + 4 + strlen(v->val.s) + 1;
+    case C_BUF:
+        return 1 + 4 + v->val.buf.size + 1;
+    case C_LIST: {
+        long size = 1 + 4;
+        if (in_list) {
+            return -1;
+        }
+        for (unsigned int i = 0; i < v->val.list.size; i++) {
+            long n = value_size(&v->val.list.ptr[i], true);
+            if (n < 0) {
+                return -1;
+            }
+            size += n;
+        }
+        return size;
+    }
+    default:
+        return -1;
+    }
+}
+
+static unsigned char *put(unsigned char *p, const void *data, size_t len)
+{
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static unsigned char *put_value(unsigned char *p, const confd_value_t *v)
+{
+    uint8_t type = (uint8_t) v->type;
+    uint32_t len;
+
+    p = put(p, &type, 1);
+    switch (v->type) {
+    case C_INT8:
+        return put(p, &v->val.i8, 1);
+    case C_UINT8:
+        return put(p, &v->val.u8, 1);
+    case C_INT16:
+        return put(p, &v->val.i16, 2);
+    case C_UINT16:
+        return put(p, &v->val.u16, 2);
+    case C_INT32:
+        return put(p, &v->val.i32, 4);
+    case C_UINT32:
+        return put(p, &v->val.u32, 4);
+    case C_ENUM_VALUE:
+        return put(p, &v->val.enumvalue, 4);
+    case C_BOOL: {
+        int32_t b = v->val.boolean;
+        return put(p, &b, 4);
+    }
+    case C_INT64:
+        return put(p, &v->val.i64, 8);
+    case C_UINT64:
+        return put(p, &v->val.u64, 8);
+    case C_DOUBLE:
+        return put(p, &v->val.d, 8);
+    case C_DECIMAL64:
+        p = put(p, &v->val.d64.value, 8);
+        return put(p, &v->val.d64.fraction_digits, 1);
+    case C_STR:
+        len = strlen(v->val.s) + 1;
+        p = put(p, &len, 4);
+        return put(p, v->val.s, len);
+    case C_BUF:
+        /* NUL terminated as well, so that it can be replayed in place */
+        len = v->val.buf.size + 1;
+        p = put(p, &len, 4);
+        p = put(p, v->val.buf.ptr, len - 1);
+        *p = '\0';
+        return p + 1;
+    case C_LIST:
+        len = v->val.list.size;
+        p = put(p, &len, 4);
+        for (unsigned int i = 0; i < len; i++) {
+            p = put_value(p, &v->val.list.ptr[i]);
+        }
+        return p;
+    default:
+        return p;
+    }
+}
+
+static const unsigned char *get(const unsigned char *p, void *data, size_t len)
+{
+    memcpy(data, p, len);
+    return p + len;
+}
+
+/*
+ * Strings are not copied: they point into the mapped segment, which
+ * stays mapped while the notification is sent.
+ */
+static const unsigned char *get_value(const unsigned char *p, confd_value_t *v,
+                                      confd_value_t **list)
+{
+    uint8_t type;
+    uint32_t len;
+
+    p = get(p, &type, 1);
+    v->type = (enum confd_vtype) type;
+    switch (v->type) {
+    case C_INT8:
+        return get(p, &v->val.i8, 1);
+    case C_UINT8:
+        return get(p, &v->val.u8, 1);
+    case C_INT16:
+        return get(p, &v->val.i16, 2);
+    case C_UINT16:
+        return get(p, &v->val.u16, 2);
+    case C_INT32:
+        return get(p, &v->val.i32, 4);
+    case C_UINT32:
+        return get(p, &v->val.u32, 4);
+    case C_ENUM_VALUE:
+        return get(p, &v->val.enumvalue, 4);
+    case C_BOOL: {
+        int32_t b;
+        p = get(p, &b, 4);
+        v->val.boolean = b;
+        return p;
+    }
+    case C_INT64:
+        return get(p, &v->val.i64, 8);
+    case C_UINT64:
+        return get(p, &v->val.u64, 8);
+    case C_DOUBLE:
+        return get(p, &v->val.d, 8);
+    case C_DECIMAL64:
+        p = get(p, &v->val.d64.value, 8);
+        return get(p, &v->val.d64.fraction_digits, 1);
+    case C_STR:
+        p = get(p, &len, 4);
+        v->val.s = (char *) p;
+        return p + len;
+    case C_BUF:
+        p = get(p, &len, 4);
+        v->val.buf.ptr = (unsigned char *) p;
+        v->val.buf.size = len - 1;
+        return p + len;
+    case C_LIST:
+        p = get(p, &len, 4);
+        v->val.list.ptr = *list;
+        v->val.list.size = len;
+        *list += len;
+        for (uint32_t i = 0; i < len; i++) {
+            p = get_value(p, &v->val.list.ptr[i], list);
+        }
+        return p;
+    default:
+        return p;
+    }
+}
+
+static void unmap_segment(replay_segment_t *seg)
+{
+    munmap(seg->base, REPLAY_SEGMENT_BYTES);
+    close(seg->fd);
+    delete seg;
+}
+
+static replay_segment_t *map_segment(const std::string& path, bool create)
+{
+    replay_segment_t *seg;
+    struct stat st;
+    void *base;
+    int fd;
+
+    fd = open(path.c_str(), create ? O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC : O_RDWR | O_CLOEXEC,
+              0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    /* Touching a page past the end of a shorter file would be a SIGBUS */
+    if (!create && (fstat(fd, &st) < 0 || st.st_size != REPLAY_SEGMENT_BYTES)) {
+        close(fd);
+        return NULL;
+    }
+    /* Sparse: the blocks are allocated as records are written */
+    if (create && ftruncate(fd, REPLAY_SEGMENT_BYTES) < 0) {
+        close(fd);
+        unlink(path.c_str());
+        return NULL;
+    }
+
+    base = mmap(NULL, REPLAY_SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    seg = new replay_segment_t;
+    seg->path = path;
+    seg->fd = fd;
+    seg->base = (unsigned char *) base;
+    seg->seq = 0;
+    return seg;
+}
+
+static std::string segment_path(replay_log_t *log, uint64_t seq)
+{
+    char name[64];
+
+    snprintf(name, sizeof(name), ".%020" PRIu64 ".seg", seq);
+    return log->dir + "/" + log->stream + name;
+}
+
+static replay_segment_t *tail(replay_log_t *log)
+{
+    return log->segments.empty() ? NULL : log->segments.back();
+}
+
+static replay_segment_t *new_segment(replay_log_t *log, uint64_t now_us)
+{
+    replay_segment_t *last = tail(log);
+    uint64_t seq = (last != NULL) ? last->seq + 1 : 1;
+    replay_segment_t *seg = NULL;
+
+    /*
+     * A file already there is not one of ours (those are all below
+     * seq): a segment that could not be indexed, left for inspection.
+     * Its number is skipped.
+     */
+    for (int tries = 1; ; tries++, seq++) {
+        seg = map_segment(segment_path(log, seq), true);
+        if (seg != NULL || errno != EEXIST || tries == SEGMENT_CREATE_TRIES) {
+            break;
+        }
+        std::cout << "Replay log: " << segment_path(log, seq) << " is in the way, skipped"
+                  << std::endl;
+    }
+    if (seg == NULL) {
+        std::cout << "Replay log: cannot create " << segment_path(log, seq) << ": "
+                  << strerror(errno) << std::endl;
+        return NULL;
+    }
+
+    segment_header_t *h = header(seg);
+    memcpy(h->magic, SEGMENT_MAGIC, sizeof(h->magic));
+    h->seq = seq;
+    h->opened_us = now_us;
+    h->created_us = log->created_us;
+    h->aged_us = log->aged_us;
+    h->used = SEGMENT_HEADER_BYTES;
+
+    seg->seq = seq;
+    if (last != NULL) {
+        seg->index.reserve(last->index.size());
+    }
+    log->segments.push_back(seg);
+    return seg;
+}
+
+static uint64_t last_time(const replay_segment_t *seg)
+{
+    return seg->index.empty() ? 0 : seg->index.back().time_us;
+}
+
+/* Deletes the oldest segments past the size or age limit, never the tail */
+static void expire_segments(replay_log_t *log, uint64_t now_us)
+{
+    uint64_t max_age_us = (uint64_t) REPLAY_MAX_AGE_S * 1000000;
+
+    while (log->segments.size() > 1) {
+        replay_segment_t *oldest = log->segments.front();
+        uint64_t newest = last_time(oldest);
+
+        if (log->segments.size() <= REPLAY_MAX_SEGMENTS &&
+            newest + max_age_us >= now_us) {
+            break;
+        }
+
+        if (newest > log->aged_us) {
+            log->aged_us = newest;
+        }
+        unlink(oldest->path.c_str());
+        unmap_segment(oldest);
+        log->segments.erase(log->segments.begin());
+    }
+
+    header(tail(log))->aged_us = log->aged_us;
+}
+
+/* Rebuilds the index of a segment found on disk; false if it is not one */
+static bool index_segment(replay_segment_t *seg)
+{
+    segment_header_t *h = header(seg);
+    uint32_t offset = SEGMENT_HEADER_BYTES;
+
+    if (memcmp(h->magic, SEGMENT_MAGIC, sizeof(h->magic)) != 0 ||
+        h->used < SEGMENT_HEADER_BYTES || h->used > REPLAY_SEGMENT_BYTES) {
+        return false;
+    }
+
+    seg->seq = h->seq;
+    while (offset + sizeof(record_header_t) <= h->used) {
+        record_header_t rec;
+        replay_index_t entry;
+
+        memcpy(&rec, seg->base + offset, sizeof(rec));
+        if (rec.len < sizeof(rec) || offset + rec.len > h->used) {
+            break;
+        }
+        entry.time_us = rec.time_us;
+        entry.offset = offset;
+        seg->index.push_back(entry);
+        offset += rec.len;
+    }
+    /* A record cut short by a crash is overwritten */
+    h->used = offset;
+    return true;
+}
+
+static bool segment_less(const replay_segment_t *a, const replay_segment_t *b)
+{
+    return a->seq < b->seq;
+}
+
+static void load_segments(replay_log_t *log)
+{
+    std::string prefix = log->stream + ".";
+    DIR *dir = opendir(log->dir.c_str());
+    struct dirent *ent;
+
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        std::string name(ent->d_name);
+
+        if (name.compare(0, prefix.size(), prefix) != 0 ||
+            name.size() < 4 || name.compare(name.size() - 4, 4, ".seg") != 0) {
+            continue;
+        }
+
+        replay_segment_t *seg = map_segment(log->dir + "/" + name, false);
+        if (seg == NULL) {
+            continue;
+        }
+        if (!index_segment(seg)) {
+            std::cout << "Replay log: ignoring " << seg->path << std::endl;
+            unmap_segment(seg);
+            continue;
+        }
+        log->segments.push_back(seg);
+    }
+    closedir(dir);
+
+    std::sort(log->segments.begin(), log->segments.end(), segment_less);
+}
+
+replay_log_t *replay_log_open(const char *dir, const char *stream)
+{
+    replay_log_t *log;
+    uint64_t now = wall_us();
+    size_t records = 0;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        std::cout << "Replay log: cannot create " << dir << ": " << strerror(errno)
+                  << ", replay disabled" << std::endl;
+        return NULL;
+    }
+
+    log = new replay_log_t;
+    log->dir = dir;
+    log->stream = stream;
+    log->created_us = now;
+    log->aged_us = 0;
+    log->wakefd = -1;
+    tv_arena_init(&log->decoded, "replay", 0);
+
+    load_segments(log);
+
+    if (tail(log) != NULL) {
+        segment_header_t *h = header(tail(log));
+        log->created_us = h->created_us;
+        log->aged_us = h->aged_us;
+    } else if (new_segment(log, now) == NULL) {
+        delete log;
+        return NULL;
+    }
+    expire_segments(log, now);
+
+    for (size_t i = 0; i < log->segments.size(); i++) {
+        records += log->segments[i]->index.size();
+    }
+    std::cout << "Replay log: " << records << " notifications in " << log->segments.size()
+              << " segments under " << dir << "/" << std::endl;
+    return log;
+}
+
+void replay_log_append(replay_log_t *log, uint64_t time_us,
+                       const confd_tag_value_t *vals, int nvals)
+{
+    replay_segment_t *seg = tail(log);
+    record_header_t rec;
+    size_t len = sizeof(rec);
+
+    memset(&rec, 0, sizeof(rec));
+    for (int i = 0; i < nvals; i++) {
+        long n = value_size(&vals[i].v, false);
+        if (n < 0) {
+            std::cout << "Replay log: type " << vals[i].v.type
+                      << " is not stored, notification not logged" << std::endl;
+            return;
+        }
+        len += 4 + 4 + n;
+        if (vals[i].v.type == C_LIST) {
+            rec.nlist += vals[i].v.val.list.size;
+        }
+    }
+    len = ALIGN8(len);
+
+    if (len > REPLAY_SEGMENT_BYTES - SEGMENT_HEADER_BYTES) {
+        std::cout << "Replay log: " << len << " byte notification not logged" << std::endl;
+        return;
+    }
+
+    if (seg == NULL || header(seg)->used + len > REPLAY_SEGMENT_BYTES ||
+        header(seg)->opened_us + (uint64_t) REPLAY_SEGMENT_AGE_S * 1000000 < time_us) {
+        if ((seg = new_segment(log, time_us)) == NULL) {
+            return;
+        }
+        expire_segments(log, time_us);
+    }
+
+    segment_header_t *h = header(seg);
+    unsigned char *p = seg->base + h->used;
+
+    rec.len = len;
+    rec.nvals = nvals;
+    rec.time_us = time_us;
+    p = put(p, &rec, sizeof(rec));
+    for (int i = 0; i < nvals; i++) {
+        p = put(p, &vals[i].tag.tag, 4);
+        p = put(p, &vals[i].tag.ns, 4);
+        p = put_value(p, &vals[i].v);
+    }
+
+    /* Kept sorted for seek() should the clock step back */
+    replay_index_t entry;
+    entry.time_us = std::max(time_us, last_time(seg));
+    entry.offset = h->used;
+    seg->index.push_back(entry);
+
+    /* Last, so a reader of the file never sees half a record */
+    h->used += len;
+}
+
+static void datetime_from_us(struct confd_datetime *dt, uint64_t time_us)
+{
+    time_t t = time_us / 1000000;
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    memset(dt, 0, sizeof(*dt));
+    dt->year = 1900 + tm.tm_year;
+    dt->month = tm.tm_mon + 1;
+    dt->day = tm.tm_mday;
+    dt->hour = tm.tm_hour;
+    dt->min = tm.tm_min;
+    dt->sec = tm.tm_sec;
+    dt->micro = time_us % 1000000;
+    dt->timezone = 0;
+    dt->timezone_minutes = 0;
+}
+
+static uint64_t datetime_to_us(const struct confd_datetime *dt)
+{
+    struct tm tm;
+    int64_t t;
+
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = dt->year - 1900;
+    tm.tm_mon = dt->month - 1;
+    tm.tm_mday = dt->day;
+    tm.tm_hour = dt->hour;
+    tm.tm_min = dt->min;
+    tm.tm_sec = dt->sec;
+    t = timegm(&tm);
+
+    /* A local time: UTC is that much earlier east of Greenwich */
+    if (dt->timezone != CONFD_TIMEZONE_UNDEF) {
+        int minutes = dt->timezone * 60 +
+                      (dt->timezone < 0 ? -dt->timezone_minutes : dt->timezone_minutes);
+        t -= (int64_t) minutes * 60;
+    }
+    return (t < 0) ? 0 : (uint64_t) t * 1000000 + dt->micro;
+}
+
+int replay_log_times(replay_log_t *log, struct confd_notification_ctx *nctx)
+{
+    struct confd_datetime created, aged;
+
+    datetime_from_us(&created, log->created_us);
+    datetime_from_us(&aged, log->aged_us);
+    return confd_notification_reply_log_times(nctx, &created,
+                                              (log->aged_us != 0) ? &aged : NULL);
+}
+
+static bool index_less(const replay_index_t& e, uint64_t time_us)
+{
+    return e.time_us < time_us;
+}
+
+/* The first record at or after 'time_us' */
+static replay_pos_t seek(replay_log_t *log, uint64_t time_us)
+{
+    replay_segment_t *last = tail(log);
+    replay_pos_t pos;
+
+    for (size_t i = 0; i < log->segments.size(); i++) {
+        replay_segment_t *seg = log->segments[i];
+
+        if (!seg->index.empty() && last_time(seg) >= time_us) {
+            pos.seq = seg->seq;
+            pos.record = std::lower_bound(seg->index.begin(), seg->index.end(),
+                                          time_us, index_less) - seg->index.begin();
+            return pos;
+        }
+    }
+
+    pos.seq = last->seq;
+    pos.record = last->index.size();
+    return pos;
+}
+
+int replay_log_request(replay_log_t *log, struct confd_notification_ctx *nctx,
+                       const struct confd_datetime *start,
+                       const struct confd_datetime *stop)
+{
+    replay_t r;
+    uint64_t one = 1;
+
+    r.nctx = nctx;
+    r.next = seek(log, datetime_to_us(start));
+    r.end.seq = tail(log)->seq;
+    r.end.record = tail(log)->index.size();
+    r.stop_us = (stop != NULL) ? datetime_to_us(stop) : 0;
+    r.sent = 0;
+
+    /* Sent from the reactor: ConfD expects the callback to return first */
+    log->replays.push_back(r);
+    if (write(log->wakefd, &one, sizeof(one)) < 0) {
+        log->replays.pop_back();
+        return CONFD_ERR;
+    }
+    return CONFD_OK;
+}
+
+/* The segment holding 'pos', moving on to the next one at its end */
+static replay_segment_t *locate(replay_log_t *log, replay_pos_t *pos)
+{
+    for (size_t i = 0; i < log->segments.size(); i++) {
+        replay_segment_t *seg = log->segments[i];
+
+        /* Past a segment deleted while replaying, or past the end of one */
+        if (seg->seq > pos->seq) {
+            pos->seq = seg->seq;
+            pos->record = 0;
+        }
+        if (seg->seq == pos->seq && pos->record < seg->index.size()) {
+            return seg;
+        }
+    }
+    return NULL;
+}
+
+static bool at_end(const replay_t *r)
+{
+    return r->next.seq > r->end.seq ||
+           (r->next.seq == r->end.seq && r->next.record >= r->end.record);
+}
+
+static void decode(replay_log_t *log, const unsigned char *p, const record_header_t *rec)
+{
+    confd_value_t *list;
+
+    tv_arena_reset(&log->decoded);
+    tv_arena_reserve(&log->decoded, rec->nvals);
+    log->lists.resize(rec->nlist + 1);
+    list = &log->lists[0];
+
+    for (uint32_t i = 0; i < rec->nvals; i++) {
+        confd_tag_value_t *tv = tv_arena_next(&log->decoded);
+        p = get(p, &tv->tag.tag, 4);
+        p = get(p, &tv->tag.ns, 4);
+        p = get_value(p, &tv->v, &list);
+    }
+}
+
+/* Sends up to REPLAY_BATCH notifications of 'r'; false once it is done */
+static bool replay_batch(replay_log_t *log, replay_t *r)
+{
+    for (int n = 0; n < REPLAY_BATCH; n++) {
+        replay_segment_t *seg;
+        record_header_t rec;
+        struct confd_datetime when;
+
+        if (at_end(r) || (seg = locate(log, &r->next)) == NULL || at_end(r)) {
+            return false;
+        }
+
+        const unsigned char *p = seg->base + seg->index[r->next.record].offset;
+        memcpy(&rec, p, sizeof(rec));
+        if (r->stop_us != 0 && rec.time_us > r->stop_us) {
+            return false;
+        }
+
+        decode(log, p + sizeof(rec), &rec);
+        datetime_from_us(&when, rec.time_us);
+        if (confd_notification_send(r->nctx, &when, log->decoded.vals,
+                                    log->decoded.nvals) != CONFD_OK) {
+            std::cout << "Replay failed after " << r->sent << " notifications: "
+                      << confd_lasterr() << std::endl;
+            confd_notification_replay_failed(r->nctx);
+            r->nctx = NULL;
+            return false;
+        }
+
+        r->sent++;
+        r->next.record++;
+    }
+    return true;
+}
+
+static void replay_ready(int fd, uint32_t events, void *opaque)
+{
+    replay_log_t *log = (replay_log_t *) opaque;
+    uint64_t count;
+
+    for (size_t i = 0; i < log->replays.size(); ) {
+        replay_t *r = &log->replays[i];
+
+        if (replay_batch(log, r)) {
+            i++;
+            continue;
+        }
+
+        if (r->nctx != NULL) {
+            std::cout << "Replay: " << r->sent << " notifications sent" << std::endl;
+            if (confd_notification_replay_complete(r->nctx) != CONFD_OK)
+                confd_fatal("Failed to complete the replay\n");
+        }
+        log->replays.erase(log->replays.begin() + i);
+    }
+
+    /* Stays readable, and this keeps being called, until all are done */
+    if (log->replays.empty() && read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        confd_fatal("Failed to read the replay eventfd\n");
+    }
+}
+
+void replay_log_attach(replay_log_t *log, reactor_t *reactor)
+{
+    if ((log->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ||
+        reactor_add_fd(reactor, log->wakefd, EPOLLIN, replay_ready, log) < 0) {
+        confd_fatal("Failed to watch the replay log\n");
+    }
+}
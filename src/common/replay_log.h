@@ -0,0 +1,123 @@
+/**
+ * replay_log.h
+ *
+ * NETCONF replay (RFC 5277) for CONFD_AGENT_STREAM. Every notification
+ * the agent sends is appended, encoded, to an append-only log of
+ * memory-mapped segment files, and the stream's get_log_times() and
+ * replay() callbacks are answered from it, so a subscriber that
+ * reconnects with a startTime gets what it missed.
+ *
+ * Each segment keeps an in-memory index of the time and offset of its
+ * records. A replay seeks to its startTime by finding the first of the
+ * (at most REPLAY_MAX_SEGMENTS) segments that reaches it and
+ * binary-searching that segment's index, instead of scanning the
+ * records. Segments are rotated when full or older than
+ * REPLAY_SEGMENT_AGE_S, and the oldest are deleted past
+ * REPLAY_MAX_SEGMENTS or REPLAY_MAX_AGE_S. The files survive a restart
+ * of the agent and are indexed again when it opens the log.
+ *
+ * Appending allocates only to open a segment: the index of a new one
+ * is reserved at the size the one before it reached, which a steady
+ * stream does not outgrow.
+ *
+ * A replay is sent from the reactor REPLAY_BATCH notifications at a
+ * time, between the other events, so a long backlog does not hold up
+ * the live stream.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+#include <confd_lib.h>
+#include <confd_dp.h>
+
+#include "tv_arena.h"
+#include "reactor.h"
+
+#define REPLAY_LOG_DIR "replay"
+
+#define REPLAY_SEGMENT_BYTES (8 << 20)
+#define REPLAY_SEGMENT_AGE_S 86400
+#define REPLAY_MAX_SEGMENTS 8           /* at most 64 MB on disk */
+#define REPLAY_MAX_AGE_S (7 * 86400)
+
+/* Notifications sent per replay and reactor wakeup */
+#define REPLAY_BATCH 256
+
+struct replay_index_t {
+    uint64_t time_us;
+    uint32_t offset;
+};
+
+typedef struct replay_index_t replay_index_t;
+
+struct replay_segment_t {
+    uint64_t seq;
+    std::string path;
+    int fd;
+    unsigned char *base;                /* REPLAY_SEGMENT_BYTES mapped */
+    std::vector<replay_index_t> index;  /* one entry per record, in order */
+};
+
+typedef struct replay_segment_t replay_segment_t;
+
+/* A position in the log: a segment and a record in its index */
+struct replay_pos_t {
+    uint64_t seq;
+    size_t record;
+};
+
+typedef struct replay_pos_t replay_pos_t;
+
+struct replay_t {
+    struct confd_notification_ctx *nctx;
+    replay_pos_t next;
+    replay_pos_t end;                   /* log end when requested; later ones are live */
+    uint64_t stop_us;                   /* 0 for no stopTime */
+    unsigned long sent;
+};
+
+typedef struct replay_t replay_t;
+
+struct replay_log_t {
+    std::string dir;
+    std::string stream;
+    std::vector<replay_segment_t *> segments;   /* oldest first */
+
+    uint64_t created_us;                /* when the log was started */
+    uint64_t aged_us;                   /* newest record deleted, 0 if none */
+
+    std::vector<replay_t> replays;
+    int wakefd;                         /* readable while a replay is in progress */
+
+    tv_arena_t decoded;                 /* a replayed notification */
+    std::vector<confd_value_t> lists;   /* leaf-list values of 'decoded' */
+};
+
+typedef struct replay_log_t replay_log_t;
+
+/*
+ * Opens, or creates, the log of 'stream' in 'dir'. Returns NULL if
+ * the directory cannot be used; the stream then goes without replay.
+ */
+replay_log_t *replay_log_open(const char *dir, const char *stream);
+
+/* 'time_us' is the eventTime sent with the notification */
+void replay_log_append(replay_log_t *log, uint64_t time_us,
+                       const confd_tag_value_t *vals, int nvals);
+
+/* The get_log_times() and replay() stream callbacks */
+int replay_log_times(replay_log_t *log, struct confd_notification_ctx *nctx);
+int replay_log_request(replay_log_t *log, struct confd_notification_ctx *nctx,
+                       const struct confd_datetime *start,
+                       const struct confd_datetime *stop);
+
+/* Sends the requested replays from 'reactor' */
+void replay_log_attach(replay_log_t *log, reactor_t *reactor);
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * sampler.cpp
+ *
+ * The /proc sampling layer shared by all collectors of an agent.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include "sampler.h"
+
+#define CPU_COUNT_DEFAULT 2
+
+uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int sampler_init(sampler_t *s, const char *root)
+{
+    s->cpu_count = proc_cpu_count();
+    if (s->cpu_count == 0) {
+        s->cpu_count = CPU_COUNT_DEFAULT;
+    }
+    std::cout << "The number of CPUs are: " << s->cpu_count << std::endl;
+
+    s->load_valid = false;
+    s->mem_valid = false;
+    s->cpu_current = 0;
+    s->cpu_valid = false;
+    s->cpu_time_ms = 0;
+    s->cpu_period_ms = 0;
+    s->processes_valid = false;
+    s->processes_time_ms = 0;
+    s->processes_generation = 0;
+
+    return proc_scanner_init(&s->scanner, root);
+}
+
+void sampler_free(sampler_t *s)
+{
+    proc_scanner_free(&s->scanner);
+    s->cpu_times[0].clear();
+    s->cpu_times[1].clear();
+    s->cpu_usage.clear();
+}
+
+void sampler_expire(sampler_t *s)
+{
+    s->load_valid = false;
+    s->mem_valid = false;
+    s->cpu_valid = false;
+    s->processes_valid = false;
+}
+
+const load_avg_t& sampler_load_avg(sampler_t *s)
+{
+    if (!s->load_valid) {
+        if (proc_read_loadavg(&s->load) < 0) {
+            std::cout << "Failed to read /proc/loadavg" << std::endl;
+            memset(&s->load, 0, sizeof(s->load));
+        }
+        s->load_valid = true;
+    }
+
+    return s->load;
+}
+
+const mem_info_t& sampler_meminfo(sampler_t *s)
+{
+    if (!s->mem_valid) {
+        if (proc_read_meminfo(&s->mem) < 0) {
+            std::cout << "Failed to read /proc/meminfo" << std::endl;
+            memset(&s->mem, 0, sizeof(s->mem));
+        }
+        s->mem_valid = true;
+    }
+
+    return s->mem;
+}
+
+static int read_cpu_times(std::vector<cpu_times_t>& times, unsigned int cpu_count)
+{
+    if (times.size() < cpu_count + 1) {
+        times.resize(cpu_count + 1);
+    }
+
+    int n = proc_read_cpu_times(&times[0], (int) times.size());
+    if (n > (int) times.size()) {
+        /* More cores online than at startup */
+        times.resize(n);
+        n = proc_read_cpu_times(&times[0], (int) times.size());
+    }
+    return n;
+}
+
+/*
+ * Percentages from counter deltas. Each line is a fixed-size block of
+ * PROC_CPU_FIELDS counters, so the inner loops have constant trip
+ * counts and no branches.
+ */
+static void compute_cpu_usage(const cpu_times_t *cur, const cpu_times_t *prev, int n,
+                              std::vector<cpu_usage_t>& usage)
+{
+    usage.resize(n);
+
+    for (int i = 0; i < n; i++) {
+        uint64_t delta[PROC_CPU_FIELDS];
+        uint64_t total = 0;
+
+        for (int f = 0; f < PROC_CPU_FIELDS; f++) {
+            uint64_t p = (prev != NULL) ? prev[i].ticks[f] : 0;
+            delta[f] = (cur[i].ticks[f] > p) ? cur[i].ticks[f] - p : 0;
+            total += delta[f];
+        }
+
+        float scale = (total > 0) ? 100.0f / (float) total : 0.0f;
+        float *pct = usage[i].pct;
+
+        usage[i].index = cur[i].index;
+        pct[CPU_USER] = delta[PROC_CPU_USER] * scale;
+        pct[CPU_KERNEL] = delta[PROC_CPU_SYSTEM] * scale;
+        pct[CPU_NICE] = delta[PROC_CPU_NICE] * scale;
+        pct[CPU_IDLE] = delta[PROC_CPU_IDLE] * scale;
+        pct[CPU_WAIT] = delta[PROC_CPU_IOWAIT] * scale;
+        pct[CPU_HARDWARE_INTERRUPT] = delta[PROC_CPU_IRQ] * scale;
+        pct[CPU_SOFTWARE_INTERRUPT] = delta[PROC_CPU_SOFTIRQ] * scale;
+        pct[CPU_TOTAL] = (total > 0) ? 100.0f - pct[CPU_IDLE] - pct[CPU_WAIT] : 0.0f;
+    }
+}
+
+static bool same_cpus(const std::vector<cpu_times_t>& a, const std::vector<cpu_times_t>& b, int n)
+{
+    if ((int) a.size() < n || (int) b.size() < n) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        if (a[i].index != b[i].index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::vector<cpu_usage_t>& sampler_cpu_usage(sampler_t *s)
+{
+    if (!s->cpu_valid) {
+        int prev = s->cpu_current;
+        int cur = prev ^ 1;
+        int n = read_cpu_times(s->cpu_times[cur], s->cpu_count);
+        uint64_t now = monotonic_ms();
+
+        if (n < 0) {
+            std::cout << "Failed to read /proc/stat" << std::endl;
+            s->cpu_usage.clear();
+        } else {
+            bool delta = s->cpu_time_ms != 0 && s->cpu_usage.size() == (size_t) n &&
+                         same_cpus(s->cpu_times[cur], s->cpu_times[prev], n);
+
+            compute_cpu_usage(&s->cpu_times[cur][0],
+                              delta ? &s->cpu_times[prev][0] : NULL, n, s->cpu_usage);
+            s->cpu_period_ms = (s->cpu_time_ms != 0) ? now - s->cpu_time_ms : 0;
+            s->cpu_time_ms = now;
+            s->cpu_current = cur;
+        }
+        s->cpu_valid = true;
+    }
+
+    return s->cpu_usage;
+}
+
+const proc_table_t& sampler_processes(sampler_t *s)
+{
+    if (!s->processes_valid) {
+        if (proc_scan_processes(&s->scanner) < 0) {
+            std::cout << "Failed to scan " << s->scanner.root << std::endl;
+        }
+        s->processes_valid = true;
+        s->processes_time_ms = monotonic_ms();
+        s->processes_generation++;
+    }
+
+    return s->scanner.table;
+}
+
+const proc_table_t& sampler_refresh_processes(sampler_t *s)
+{
+    if (proc_scan_refresh(&s->scanner) < 0) {
+        std::cout << "Failed to scan " << s->scanner.root << std::endl;
+    }
+    s->processes_valid = true;
+    s->processes_time_ms = monotonic_ms();
+    s->processes_generation++;
+
+    return s->scanner.table;
+}
+
+uint64_t sampler_processes_age_ms(sampler_t *s)
+{
+    if (!s->processes_valid) {
+        return (uint64_t) -1;
+    }
+    return monotonic_ms() - s->processes_time_ms;
+}
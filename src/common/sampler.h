@@ -0,0 +1,97 @@
+/**
+ * sampler.h
+ *
+ * The /proc sampling layer shared by all collectors of an agent. Each
+ * sample (load average, CPU usage, memory, process table) is taken at most
+ * once per scheduler tick, however many collectors consume it, and is
+ * kept until the next tick expires it.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "proc_reader.h"
+#include "proc_scan.h"
+
+/* CPU utilization in percent, as reported under /oc-sys:system/cpus */
+enum {
+    CPU_TOTAL,                  /* everything but idle and I/O wait */
+    CPU_USER,
+    CPU_KERNEL,
+    CPU_NICE,
+    CPU_IDLE,
+    CPU_WAIT,
+    CPU_HARDWARE_INTERRUPT,
+    CPU_SOFTWARE_INTERRUPT,
+    CPU_METRICS
+};
+
+struct cpu_usage_t {
+    int index;                  /* core number, -1 for all cores */
+    float pct[CPU_METRICS];
+};
+
+typedef struct cpu_usage_t cpu_usage_t;
+
+struct sampler_t {
+    proc_scanner_t scanner;
+    unsigned int cpu_count;
+
+    load_avg_t load;
+    bool load_valid;
+
+    mem_info_t mem;
+    bool mem_valid;
+
+    /* /proc/stat counters of the last two samples, the total line first */
+    std::vector<cpu_times_t> cpu_times[2];
+    int cpu_current;
+    std::vector<cpu_usage_t> cpu_usage;
+    bool cpu_valid;
+    uint64_t cpu_time_ms;
+    uint64_t cpu_period_ms;             /* time between the last two samples */
+
+    bool processes_valid;               /* scanner.table is up to date */
+    uint64_t processes_time_ms;
+    unsigned int processes_generation;  /* bumped on every rescan */
+};
+
+typedef struct sampler_t sampler_t;
+
+int sampler_init(sampler_t *s, const char *root);
+void sampler_free(sampler_t *s);
+
+/* Forget every sample; the next accessor reads /proc again */
+void sampler_expire(sampler_t *s);
+
+const load_avg_t& sampler_load_avg(sampler_t *s);
+
+const mem_info_t& sampler_meminfo(sampler_t *s);
+
+/*
+ * Utilization since the previous sample (since boot for the first
+ * one), the aggregate over all cores first.
+ */
+const std::vector<cpu_usage_t>& sampler_cpu_usage(sampler_t *s);
+
+/* The process table, rescanned once per tick; see proc_table.h */
+const proc_table_t& sampler_processes(sampler_t *s);
+
+/*
+ * Rescan the process table for an on-demand reader, between ticks.
+ * Nothing else is expired, and the CPU samples of the processes stay
+ * those of the tick (see proc_scan_refresh()), so the collectors that
+ * stream at an interval still measure over all of it.
+ */
+const proc_table_t& sampler_refresh_processes(sampler_t *s);
+
+/* Age of the current process table, for on-demand readers with a TTL */
+uint64_t sampler_processes_age_ms(sampler_t *s);
+
+uint64_t monotonic_ms(void);
+
+#endif
@@ -0,0 +1,270 @@
+/**
+ * scheduler.cpp
+ *
+ * Runs a set of collectors on one ConfD daemon context and one /proc
+ * sampling layer.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <iostream>
+
+#include "openconfig-procmon-ext.h"
+#include "scheduler.h"
+#include "threshold_policy.h"
+#include "psi.h"
+#include "history.h"
+
+void scheduler_init(scheduler_t *sched, confd_agent_t *agent, sampler_t *sampler,
+                    const adaptive_cfg_t *cfg)
+{
+    sched->agent = agent;
+    sched->sampler = sampler;
+    sched->collectors.clear();
+    memset(&sched->stats, 0, sizeof(sched->stats));
+
+    if (reactor_init(&sched->reactor) < 0)
+        confd_fatal("Failed to create the event loop\n");
+
+    adaptive_init(&sched->adaptive, cfg);
+}
+
+void scheduler_add(scheduler_t *sched, collector_t *c)
+{
+    c->due_ms = 0;
+    sched->collectors.push_back(c);
+}
+
+/* The scheduler that scheduler_cp serves; there is one per daemon */
+static const scheduler_t *served;
+
+/* /oc-proc-ext:scheduler */
+static int get_elem(struct confd_trans_ctx *tctx, confd_hkeypath_t *kp)
+{
+    const sched_stats_t *st = &served->stats;
+    confd_value_t v;
+
+    switch (CONFD_GET_XMLTAG(&kp->v[0][0])) {
+    case oc_proc_ext_ticks:
+        CONFD_SET_UINT64(&v, st->ticks);
+        break;
+    case oc_proc_ext_late_ticks:
+        CONFD_SET_UINT64(&v, st->late_ticks);
+        break;
+    case oc_proc_ext_skipped:
+        CONFD_SET_UINT64(&v, st->skipped);
+        break;
+    case oc_proc_ext_last_lateness:
+        CONFD_SET_UINT64(&v, st->last_lateness_ms);
+        break;
+    case oc_proc_ext_max_lateness:
+        CONFD_SET_UINT64(&v, st->max_lateness_ms);
+        break;
+    case oc_proc_ext_mean_lateness:
+        CONFD_SET_UINT64(&v, (st->ticks > 0) ? st->total_lateness_ms / st->ticks : 0);
+        break;
+    case oc_proc_ext_last_duration:
+        CONFD_SET_UINT64(&v, st->last_duration_ms);
+        break;
+    default:
+        return confd_data_reply_not_found(tctx);
+    }
+
+    return confd_data_reply_value(tctx, &v);
+}
+
+void scheduler_start(scheduler_t *sched)
+{
+    bool adaptive = false, cadence = false;
+    struct confd_data_cbs data;
+
+    for (size_t i = 0; i < sched->collectors.size(); i++) {
+        collector_t *c = sched->collectors[i];
+        if (c->start != NULL) {
+            c->start(c, sched);
+        }
+        std::cout << "Collector " << c->name << ": "
+                  << (c->on_demand ? "on demand" : c->adaptive ? "adaptive" :
+                      c->cadence != NULL ? "own adaptive interval" : "fixed interval")
+                  << std::endl;
+        if (c->adaptive && !c->on_demand) {
+            adaptive = true;
+        }
+        if (c->cadence != NULL) {
+            cadence = true;
+        }
+    }
+
+    memset(&data, 0, sizeof(data));
+    strcpy(data.callpoint, "scheduler_cp");
+    data.get_elem = get_elem;
+    served = sched;
+    confd_agent_register_data(sched->agent, &data, NULL, NULL);
+
+    history_start(sched);
+    confd_agent_register_done(sched->agent);
+    confd_agent_attach(sched->agent, &sched->reactor);
+
+    if (adaptive) {
+        threshold_policy_start(sched);
+    }
+    if (adaptive || cadence) {
+        psi_start(sched);
+    }
+}
+
+/* The first deadline after 'now' on the grid due + k * period */
+static uint64_t next_deadline(scheduler_t *sched, uint64_t due, uint64_t period, uint64_t now)
+{
+    if (period == 0) {
+        period = ADAPTIVE_MIN_MS;
+    }
+
+    due += period;
+    if (due <= now) {
+        uint64_t missed = (now - due) / period + 1;
+        due += missed * period;
+        sched->stats.skipped += missed;
+    }
+    return due;
+}
+
+static uint64_t earliest_deadline(scheduler_t *sched)
+{
+    uint64_t deadline = 0;
+
+    for (size_t i = 0; i < sched->collectors.size(); i++) {
+        collector_t *c = sched->collectors[i];
+        if (!c->on_demand && (deadline == 0 || c->due_ms < deadline)) {
+            deadline = c->due_ms;
+        }
+    }
+    return deadline;
+}
+
+static void record_lateness(scheduler_t *sched, uint64_t deadline, uint64_t start, uint64_t end)
+{
+    sched_stats_t *st = &sched->stats;
+    uint64_t lateness = (start > deadline) ? (start - deadline) : 0;
+
+    st->ticks++;
+    st->last_lateness_ms = lateness;
+    st->total_lateness_ms += lateness;
+    st->last_duration_ms = end - start;
+    if (lateness > st->max_lateness_ms) {
+        st->max_lateness_ms = lateness;
+    }
+    if (lateness > SCHED_LATE_MS) {
+        st->late_ticks++;
+    }
+}
+
+/* Feed the adaptive interval the demand metric it is configured for */
+static void update_interval(scheduler_t *sched)
+{
+    adaptive_interval_t *ai = &sched->adaptive;
+    float sample;
+    bool rising;
+
+    if (ai->cfg.metric == ADAPTIVE_CPU_BUSY) {
+        const std::vector<cpu_usage_t>& cpus = sampler_cpu_usage(sched->sampler);
+        sample = cpus.empty() ? 0.0f : cpus[0].pct[CPU_TOTAL] / 100;
+        rising = !ai->primed || sample > ai->demand;
+    } else {
+        const load_avg_t& load = sampler_load_avg(sched->sampler);
+        sample = load.load_avg_1min / sched->sampler->cpu_count;
+        rising = load.load_avg_1min > load.load_avg_5min;
+    }
+
+    adaptive_update(ai, sample, rising, monotonic_ms());
+}
+
+/*
+ * One tick: every collector that is due runs against the same set of
+ * samples, then the adaptive interval is recomputed once and the next
+ * deadline armed.
+ */
+static void run_due_collectors(int fd, uint32_t events, void *opaque)
+{
+    scheduler_t *sched = (scheduler_t *) opaque;
+    uint64_t deadline = earliest_deadline(sched);
+    uint64_t start = monotonic_ms();
+    bool adaptiveRan = false;
+
+    sampler_expire(sched->sampler);
+
+    for (size_t i = 0; i < sched->collectors.size(); i++) {
+        collector_t *c = sched->collectors[i];
+        if (c->on_demand || c->due_ms > start) {
+            continue;
+        }
+
+        OK(c->collect(c, sched));
+
+        if (c->adaptive) {
+            adaptiveRan = true;
+        }
+    }
+
+    if (adaptiveRan) {
+        update_interval(sched);
+    }
+
+    uint64_t end = monotonic_ms();
+    for (size_t i = 0; i < sched->collectors.size(); i++) {
+        collector_t *c = sched->collectors[i];
+        if (c->on_demand || c->due_ms > start) {
+            continue;
+        }
+
+        uint64_t period = (c->cadence != NULL) ? adaptive_period_ms(c->cadence, end) :
+                          c->adaptive ? adaptive_period_ms(&sched->adaptive, end) :
+                          (uint64_t) c->interval * 1000;
+        c->due_ms = next_deadline(sched, c->due_ms, period, end);
+    }
+
+    record_lateness(sched, deadline, start, end);
+
+    if (reactor_arm(&sched->reactor, earliest_deadline(sched)) < 0)
+        confd_fatal("Failed to arm the tick timer\n");
+}
+
+void scheduler_burst(scheduler_t *sched, adaptive_interval_t *ai, uint64_t duration_ms)
+{
+    uint64_t now = monotonic_ms();
+
+    adaptive_burst(ai, now + duration_ms);
+
+    for (size_t i = 0; i < sched->collectors.size(); i++) {
+        collector_t *c = sched->collectors[i];
+        bool affected = (c->cadence != NULL) ? c->cadence == ai :
+                        c->adaptive && ai == &sched->adaptive;
+
+        if (affected && !c->on_demand && c->due_ms > now) {
+            c->due_ms = now;
+        }
+    }
+
+    /* Not armed yet before scheduler_run() */
+    if (sched->reactor.deadline_ms != 0 &&
+        reactor_arm(&sched->reactor, earliest_deadline(sched)) < 0)
+        confd_fatal("Failed to arm the tick timer\n");
+}
+
+void scheduler_run(scheduler_t *sched)
+{
+    uint64_t now = monotonic_ms();
+
+    for (size_t i = 0; i < sched->collectors.size(); i++) {
+        sched->collectors[i]->due_ms = now;
+    }
+
+    reactor_set_timer(&sched->reactor, run_due_collectors, sched);
+    if (reactor_arm(&sched->reactor, earliest_deadline(sched)) < 0)
+        confd_fatal("Failed to arm the tick timer\n");
+
+    while (1) {
+        if (reactor_poll(&sched->reactor, -1) < 0)
+            confd_fatal("epoll_wait() failed\n");
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * scheduler.h
+ *
+ * Runs a set of collectors on one ConfD daemon context and one /proc
+ * sampling layer. A collector either streams at the adaptive stream
+ * interval (which follows the system load average, see
+ * adaptive_interval.h), at an adaptive interval of its own, at its own
+ * fixed interval, or only answers ConfD callbacks (on_demand).
+ *
+ * Ticks are scheduled on absolute deadlines: a collector that is due
+ * at T with interval I is next due at T + I, however long its
+ * collection took. A deadline that has already passed when the tick
+ * completes is skipped rather than run back to back.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "confd_agent.h"
+#include "sampler.h"
+#include "reactor.h"
+#include "adaptive_interval.h"
+
+#define INTERVAL 30
+
+/* A tick that starts this much after its deadline counts as late */
+#define SCHED_LATE_MS 100
+
+struct scheduler_t;
+
+struct collector_t {
+    const char *name;
+    bool adaptive;              /* runs at the adaptive stream interval */
+    unsigned int interval;      /* seconds, unless adaptive */
+    bool on_demand;             /* never ticked, e.g. a data provider */
+
+    /* Registration with ConfD, before confd_register_done(). May be NULL. */
+    void (*start)(struct collector_t *c, struct scheduler_t *sched);
+    int (*collect)(struct collector_t *c, struct scheduler_t *sched);
+
+    /*
+     * A cadence of the collector's own, following a metric of its own;
+     * collect() updates it and the scheduler runs the collector at its
+     * interval. NULL for the shared or the fixed interval.
+     */
+    adaptive_interval_t *cadence;
+
+    uint64_t due_ms;            /* owned by the scheduler */
+};
+
+typedef struct collector_t collector_t;
+
+/*
+ * Scheduling lateness: how long after its deadline each tick started,
+ * served as /oc-proc-ext:scheduler through the scheduler_cp callpoint
+ */
+struct sched_stats_t {
+    unsigned long ticks;
+    unsigned long late_ticks;       /* lateness > SCHED_LATE_MS */
+    unsigned long skipped;          /* deadlines missed entirely */
+    uint64_t last_lateness_ms;
+    uint64_t max_lateness_ms;
+    uint64_t total_lateness_ms;
+    uint64_t last_duration_ms;      /* time spent collecting */
+};
+
+typedef struct sched_stats_t sched_stats_t;
+
+struct scheduler_t {
+    confd_agent_t *agent;
+    sampler_t *sampler;
+    reactor_t reactor;
+    std::vector<collector_t *> collectors;
+    sched_stats_t stats;
+
+    adaptive_interval_t adaptive;
+};
+
+typedef struct scheduler_t scheduler_t;
+
+void scheduler_init(scheduler_t *sched, confd_agent_t *agent, sampler_t *sampler,
+                    const adaptive_cfg_t *cfg);
+void scheduler_add(scheduler_t *sched, collector_t *c);
+
+/*
+ * Runs every start() hook, registers the scheduler statistics and
+ * metric history callpoints, completes the ConfD registration and
+ * attaches the ConfD sockets to the reactor. With an adaptive collector the threshold policy is
+ * loaded from CDB and followed from then on, and pressure stall
+ * triggers are set up where the kernel has them.
+ */
+void scheduler_start(scheduler_t *sched);
+
+/*
+ * Run the collectors on 'ai' (the shared adaptive interval or a
+ * collector's cadence) now, then at its minimum interval for
+ * 'duration_ms'.
+ */
+void scheduler_burst(scheduler_t *sched, adaptive_interval_t *ai, uint64_t duration_ms);
+
+/* Never returns */
+void scheduler_run(scheduler_t *sched);
+
+#endif
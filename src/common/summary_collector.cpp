@@ -0,0 +1,243 @@
+/**
+ * summary_collector.cpp
+ *
+ * Windowed min/max/mean/p95 of the streamed metrics and the
+ * metric-summary notification.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+
+#include "openconfig-procmon-ext.h"
+#include "summary_collector.h"
+
+/* name, samples, min, max, mean, p95 and the list entry */
+#define METRIC_TAGS 8
+
+static std::vector<summary_metric_t *> metrics;
+static bool summarizing;
+static uint64_t window_start_ms;
+
+/* Encode buffer reused by every metric-summary notification */
+static tv_arena_t summary_arena;
+
+static void quantile_init(quantile_t *q, float p)
+{
+    q->p = p;
+    q->count = 0;
+}
+
+static void quantile_add(quantile_t *q, float x)
+{
+    int k;
+
+    if (q->count < 5) {
+        q->height[q->count++] = x;
+        if (q->count == 5) {
+            std::sort(q->height, q->height + 5);
+            for (int i = 0; i < 5; i++) {
+                q->pos[i] = i;
+            }
+            q->desired[0] = 0;
+            q->desired[1] = 2 * q->p;
+            q->desired[2] = 4 * q->p;
+            q->desired[3] = 2 + 2 * q->p;
+            q->desired[4] = 4;
+        }
+        return;
+    }
+    q->count++;
+
+    /* The cell x falls in, stretching the extremes if need be */
+    if (x < q->height[0]) {
+        q->height[0] = x;
+        k = 0;
+    } else if (x >= q->height[4]) {
+        q->height[4] = x;
+        k = 3;
+    } else {
+        for (k = 0; k < 3 && x >= q->height[k + 1]; k++)
+            ;
+    }
+
+    for (int i = k + 1; i < 5; i++) {
+        q->pos[i]++;
+    }
+    q->desired[1] += q->p / 2;
+    q->desired[2] += q->p;
+    q->desired[3] += (1 + q->p) / 2;
+    q->desired[4] += 1;
+
+    /* Move the middle markers that drifted a whole position off */
+    for (int i = 1; i <= 3; i++) {
+        float d = q->desired[i] - q->pos[i];
+
+        if ((d >= 1 && q->pos[i + 1] - q->pos[i] > 1) ||
+            (d <= -1 && q->pos[i - 1] - q->pos[i] < -1)) {
+            int s = (d > 0) ? 1 : -1;
+            float np = q->pos[i + 1] - q->pos[i - 1];
+            float h = q->height[i] +
+                      s / np * ((q->pos[i] - q->pos[i - 1] + s) *
+                                (q->height[i + 1] - q->height[i]) / (q->pos[i + 1] - q->pos[i]) +
+                                (q->pos[i + 1] - q->pos[i] - s) *
+                                (q->height[i] - q->height[i - 1]) / (q->pos[i] - q->pos[i - 1]));
+
+            /* Parabolic if that keeps the heights ordered, else linear */
+            if (q->height[i - 1] < h && h < q->height[i + 1]) {
+                q->height[i] = h;
+            } else {
+                q->height[i] += s * (q->height[i + s] - q->height[i]) / (q->pos[i + s] - q->pos[i]);
+            }
+            q->pos[i] += s;
+        }
+    }
+}
+
+static float quantile_get(const quantile_t *q)
+{
+    if (q->count > 5) {
+        return q->height[2];
+    }
+
+    /*
+     * Exact, by nearest rank, over the few samples seen; at five the
+     * markers are those samples, and the middle one is their median
+     */
+    float h[5];
+    std::copy(q->height, q->height + q->count, h);
+    std::sort(h, h + q->count);
+    int rank = (int) ceil(q->p * q->count);
+    return h[(rank > 0 ? rank : 1) - 1];
+}
+
+static void reset(summary_metric_t *m)
+{
+    m->count = 0;
+    m->min = 0;
+    m->max = 0;
+    m->sum = 0;
+    quantile_init(&m->p95, SUMMARY_QUANTILE);
+}
+
+summary_metric_t *summary_register(const char *name)
+{
+    summary_metric_t *m = new summary_metric_t;
+
+    m->name = name;
+    reset(m);
+    metrics.push_back(m);
+    return m;
+}
+
+void summary_add(summary_metric_t *m, float value)
+{
+    if (m->count == 0 || value < m->min) {
+        m->min = value;
+    }
+    if (m->count == 0 || value > m->max) {
+        m->max = value;
+    }
+    m->count++;
+    m->sum += value;
+    quantile_add(&m->p95, value);
+}
+
+bool summary_raw(const adaptive_interval_t *ai)
+{
+    return !summarizing || ai->band > 0 || ai->burst_until_ms > monotonic_ms();
+}
+
+static void set_decimal64(tv_arena_t *arena, uint32_t tag, float value)
+{
+    struct confd_decimal64 d;
+    d.value = (int64_t) floor(value * 100 + 0.5f);
+    d.fraction_digits = 2;
+
+    confd_tag_value_t *tv = tv_arena_next(arena);
+    CONFD_SET_TAG_DECIMAL64(tv, tag, d);
+}
+
+static void start_summary(collector_t *c, scheduler_t *sched)
+{
+    summarizing = true;
+    window_start_ms = monotonic_ms();
+
+    tv_arena_init(&summary_arena, "metric-summary", 0);
+    confd_agent_register_stream(sched->agent);
+
+    std::cout << "Summaries every " << c->interval << "s; metric notifications "
+              << "only above the lowest band" << std::endl;
+}
+
+static int send_notif_summary(collector_t *c, scheduler_t *sched)
+{
+    uint64_t now = monotonic_ms();
+    int sampled = 0;
+
+    /* The first tick runs at start-up, with nothing to summarize yet */
+    if (now - window_start_ms < (uint64_t) c->interval * 1000 / 2) {
+        return CONFD_OK;
+    }
+
+    tv_arena_reset(&summary_arena);
+    tv_arena_reserve(&summary_arena, 3 + METRIC_TAGS * (int) metrics.size());
+
+    confd_tag_value_t *tv = tv_arena_next(&summary_arena);
+    CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_metric_summary, oc_proc_ext__ns);
+    tv = tv_arena_next(&summary_arena);
+    CONFD_SET_TAG_UINT32(tv, oc_proc_ext_window, (uint32_t) ((now - window_start_ms + 500) / 1000));
+
+    for (size_t i = 0; i < metrics.size(); i++) {
+        summary_metric_t *m = metrics[i];
+
+        if (m->count == 0) {
+            continue;
+        }
+        sampled++;
+
+        tv = tv_arena_next(&summary_arena);
+        CONFD_SET_TAG_XMLBEGIN(tv, oc_proc_ext_metric, oc_proc_ext__ns);
+        tv = tv_arena_next(&summary_arena);
+        CONFD_SET_TAG_STR(tv, oc_proc_ext_name, m->name.c_str());
+        tv = tv_arena_next(&summary_arena);
+        CONFD_SET_TAG_UINT32(tv, oc_proc_ext_samples, m->count);
+        set_decimal64(&summary_arena, oc_proc_ext_min, m->min);
+        set_decimal64(&summary_arena, oc_proc_ext_max, m->max);
+        set_decimal64(&summary_arena, oc_proc_ext_mean, (float) (m->sum / m->count));
+        set_decimal64(&summary_arena, oc_proc_ext_p95, quantile_get(&m->p95));
+        tv = tv_arena_next(&summary_arena);
+        CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_metric, oc_proc_ext__ns);
+
+        std::cout << "Summary " << m->name << ": " << m->count << " samples, min "
+                  << m->min << ", max " << m->max << ", mean " << m->sum / m->count
+                  << ", p95 " << quantile_get(&m->p95) << std::endl;
+    }
+
+    tv = tv_arena_next(&summary_arena);
+    CONFD_SET_TAG_XMLEND(tv, oc_proc_ext_metric_summary, oc_proc_ext__ns);
+
+    if (sampled > 0) {
+        confd_agent_send_notification(sched->agent, &summary_arena);
+    }
+
+    for (size_t i = 0; i < metrics.size(); i++) {
+        reset(metrics[i]);
+    }
+    window_start_ms = now;
+
+    return CONFD_OK;
+}
+
+collector_t summary_collector = {
+    "summary",
+    false,                      /* adaptive */
+    SUMMARY_WINDOW,
+    false,                      /* on_demand */
+    start_summary,
+    send_notif_summary,
+    NULL,                       /* cadence */
+    0
+};
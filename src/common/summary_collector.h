@@ -0,0 +1,66 @@
+/**
+ * summary_collector.h
+ *
+ * Windowed aggregation of the streamed metrics. While it runs, every
+ * sample a collector takes is folded into the minimum, maximum, mean
+ * and 95th percentile of its metric over the current window, and the
+ * collectors only send their own notifications while their stream is
+ * above its lowest threshold band (or bursting). At the end of each
+ * window one metric-summary notification carries the statistics of
+ * every metric sampled, so a quiet system costs one notification per
+ * window instead of one per metric and interval. The collectors that
+ * hold back their notifications this way are load-avg, cpu-memory,
+ * memory and cgroup; the process streams are always sent.
+ *
+ * The percentile is estimated with the P-square algorithm (Jain and
+ * Chlamtac, 1985), so each metric takes the same few bytes whatever
+ * the window length or sampling rate.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef SUMMARY_COLLECTOR_H
+#define SUMMARY_COLLECTOR_H
+
+#include <string>
+
+#include "scheduler.h"
+
+#define SUMMARY_WINDOW 300      /* seconds */
+#define SUMMARY_QUANTILE 0.95f
+
+/* P-square estimate of one quantile: five markers */
+struct quantile_t {
+    float p;
+    unsigned int count;
+    float height[5];            /* the first five samples, until count == 5 */
+    int pos[5];
+    float desired[5];
+};
+
+typedef struct quantile_t quantile_t;
+
+struct summary_metric_t {
+    std::string name;           /* <notification>/<leaf> */
+    unsigned int count;
+    float min;
+    float max;
+    double sum;
+    quantile_t p95;
+};
+
+typedef struct summary_metric_t summary_metric_t;
+
+summary_metric_t *summary_register(const char *name);
+void summary_add(summary_metric_t *m, float value);
+
+/*
+ * Whether a collector on 'ai' sends its own notification this tick:
+ * always unless summaries are on, otherwise only above the lowest
+ * band of 'ai' or during a burst.
+ */
+bool summary_raw(const adaptive_interval_t *ai);
+
+/* Runs at the window length, its interval */
+extern collector_t summary_collector;
+
+#endif
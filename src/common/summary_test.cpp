@@ -0,0 +1,222 @@
+/**
+ * summary_test.cpp
+ *
+ * Feeds series of known distribution (uniform, ramps, constant, a
+ * skewed one, fewer than five samples) through summary_add() and
+ * decodes the metric-summary notification sent at the end of each
+ * window: the count, minimum, maximum and mean are exact, and the
+ * P-square estimate of the 95th percentile is close to the exact one,
+ * which it is up to five samples.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <unistd.h>
+
+#include "openconfig-procmon-ext.h"
+#include "summary_collector.h"
+#include "test_agent.h"
+#include "unit_test.h"
+
+/* A metric entry of a metric-summary notification */
+struct stats_t {
+    uint32_t samples;
+    double min;
+    double max;
+    double mean;
+    double p95;
+};
+
+typedef struct stats_t stats_t;
+
+static confd_agent_t agent;
+static scheduler_t sched;
+
+/* The collector's notes stay out of the test output */
+static std::ofstream devnull("/dev/null");
+
+/* The metrics of the last notification sent, by name */
+static bool decode(std::map<std::string, stats_t> *metrics)
+{
+    const tv_arena_t *a = test_agent_last;
+    stats_t *s = NULL;
+
+    metrics->clear();
+    if (a == NULL || a->nvals < 2 ||
+        CONFD_GET_TAG_TAG(&a->vals[0]) != oc_proc_ext_metric_summary) {
+        return false;
+    }
+
+    for (int i = 1; i < a->nvals - 1; i++) {
+        const confd_tag_value_t *tv = &a->vals[i];
+        const confd_value_t *v = CONFD_GET_TAG_VALUE(tv);
+
+        switch (CONFD_GET_TAG_TAG(tv)) {
+        case oc_proc_ext_name:
+            s = &(*metrics)[v->val.s];
+            break;
+        case oc_proc_ext_samples:
+            if (s != NULL) {
+                s->samples = v->val.u32;
+            }
+            break;
+        case oc_proc_ext_min:
+            if (s != NULL) {
+                s->min = v->val.d64.value / 100.0;
+            }
+            break;
+        case oc_proc_ext_max:
+            if (s != NULL) {
+                s->max = v->val.d64.value / 100.0;
+            }
+            break;
+        case oc_proc_ext_mean:
+            if (s != NULL) {
+                s->mean = v->val.d64.value / 100.0;
+            }
+            break;
+        case oc_proc_ext_p95:
+            if (s != NULL) {
+                s->p95 = v->val.d64.value / 100.0;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+/* Close the window: the notification sent for it, decoded */
+static std::map<std::string, stats_t> close_window(void)
+{
+    std::map<std::string, stats_t> metrics;
+    unsigned long sent = test_agent_sent;
+
+    /* A window shorter than half the interval is the start-up tick */
+    usleep(summary_collector.interval * 1000 * 600);
+    CHECK(summary_collector.collect(&summary_collector, &sched) == CONFD_OK);
+    CHECK(test_agent_sent == sent + 1);
+    CHECK(decode(&metrics));
+    return metrics;
+}
+
+/* The 95th percentile by nearest rank */
+static double exact_p95(std::vector<float> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t) ceil(SUMMARY_QUANTILE * values.size());
+    return values[(rank > 0 ? rank : 1) - 1];
+}
+
+/* The notification carries what 'values' add up to; p95 within 'tolerance' */
+static void check_stats(const std::map<std::string, stats_t>& metrics, const char *name,
+                        const std::vector<float>& values, double tolerance)
+{
+    std::map<std::string, stats_t>::const_iterator it = metrics.find(name);
+
+    CHECK(it != metrics.end());
+    if (it == metrics.end()) {
+        return;
+    }
+
+    const stats_t& s = it->second;
+    double sum = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        sum += values[i];
+    }
+
+    CHECK(s.samples == values.size());
+    CHECK(fabs(s.min - *std::min_element(values.begin(), values.end())) < 0.006);
+    CHECK(fabs(s.max - *std::max_element(values.begin(), values.end())) < 0.006);
+    CHECK(fabs(s.mean - sum / values.size()) < 0.006);
+    CHECK(fabs(s.p95 - exact_p95(values)) <= tolerance);
+    CHECK(s.min <= s.p95 && s.p95 <= s.max);
+}
+
+static void add(summary_metric_t *m, std::vector<float> *values, float value)
+{
+    summary_add(m, value);
+    values->push_back(value);
+}
+
+int main(void)
+{
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+
+    test_agent_init(&agent);
+    sched.agent = &agent;
+
+    /* A one-second window, so that the test takes a few */
+    summary_collector.interval = 1;
+    summary_collector.start(&summary_collector, &sched);
+
+    summary_metric_t *uniform = summary_register("test/uniform");
+    summary_metric_t *ramp = summary_register("test/ramp");
+    summary_metric_t *constant = summary_register("test/constant");
+    summary_metric_t *skewed = summary_register("test/skewed");
+    summary_metric_t *few = summary_register("test/few");
+    summary_metric_t *idle = summary_register("test/idle");
+    std::vector<float> u, r, c, s, f;
+
+    /* Uniform over [0, 100), 10000 samples in random order */
+    srand(1);
+    for (int i = 0; i < 10000; i++) {
+        add(uniform, &u, (float) (rand() % 10000) / 100.0f);
+    }
+    /* 1..1000 rising; the estimate lags a steady trend the most */
+    for (int i = 1; i <= 1000; i++) {
+        add(ramp, &r, (float) i);
+    }
+    for (int i = 0; i < 500; i++) {
+        add(constant, &c, 42.5f);
+    }
+    /*
+     * Log-normal, a long tail to the right. (Between two clusters of
+     * samples far apart P-square interpolates across the gap; smooth
+     * distributions like this one are what it is good at.)
+     */
+    for (int i = 0; i < 5000; i++) {
+        double u1 = (rand() % 10000 + 1) / 10001.0, u2 = (rand() % 10000) / 10000.0;
+        add(skewed, &s, (float) (10 * exp(sqrt(-2 * log(u1)) * cos(2 * M_PI * u2) / 2)));
+    }
+    /* Fewer than five: the exact nearest rank, the largest of three */
+    add(few, &f, 3.0f);
+    add(few, &f, 1.0f);
+    add(few, &f, 2.0f);
+
+    std::map<std::string, stats_t> metrics = close_window();
+    check_stats(metrics, "test/uniform", u, 1.0);
+    check_stats(metrics, "test/ramp", r, 10.0);
+    check_stats(metrics, "test/constant", c, 0.0);
+    check_stats(metrics, "test/skewed", s, exact_p95(s) * 0.05);
+    check_stats(metrics, "test/few", f, 0.0);
+    CHECK(metrics["test/few"].p95 == 3.0);
+    CHECK(metrics.find("test/idle") == metrics.end());
+
+    /* The next window starts over: 1..5 falling, the fifth sample sets up the markers */
+    std::vector<float> again;
+    for (int i = 5; i >= 1; i--) {
+        add(few, &again, (float) i);
+    }
+    summary_add(idle, 7.0f);
+    metrics = close_window();
+    CHECK(metrics.size() == 2);
+    check_stats(metrics, "test/few", again, 0.0);
+    CHECK(metrics["test/idle"].samples == 1 && metrics["test/idle"].p95 == 7.0);
+
+    /* Nothing sampled: nothing sent */
+    unsigned long sent = test_agent_sent;
+    usleep(600000);
+    CHECK(summary_collector.collect(&summary_collector, &sched) == CONFD_OK);
+    CHECK(test_agent_sent == sent);
+
+    std::cout.rdbuf(out);
+    return test_result("summary_test");
+}
@@ -0,0 +1,58 @@
+/**
+ * test_agent.cpp
+ *
+ * Stands in for confd_agent.cpp in the collector tests.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+
+#include "test_agent.h"
+
+unsigned long test_agent_sent = 0;
+const tv_arena_t *test_agent_last = NULL;
+
+void test_agent_init(confd_agent_t *agent)
+{
+    agent->name = "test";
+    agent->dctx = NULL;
+    agent->ctlsock = -1;
+    agent->workersock = -1;
+    agent->live_ctx = NULL;
+    agent->replay_log = NULL;
+    agent->trans_registered = false;
+}
+
+void confd_agent_register_stream(confd_agent_t *agent)
+{
+}
+
+void confd_agent_register_data(confd_agent_t *agent, struct confd_data_cbs *data,
+                               confd_agent_trans_hook_t hook, void *opaque)
+{
+}
+
+void confd_agent_send_notification(confd_agent_t *agent, tv_arena_t *arena)
+{
+    test_agent_sent++;
+    test_agent_last = arena;
+}
+
+void confd_agent_send_notification_at(confd_agent_t *agent, tv_arena_t *arena,
+                                      const struct timeval *when)
+{
+    confd_agent_send_notification(agent, arena);
+}
+
+/* tv_arena_reserve() reports a failed allocation through ConfD */
+void confd_fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
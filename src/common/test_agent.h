@@ -0,0 +1,23 @@
+/**
+ * test_agent.h
+ *
+ * Stands in for confd_agent.cpp in the collector tests. There is no
+ * ConfD to talk to: registrations do nothing, and a notification is
+ * not sent but kept, as the collector's own arena, for the test to
+ * decode until the collector encodes the next one.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef TEST_AGENT_H
+#define TEST_AGENT_H
+
+#include "confd_agent.h"
+
+/* The notifications "sent" so far, and the last one (NULL before) */
+extern unsigned long test_agent_sent;
+extern const tv_arena_t *test_agent_last;
+
+/* An agent to hand to the collectors; nothing of it is used */
+void test_agent_init(confd_agent_t *agent);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * threshold_policy.cpp
+ *
+ * CDB subscriber for the adaptive interval threshold policy.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <iostream>
+
+#include "openconfig-procmon-ext.h"
+#include "threshold_policy.h"
+
+static int cdb_sock = -1;
+static int sub_sock = -1;
+static int sub_point;
+
+/* What the agent was started with, before any configured policy */
+static adaptive_cfg_t startup_cfg;
+
+static float get_decimal64(int sock, const char *path, int i)
+{
+    struct confd_decimal64 d;
+    double v;
+
+    OK(cdb_get_decimal64(sock, &d, path, i));
+    v = (double) d.value;
+    for (int f = 0; f < d.fraction_digits; f++) {
+        v /= 10;
+    }
+    return (float) v;
+}
+
+/* Relative to the current metric entry */
+static void load_bands(int sock, adaptive_cfg_t *cfg)
+{
+    int n = cdb_num_instances(sock, "band");
+
+    if (n <= 0) {
+        return;
+    }
+    if (n > ADAPTIVE_MAX_BANDS) {
+        std::cout << "Threshold policy: only the first " << ADAPTIVE_MAX_BANDS
+                  << " of " << n << " bands are used" << std::endl;
+        n = ADAPTIVE_MAX_BANDS;
+    }
+
+    cfg->nbands = n;
+    for (int i = 0; i < n; i++) {
+        adaptive_band_t *b = &cfg->bands[i];
+
+        OK(cdb_get_str(sock, b->name, sizeof(b->name), "band[%d]/name", i));
+        b->enter = get_decimal64(sock, "band[%d]/lower-threshold", i);
+        b->factor = get_decimal64(sock, "band[%d]/factor", i);
+        b->easing_factor = get_decimal64(sock, "band[%d]/easing-factor", i);
+    }
+}
+
+static void load_policy(int sock, adaptive_cfg_t *cfg)
+{
+    *cfg = startup_cfg;
+
+    OK(cdb_start_session(sock, CDB_RUNNING));
+    OK(cdb_set_namespace(sock, oc_proc_ext__ns));
+
+    /* Not set: the metric of the command line (-u) */
+    if (cdb_exists(sock, "/threshold-policy/active-metric") == 1) {
+        int32_t metric;
+        OK(cdb_get_enum_value(sock, &metric, "/threshold-policy/active-metric"));
+        cfg->metric = (metric == oc_proc_ext_cpu_busy) ? ADAPTIVE_CPU_BUSY : ADAPTIVE_LOAD_PER_CPU;
+    }
+
+    const char *name = (cfg->metric == ADAPTIVE_CPU_BUSY) ? "cpu-busy" : "load-per-cpu";
+    if (cdb_exists(sock, "/threshold-policy/metric{%s}", name) == 1) {
+        OK(cdb_cd(sock, "/threshold-policy/metric{%s}", name));
+
+        if (cdb_exists(sock, "base-interval") == 1) {
+            OK(cdb_get_u_int32(sock, &cfg->base_ms, "base-interval"));
+        }
+        if (cdb_exists(sock, "min-interval") == 1) {
+            OK(cdb_get_u_int32(sock, &cfg->min_ms, "min-interval"));
+        }
+        if (cdb_exists(sock, "max-interval") == 1) {
+            OK(cdb_get_u_int32(sock, &cfg->max_ms, "max-interval"));
+        }
+        if (cdb_exists(sock, "smoothing") == 1) {
+            cfg->alpha = get_decimal64(sock, "smoothing", 0);
+        }
+        if (cdb_exists(sock, "hysteresis") == 1) {
+            cfg->hysteresis = get_decimal64(sock, "hysteresis", 0);
+        }
+        load_bands(sock, cfg);
+    }
+
+    OK(cdb_end_session(sock));
+}
+
+static void apply_policy(scheduler_t *sched)
+{
+    adaptive_cfg_t cfg;
+
+    load_policy(cdb_sock, &cfg);
+    adaptive_reconfigure(&sched->adaptive, &cfg);
+}
+
+static void policy_changed(int fd, uint32_t events, void *opaque)
+{
+    scheduler_t *sched = (scheduler_t *) opaque;
+    int points[1];
+    int reslen;
+
+    if (cdb_read_subscription_socket(fd, points, &reslen) != CONFD_OK)
+        confd_fatal("Failed to read the threshold-policy subscription\n");
+
+    if (reslen > 0) {
+        std::cout << "Threshold policy changed" << std::endl;
+        apply_policy(sched);
+    }
+
+    OK(cdb_sync_subscription_socket(fd, CDB_DONE_PRIORITY));
+}
+
+void threshold_policy_start(scheduler_t *sched)
+{
+    startup_cfg = sched->adaptive.cfg;
+
+    cdb_sock = confd_agent_cdb_connect(sched->agent, CDB_DATA_SOCKET,
+                                       "threshold_policy");
+    sub_sock = confd_agent_cdb_connect(sched->agent, CDB_SUBSCRIPTION_SOCKET,
+                                       "threshold_policy_subscriber");
+
+    OK(cdb_subscribe(sub_sock, THRESHOLD_POLICY_PRIO, oc_proc_ext__ns, &sub_point,
+                     "/threshold-policy"));
+    OK(cdb_subscribe_done(sub_sock));
+
+    /* Subscribed first, so no commit can slip in between */
+    apply_policy(sched);
+
+    if (reactor_add_fd(&sched->reactor, sub_sock, EPOLLIN, policy_changed, sched) < 0)
+        confd_fatal("Failed to watch the threshold-policy subscription\n");
+}
@@ -0,0 +1,26 @@
+/**
+ * threshold_policy.h
+ *
+ * Loads the adaptive interval configuration from
+ * /oc-proc-ext:threshold-policy in the running datastore and follows
+ * it through a CDB subscription, so a commit takes effect on the next
+ * tick without restarting the agent. Leaves that are not configured
+ * keep the values the agent was started with.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef THRESHOLD_POLICY_H
+#define THRESHOLD_POLICY_H
+
+#include "scheduler.h"
+
+/* Subscription priority among the other CDB subscribers */
+#define THRESHOLD_POLICY_PRIO 100
+
+/*
+ * Applies the configured policy on top of the scheduler's current
+ * adaptive configuration and subscribes to changes on its reactor.
+ */
+void threshold_policy_start(scheduler_t *sched);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * tv_arena.cpp
+ *
+ * Reusable encode buffer for notifications.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstdlib>
+#include <iostream>
+
+#include "tv_arena.h"
+
+void tv_arena_init(tv_arena_t *arena, const char *name, int cap)
+{
+    arena->name = name;
+    arena->vals = NULL;
+    arena->nvals = 0;
+    arena->cap = 0;
+
+    tv_arena_reserve(arena, (cap > 0) ? cap : TV_ARENA_INITIAL);
+}
+
+void tv_arena_free(tv_arena_t *arena)
+{
+    free(arena->vals);
+    arena->vals = NULL;
+    arena->nvals = 0;
+    arena->cap = 0;
+}
+
+void tv_arena_reserve(tv_arena_t *arena, int count)
+{
+    if (arena->nvals + count <= arena->cap) {
+        return;
+    }
+
+    int cap = (arena->cap > 0) ? arena->cap : TV_ARENA_INITIAL;
+    while (cap < arena->nvals + count) {
+        cap *= 2;
+    }
+
+    confd_tag_value_t *vals =
+        (confd_tag_value_t *) realloc(arena->vals, cap * sizeof(confd_tag_value_t));
+    if (vals == NULL) {
+        confd_fatal("Failed to grow the %s encode arena to %d values\n", arena->name, cap);
+    }
+
+    if (arena->cap > 0) {
+        std::cout << "Encode arena " << arena->name << " grew to "
+                  << cap << " values" << std::endl;
+    }
+
+    arena->vals = vals;
+    arena->cap = cap;
+}
@@ -0,0 +1,54 @@
+/**
+ * tv_arena.h
+ *
+ * Reusable encode buffer for notifications. Tag values are built in
+ * place and the array is handed to confd_notification_send() as is.
+ * The arena grows to the largest notification seen and is then reused,
+ * so a stream does not allocate once it has reached its high-water mark.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef TV_ARENA_H
+#define TV_ARENA_H
+
+#include <confd_lib.h>
+
+#define TV_ARENA_INITIAL 64
+
+struct tv_arena_t {
+    const char *name;           /* for diagnostics only */
+    confd_tag_value_t *vals;
+    int nvals;
+    int cap;
+};
+
+typedef struct tv_arena_t tv_arena_t;
+
+void tv_arena_init(tv_arena_t *arena, const char *name, int cap);
+void tv_arena_free(tv_arena_t *arena);
+
+/* Start a new notification, keeping the storage */
+static inline void tv_arena_reset(tv_arena_t *arena)
+{
+    arena->nvals = 0;
+}
+
+/* Make room for 'count' more values in one step */
+void tv_arena_reserve(tv_arena_t *arena, int count);
+
+/*
+ * Returns the next free slot. The CONFD_SET_TAG_* macros evaluate their
+ * first argument more than once, so keep the result in a variable:
+ *
+ *     confd_tag_value_t *pid = tv_arena_next(&arena);
+ *     CONFD_SET_TAG_UINT64(pid, oc_proc_ext_pid, p.pid);
+ */
+static inline confd_tag_value_t *tv_arena_next(tv_arena_t *arena)
+{
+    if (arena->nvals == arena->cap) {
+        tv_arena_reserve(arena, 1);
+    }
+    return &arena->vals[arena->nvals++];
+}
+
+#endif
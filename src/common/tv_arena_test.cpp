@@ -0,0 +1,245 @@
+/**
+ * tv_arena_test.cpp
+ *
+ * Checks that the process-stats collector, once warm, encodes and
+ * sends a notification into its tv_arena_t without allocating.
+ * malloc() and operator new are replaced with versions that count the
+ * calls, and the collector runs over a synthetic /proc (see
+ * proc_fixture.h) in each of its modes: a few ticks to warm up, then
+ * many with the counters moving, and the count taken around collect()
+ * must not move. The scan itself is taken before the count, as walking
+ * /proc allocates in opendir().
+ *
+ * With processes coming and going, a new process costs a node in the
+ * delta mode and I/O maps and nothing else, as long as its name was
+ * seen before (see process_stats_collector.h for the rest).
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <map>
+
+#include "process_stats_collector.h"
+#include "proc_fixture.h"
+#include "test_agent.h"
+#include "unit_test.h"
+
+#define PROCESSES 500
+#define TICKS 200
+#define WARM_TICKS 3
+#define CHURN 10
+
+/* The exception specifications of the replaced operators */
+#if __cplusplus >= 201103L
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING noexcept
+#else
+#define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define THROWS_NOTHING throw()
+#endif
+
+extern "C" {
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long allocations = 0;
+
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+}
+
+void *operator new(size_t size) THROWS_BAD_ALLOC
+{
+    allocations++;
+    void *p = __libc_malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) THROWS_BAD_ALLOC
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) THROWS_NOTHING
+{
+    __libc_free(p);
+}
+
+void operator delete[](void *p) THROWS_NOTHING
+{
+    __libc_free(p);
+}
+
+static const char *names[] = { "telemetryd", "confd", "sshd", "systemd-journald" };
+
+static std::string root;
+static std::map<uint64_t, fixture_proc_t> live;
+static uint64_t next_pid = 1000;
+
+static confd_agent_t agent;
+static sampler_t sampler;
+static scheduler_t sched;
+
+/* The collector's notes stay out of the test output */
+static std::ofstream devnull("/dev/null");
+
+/* Of the given name, or of each of the names in turn */
+static void add_processes(int count, const char *name = NULL)
+{
+    for (int i = 0; i < count; i++, next_pid++) {
+        fixture_proc_t p;
+        fixture_proc_init(&p, (name != NULL) ? name : names[next_pid % 4], next_pid * 100);
+        p.utime = next_pid;
+        fixture_write_process(root, next_pid, p);
+        live[next_pid] = p;
+    }
+}
+
+/* Move the counters of some of the processes, differently every tick */
+static void move_counters(int t)
+{
+    std::map<uint64_t, fixture_proc_t>::iterator it;
+    int i = 0;
+
+    for (it = live.begin(); it != live.end(); ++it, i++) {
+        if ((i + t) % 7 == 0) {
+            fixture_proc_t& p = it->second;
+            p.size_pages += 1000;
+            p.read_bytes += 4096 * (i % 13);
+            p.wait_ns += 1000000;
+            p.voluntary_switches += i % 5;
+            fixture_write_process(root, it->first, p);
+        }
+    }
+}
+
+/* A tick; the allocations of collect(), after the scan */
+static unsigned long tick(void)
+{
+    sampler_expire(&sampler);
+    sampler_processes(&sampler);
+
+    unsigned long before = allocations;
+    process_stats_collector.collect(&process_stats_collector, &sched);
+    return allocations - before;
+}
+
+/* Warm up, then count over TICKS ticks */
+static unsigned long steady(void)
+{
+    unsigned long count = 0;
+
+    for (int t = 0; t < WARM_TICKS; t++) {
+        move_counters(t);
+        tick();
+    }
+    for (int t = 0; t < TICKS; t++) {
+        move_counters(t);
+        count += tick();
+    }
+    return count;
+}
+
+/* Replace CHURN processes with new ones, of a name that is streamed */
+static unsigned long churn(void)
+{
+    for (int i = 0; i < CHURN; i++) {
+        fixture_remove_process(root, live.begin()->first);
+        live.erase(live.begin());
+    }
+    add_processes(CHURN, "telemetryd");
+    return tick();
+}
+
+int main(void)
+{
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+
+    root = fixture_make("tv_arena_test");
+    CHECK(!root.empty());
+    if (root.empty()) {
+        return test_result("tv_arena_test");
+    }
+    add_processes(PROCESSES);
+
+    test_agent_init(&agent);
+    CHECK(sampler_init(&sampler, root.c_str()) == 0);
+    sched.agent = &agent;
+    sched.sampler = &sampler;
+    process_stats_collector.start(&process_stats_collector, &sched);
+
+    /* Full snapshots of every process: begin/end and ten leaves each */
+    unsigned long full = steady();
+    CHECK(full == 0);
+    CHECK(test_agent_last != NULL && test_agent_last->nvals == 2 + PROCESSES * 12);
+
+    /* Delta mode, with changes and syncs */
+    process_stats_opts.delta_mode = true;
+    unsigned long delta = steady();
+    CHECK(delta == 0);
+
+    /* The I/O and scheduling counters, ranked on, in both modes */
+    process_stats_opts.io_sched = true;
+    sampler.scanner.io_sched = true;
+    process_stats_opts.rank_by = PROCESS_RANK_IO;
+    process_stats_opts.top_k = 50;
+    CHECK(process_stats_include("s.*|telemetryd"));
+    CHECK(process_stats_exclude("sshd"));
+    unsigned long io = steady();
+    CHECK(io == 0);
+    process_stats_opts.delta_mode = false;
+    unsigned long ioFull = steady();
+    CHECK(ioFull == 0);
+
+    /* Processes come and go: two map nodes per new process */
+    process_stats_opts.delta_mode = true;
+    process_stats_opts.top_k = 0;
+    churn();
+    unsigned long churned = churn();
+    CHECK(churned == 2 * CHURN);
+    CHECK(steady() == 0);
+
+    /* The arena grows past its high-water mark, then is steady again */
+    process_stats_opts.delta_mode = false;
+    add_processes(PROCESSES);
+    tick();
+    CHECK(tick() == 0);
+
+    sampler_free(&sampler);
+    fixture_remove(root);
+
+    std::cout.rdbuf(out);
+    std::cerr << "Allocations over " << TICKS << " steady ticks: " << full << " full, "
+              << delta << " delta, " << io << " I/O delta, " << ioFull << " I/O full; "
+              << churned << " for " << CHURN << " new processes" << std::endl;
+    return test_result("tv_arena_test");
+}
@@ -0,0 +1,35 @@
+/**
+ * unit_test.h
+ *
+ * Checks for the tests built by the Makefile in this directory. A
+ * failed check is reported with its line and counted; test_result()
+ * gives the exit status of the test.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef UNIT_TEST_H
+#define UNIT_TEST_H
+
+#include <iostream>
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        test_checks++;                                                      \
+        if (!(cond)) {                                                      \
+            test_failures++;                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: "  \
+                      << #cond << std::endl;                                \
+        }                                                                   \
+    } while (0)
+
+static int test_result(const char *name)
+{
+    std::cerr << name << ": " << test_checks - test_failures << "/"
+              << test_checks << " checks passed" << std::endl;
+    return (test_failures == 0) ? 0 : 1;
+}
+
+#endif
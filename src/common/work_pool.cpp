@@ -0,0 +1,225 @@
+/**
+ * work_pool.cpp
+ *
+ * Worker threads for batches of independent work items.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+#include "proc_reader.h"
+#include "work_pool.h"
+
+#define SYS_CPU_ROOT "/sys/devices/system/cpu"
+
+/* Run the items of every range, starting with the worker's own */
+static void work(work_pool_t *wp, unsigned int worker)
+{
+    for (unsigned int k = 0; k < wp->size; k++) {
+        work_range_t& r = wp->ranges[(worker + k) % wp->size];
+
+        for (;;) {
+            size_t item = __sync_fetch_and_add(&r.next, 1);
+            if (item >= r.end) {
+                break;
+            }
+            wp->fn(worker, item, wp->opaque);
+        }
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    work_thread_t *t = (work_thread_t *) arg;
+    work_pool_t *wp = t->pool;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&wp->lock);
+    for (;;) {
+        while (wp->batch == seen && !wp->stopping) {
+            pthread_cond_wait(&wp->start, &wp->lock);
+        }
+        if (wp->stopping) {
+            break;
+        }
+        seen = wp->batch;
+        pthread_mutex_unlock(&wp->lock);
+
+        work(wp, t->worker);
+
+        pthread_mutex_lock(&wp->lock);
+        if (--wp->busy == 0) {
+            pthread_cond_signal(&wp->done);
+        }
+    }
+    pthread_mutex_unlock(&wp->lock);
+
+    return NULL;
+}
+
+int work_pool_init(work_pool_t *wp, unsigned int workers, const cpu_set_t *cpus)
+{
+    pthread_attr_t attr;
+    sigset_t all, saved;
+    int err = 0;
+
+    wp->size = 1;
+    wp->batch = 0;
+    wp->busy = 0;
+    wp->stopping = false;
+    wp->fn = NULL;
+    wp->opaque = NULL;
+    pthread_mutex_init(&wp->lock, NULL);
+    pthread_cond_init(&wp->start, NULL);
+    pthread_cond_init(&wp->done, NULL);
+
+    if (workers <= 1) {
+        wp->ranges.resize(1);
+        return 0;
+    }
+
+    /* Not moved once the threads hold pointers into them */
+    wp->threads.resize(workers - 1);
+    wp->ranges.resize(workers);
+
+    pthread_attr_init(&attr);
+    if (cpus != NULL) {
+        pthread_attr_setaffinity_np(&attr, sizeof(*cpus), cpus);
+    }
+
+    /* Signals are for the event loop; the threads inherit this mask */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+
+    for (unsigned int i = 0; i < workers - 1; i++) {
+        work_thread_t& t = wp->threads[i];
+
+        t.pool = wp;
+        t.worker = i + 1;
+        if ((err = pthread_create(&t.thread, &attr, worker_main, &t)) != 0) {
+            wp->threads.resize(i);
+            break;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        work_pool_free(wp);
+        work_pool_init(wp, 1, NULL);
+        errno = err;
+        return -1;
+    }
+
+    wp->size = workers;
+    return 0;
+}
+
+void work_pool_free(work_pool_t *wp)
+{
+    pthread_mutex_lock(&wp->lock);
+    wp->stopping = true;
+    pthread_cond_broadcast(&wp->start);
+    pthread_mutex_unlock(&wp->lock);
+
+    for (size_t i = 0; i < wp->threads.size(); i++) {
+        pthread_join(wp->threads[i].thread, NULL);
+    }
+    wp->threads.clear();
+    wp->ranges.clear();
+    wp->size = 1;
+
+    pthread_cond_destroy(&wp->done);
+    pthread_cond_destroy(&wp->start);
+    pthread_mutex_destroy(&wp->lock);
+}
+
+void work_pool_run(work_pool_t *wp, size_t items, work_fn_t fn, void *opaque)
+{
+    unsigned int size = wp->size;
+
+    wp->fn = fn;
+    wp->opaque = opaque;
+
+    /* A batch smaller than the pool is not worth waking it for */
+    if (size == 1 || items < size) {
+        for (size_t item = 0; item < items; item++) {
+            fn(0, item, opaque);
+        }
+        return;
+    }
+
+    for (unsigned int w = 0; w < size; w++) {
+        wp->ranges[w].next = items * w / size;
+        wp->ranges[w].end = items * (w + 1) / size;
+    }
+
+    pthread_mutex_lock(&wp->lock);
+    wp->batch++;
+    wp->busy = size - 1;
+    pthread_cond_broadcast(&wp->start);
+    pthread_mutex_unlock(&wp->lock);
+
+    work(wp, 0);
+
+    /* Also makes what the threads wrote visible to the caller */
+    pthread_mutex_lock(&wp->lock);
+    while (wp->busy > 0) {
+        pthread_cond_wait(&wp->done, &wp->lock);
+    }
+    pthread_mutex_unlock(&wp->lock);
+}
+
+/* Remove the CPUs of a cpulist ("0-3,8") file from 'cpus' */
+static void remove_cpu_list(cpu_set_t *cpus, proc_file_t *file, const char *path)
+{
+    if (proc_file_read_path(file, path) <= 0) {
+        return;                 /* not there: nothing isolated */
+    }
+
+    const char *p = file->buf;
+    const char *end = p + file->len;
+    while (p < end) {
+        uint64_t first, last;
+
+        if ((p = proc_parse_u64(p, end, &first)) == NULL) {
+            break;
+        }
+        last = first;
+        if (p < end && *p == '-' && (p = proc_parse_u64(p + 1, end, &last)) == NULL) {
+            break;
+        }
+        for (uint64_t cpu = first; cpu <= last && cpu < (uint64_t) CPU_SETSIZE; cpu++) {
+            CPU_CLR(cpu, cpus);
+        }
+        if (p < end && *p == ',') {
+            p++;
+        } else {
+            break;
+        }
+    }
+}
+
+int work_pool_housekeeping_cpus(cpu_set_t *cpus)
+{
+    cpu_set_t allowed;
+    proc_file_t file;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        return -1;
+    }
+
+    *cpus = allowed;
+    proc_file_init(&file);
+    remove_cpu_list(cpus, &file, SYS_CPU_ROOT "/isolated");
+    remove_cpu_list(cpus, &file, SYS_CPU_ROOT "/nohz_full");
+    proc_file_free(&file);
+
+    if (CPU_COUNT(cpus) == 0) {
+        *cpus = allowed;
+    }
+    return CPU_COUNT(cpus);
+}
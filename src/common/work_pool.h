@@ -0,0 +1,85 @@
+/**
+ * work_pool.h
+ *
+ * A small pool of worker threads that run a batch of independent work
+ * items and return once all of them are done. The calling thread takes
+ * part as worker 0, so a pool of one worker starts no thread at all.
+ *
+ * The items of a batch are split into one contiguous range per worker.
+ * A worker runs its own range first, in order, then takes what is left
+ * of the others' (work stealing); items are claimed one at a time with
+ * an atomic increment, so no lock is held while working.
+ *
+ * The threads are pinned to the housekeeping CPUs: those the process
+ * may run on, less the ones isolated from the scheduler (isolcpus=) or
+ * running tickless (nohz_full=), which are normally left to the data
+ * plane.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+/* Called for each item, on the thread of 'worker' (0: the caller) */
+typedef void (*work_fn_t)(unsigned int worker, size_t item, void *opaque);
+
+struct work_range_t {
+    volatile size_t next;       /* claimed with __sync_fetch_and_add */
+    size_t end;
+    char pad[64 - 2 * sizeof(size_t)];  /* a cache line per worker */
+};
+
+typedef struct work_range_t work_range_t;
+
+struct work_pool_t;
+
+struct work_thread_t {
+    struct work_pool_t *pool;
+    unsigned int worker;
+    pthread_t thread;
+};
+
+typedef struct work_thread_t work_thread_t;
+
+struct work_pool_t {
+    unsigned int size;          /* workers, the caller included */
+    std::vector<work_thread_t> threads;
+    std::vector<work_range_t> ranges;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;       /* a batch is ready, or stopping */
+    pthread_cond_t done;        /* the last worker finished the batch */
+    unsigned int batch;         /* bumped for every batch */
+    unsigned int busy;          /* threads still working on the batch */
+    bool stopping;
+
+    work_fn_t fn;
+    void *opaque;
+};
+
+typedef struct work_pool_t work_pool_t;
+
+/*
+ * Start 'workers' - 1 threads, pinned to 'cpus' unless NULL. Returns
+ * 0, or -1 with errno set, leaving a pool of one worker.
+ */
+int work_pool_init(work_pool_t *wp, unsigned int workers, const cpu_set_t *cpus);
+void work_pool_free(work_pool_t *wp);
+
+/* Run fn for items 0 to items - 1 and wait for all of them */
+void work_pool_run(work_pool_t *wp, size_t items, work_fn_t fn, void *opaque);
+
+/*
+ * The CPUs the calling thread may run on that are neither isolated nor
+ * nohz_full. Falls back to all of the allowed CPUs if that leaves none.
+ * Returns the number of CPUs in the set, or -1 with errno set.
+ */
+int work_pool_housekeeping_cpus(cpu_set_t *cpus);
+
+#endif
@@ -0,0 +1,252 @@
+/**
+ * work_pool_test.cpp
+ *
+ * Runs batches on pools of one and of several workers: every item of a
+ * batch runs exactly once and on a worker of the pool, whatever the
+ * size of the batch and however many batches the pool has run. A
+ * worker held up on its first item leaves the rest of its range to the
+ * others, which steal it. The threads are started whatever the number
+ * of CPUs, so this runs on one as well.
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <vector>
+
+#include <sched.h>
+#include <time.h>
+
+#include "work_pool.h"
+#include "unit_test.h"
+
+#define MAX_WORKERS 8
+#define HOLD_MS 10000
+
+/* What a batch did */
+struct batch_t {
+    std::vector<unsigned int> runs;         /* by item */
+    std::vector<unsigned int> workers;      /* of the last run, by item */
+    std::vector<size_t> order;              /* of the items run on worker 0 */
+    unsigned int bad_worker;                /* runs on a worker not in the pool */
+    unsigned int size;                      /* of the pool */
+
+    /* Stealing: the first item of 'held' waits for all of the others */
+    bool hold;
+    unsigned int held;
+    volatile size_t done;
+    bool timed_out;
+};
+
+typedef struct batch_t batch_t;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static void run_item(unsigned int worker, size_t item, void *opaque)
+{
+    batch_t *b = (batch_t *) opaque;
+
+    if (worker >= b->size) {
+        __sync_fetch_and_add(&b->bad_worker, 1);
+        return;
+    }
+    if (b->hold && worker == b->held && __sync_bool_compare_and_swap(&b->hold, true, false)) {
+        uint64_t until = now_ms() + HOLD_MS;
+        while (b->done < b->runs.size() - 1) {
+            if (now_ms() > until) {
+                b->timed_out = true;
+                break;
+            }
+            sched_yield();
+        }
+    }
+
+    /* Each item is written by the one worker that claimed it */
+    b->runs[item]++;
+    b->workers[item] = worker;
+    if (worker == 0) {
+        b->order.push_back(item);
+    }
+    __sync_fetch_and_add(&b->done, 1);
+}
+
+static void batch_init(batch_t *b, const work_pool_t *wp, size_t items)
+{
+    b->runs.assign(items, 0);
+    b->workers.assign(items, MAX_WORKERS);
+    b->order.clear();
+    b->bad_worker = 0;
+    b->size = wp->size;
+    b->hold = false;
+    b->held = 0;
+    b->done = 0;
+    b->timed_out = false;
+}
+
+/* Every item once, on a worker of the pool */
+static bool run_once(work_pool_t *wp, size_t items)
+{
+    batch_t b;
+    bool once = true;
+
+    batch_init(&b, wp, items);
+    work_pool_run(wp, items, run_item, &b);
+
+    for (size_t i = 0; i < items; i++) {
+        once = once && b.runs[i] == 1;
+    }
+    return once && b.bad_worker == 0 && b.done == items;
+}
+
+/* A batch smaller than the pool, or any on a pool of one, runs in order on the caller */
+static bool runs_in_order(work_pool_t *wp, size_t items)
+{
+    batch_t b;
+
+    batch_init(&b, wp, items);
+    work_pool_run(wp, items, run_item, &b);
+
+    if (b.order.size() != items) {
+        return false;
+    }
+    for (size_t i = 0; i < items; i++) {
+        if (b.order[i] != i || b.runs[i] != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_single(void)
+{
+    work_pool_t wp;
+
+    CHECK(work_pool_init(&wp, 1, NULL) == 0);
+    CHECK(wp.size == 1);
+    CHECK(wp.threads.empty());
+
+    CHECK(runs_in_order(&wp, 0));
+    CHECK(runs_in_order(&wp, 1));
+    CHECK(runs_in_order(&wp, 1000));
+
+    work_pool_free(&wp);
+
+    /* None asked for is one */
+    CHECK(work_pool_init(&wp, 0, NULL) == 0);
+    CHECK(wp.size == 1);
+    CHECK(runs_in_order(&wp, 10));
+    work_pool_free(&wp);
+}
+
+static void test_ranges(unsigned int workers)
+{
+    work_pool_t wp;
+
+    CHECK(work_pool_init(&wp, workers, NULL) == 0);
+    CHECK(wp.size == workers);
+    CHECK(wp.threads.size() == workers - 1);
+    CHECK(wp.ranges.size() == workers);
+
+    /* Fewer items than workers: not worth waking them */
+    CHECK(runs_in_order(&wp, 0));
+    CHECK(runs_in_order(&wp, workers - 1));
+
+    /* As many, a remainder to share, and many */
+    CHECK(run_once(&wp, workers));
+    CHECK(run_once(&wp, workers + 1));
+    CHECK(run_once(&wp, 7 * workers - 1));
+    CHECK(run_once(&wp, 10007));
+
+    /* The ranges of the last batch cover the items, in order and with nothing left */
+    size_t items = 10007;
+    for (unsigned int w = 0; w < workers; w++) {
+        CHECK(wp.ranges[w].end == items * (w + 1) / workers);
+        CHECK(wp.ranges[w].next >= wp.ranges[w].end);
+        CHECK(w == 0 || wp.ranges[w - 1].end == items * w / workers);
+    }
+
+    /* Batch after batch on the same threads */
+    bool once = true;
+    for (size_t batch = 0; batch < 500; batch++) {
+        once = once && run_once(&wp, (batch * 37) % 300);
+    }
+    CHECK(once);
+
+    work_pool_free(&wp);
+    CHECK(wp.size == 1 && wp.threads.empty());
+}
+
+/* Worker 1 is held on its first item: worker 0 runs all of the others */
+static void test_stealing(void)
+{
+    work_pool_t wp;
+    batch_t b;
+    size_t items = 100;
+
+    CHECK(work_pool_init(&wp, 2, NULL) == 0);
+    batch_init(&b, &wp, items);
+    b.hold = true;
+    b.held = 1;
+    work_pool_run(&wp, items, run_item, &b);
+
+    CHECK(!b.timed_out);
+    CHECK(b.done == items);
+
+    size_t stolen = 0, on_held = 0;
+    for (size_t i = 0; i < items; i++) {
+        CHECK(b.runs[i] == 1);
+        if (b.workers[i] == 1) {
+            on_held++;
+        } else if (i >= items / 2) {
+            stolen++;           /* of worker 1's range, run by worker 0 */
+        }
+    }
+
+    /* Worker 1 ran its first item, or none if worker 0 was done before it woke up */
+    CHECK(on_held <= 1);
+    CHECK(stolen + on_held == items / 2);
+
+    /* Worker 0's own range first, in order */
+    bool ordered = b.order.size() >= items / 2;
+    for (size_t i = 0; ordered && i < items / 2; i++) {
+        ordered = b.order[i] == i;
+    }
+    CHECK(ordered);
+
+    work_pool_free(&wp);
+}
+
+static void test_housekeeping(void)
+{
+    cpu_set_t cpus, allowed;
+
+    CHECK(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+    int count = work_pool_housekeeping_cpus(&cpus);
+    CHECK(count > 0);
+    CHECK(count == CPU_COUNT(&cpus));
+
+    cpu_set_t both;
+    CPU_AND(&both, &cpus, &allowed);
+    CHECK(CPU_EQUAL(&both, &cpus));
+
+    /* Pinned to them, the pool still runs everything */
+    work_pool_t wp;
+    CHECK(work_pool_init(&wp, 3, &cpus) == 0);
+    CHECK(run_once(&wp, 1000));
+    work_pool_free(&wp);
+}
+
+int main(void)
+{
+    test_single();
+    for (unsigned int workers = 2; workers <= MAX_WORKERS; workers++) {
+        test_ranges(workers);
+    }
+    test_stealing();
+    test_housekeeping();
+
+    return test_result("work_pool_test");
+}
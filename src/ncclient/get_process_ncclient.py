@@ -23,6 +23,7 @@ PROCESS_CPU_KERNEL_KEY = 'PROC_CPU_KERNEL'
 
 cleanupScriptFile = None
 zombieProcessSet = dict()
+exitedProcesses = dict()
 
 class SystemCPUMemoryLoad:
     def __init__(self, name):
@@ -154,6 +155,7 @@ def main():
               <filter>
                 <oc-proc-ext:system-overall-cpu-memory xmlns:oc-proc-ext="http://infinera.com/yang/openconfig/system/procmon-ext"/>
                 <oc-proc-ext:process-statistics xmlns:oc-proc-ext="http://infinera.com/yang/openconfig/system/procmon-ext"/>
+                <oc-proc-ext:process-exit xmlns:oc-proc-ext="http://infinera.com/yang/openconfig/system/procmon-ext"/>
               </filter>
              '''
 
@@ -177,21 +179,37 @@ def main():
             notifCountProcessStats = notifCountProcessStats + 1
             processPM.SetNotificationCount(notifCountProcessStats)
 
-            print("Total Number of Active Procsses: {}".format(len(root[1])))
-            processPM.NumActiveProcesses(val=len(root[1]))
-            processes = root[1]
+            # In delta mode (process_notifier -d) the notification starts
+            # with an update-type leaf and ends with removed-pid leaves.
+            # With a selection (-k, -i, -x) an others entry follows.
+            updateType = None
+            removedPids = set()
+            processes = []
+            for child in root[1]:
+                if LocalName(child) == 'update-type':
+                    updateType = child.text
+                elif LocalName(child) == 'removed-pid':
+                    removedPids.add(child.text)
+                elif LocalName(child) == 'process':
+                    processes.append(Leaves(child))
+
+            if updateType == 'delta':
+                newProcessSet = set(p for p in processSet if p[0] not in removedPids)
+            else:
+                newProcessSet = set()
+
+            print("Total Number of Active Procsses: {}".format(len(processes)))
 
             print("No. of exisitng processes: {}".format(len(processSet)))
 
-            newProcessSet = set()
             for p in processes:
-                pid = p[0].text
-                pName = p[1].text
-                startTime = p[2].text
-                cpuUsageTotal = p[5].text
-                memUsageTotal = p[6].text
-                cpuUserTime = p[3].text
-                cpuKernTime = p[4].text
+                pid = p['pid']
+                pName = p['name']
+                startTime = p['start-time']
+                cpuUsageTotal = p.get('cpu-usage-percent', p['cpu-utilization'])
+                memUsageTotal = p['memory-utilization']
+                cpuUserTime = p['cpu-usage-user']
+                cpuKernTime = p['cpu-usage-system']
 
                 processSet.add((pid, pName))
                 newProcessSet.add((pid, pName))
@@ -204,17 +222,24 @@ def main():
                                         cpuUserTime=int(cpuUserTime), 
                                         cpuSysTime=int(cpuKernTime))
 
+            processPM.NumActiveProcesses(val=len(newProcessSet))
+
             diff = processSet.difference(newProcessSet)
 
             if len(diff) > 0:
                 print(diff)
 
+            # Exits are reported by process-exit as they happen; a process
+            # that left the stream without one (e.g. it dropped out of the
+            # top-K) gets the time it was last seen.
             for pid, pName in diff:
                 import time
-                stopTime = int(time.time()) - 10
+                stopTime = exitedProcesses.pop(pid, None)
+                if stopTime is None:
+                    stopTime = int(time.time()) - 10
+                    processPM.SetStopTime(pid=pid, name=pName, stopTime=stopTime)
                 AppendZombieProcessPrometheusCleanup(cleanupScriptFile, pid, pName)
                 zombieProcessSet[pid] = (pName,stopTime) 
-                processPM.SetStopTime(pid=pid, name=pName, stopTime=stopTime)
 
             print(zombieProcessSet)
 
@@ -226,11 +251,31 @@ def main():
             print('*' * 100)
 
             processSet = newProcessSet 
+
+        elif str(root[1].tag).find('process-exit') != -1:
+            p = Leaves(root[1])
+            stopTime = EventTime(root[0].text)
+            exitedProcesses[p['pid']] = stopTime
+            processPM.SetStopTime(pid=p['pid'], name=p.get('name', ''), stopTime=stopTime)
+            print("Process {} ({}) exited at {}".format(p['pid'], p.get('name', ''), root[0].text))
     
         print("No. of overall-system-cpu-memory events received so far: {}".format(notifCountCpuMem))
         print("No. of process-statistics events received so far: {}".format(notifCountProcessStats))
 
 
+def LocalName(element) -> str:
+    return element.tag.split('}')[-1]
+
+
+def Leaves(element) -> dict:
+    return dict((LocalName(child), child.text) for child in element)
+
+
+def EventTime(text: str) -> int:
+    from datetime import datetime
+    return int(datetime.fromisoformat(text.replace('Z', '+00:00')).timestamp())
+
+
 def AppendZombieProcessPrometheusCleanup(f: object, pid: int, name: str) -> None:
     baseUrl = 'curl -w "%{http_code}" -X POST -g \'' + PROM_SERVER_URL + '/api/v1/admin/tsdb/delete_series?match[]=' + PROM_METRIC_NAME_PREFIX
     f.write(baseUrl + '_process_cpu_total{PID="' + str(pid) + '", PROC_NAME="' + str(name) + '"}\'\n')
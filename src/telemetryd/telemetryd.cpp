@@ -0,0 +1,237 @@
+/**
+ * telemetryd.cpp
+ *
+ * Hosts all streaming collectors in one process: system load average,
+ * per-process statistics, overall CPU/memory utilization, the
+ * /system/processes table, the per-core /system/cpus utilization,
+ * /system/memory, process start and exit events and the resource use
+ * of the cgroup v2 groups. The collectors
+ * share a single ConfD daemon context, a single /proc sampling layer
+ * and one scheduler, so a process scan feeds every collector that is
+ * due on the same tick.
+ *
+ * Usage: telemetryd [-c collector,...] [-d] [-b deadband%] [-s sync-cycles]
+ *                   [-k top-k] [-o cpu|memory|io|wait|switches] [-I]
+ *                   [-i name-pattern]... [-x name-pattern]...
+ *                   [-T name-pattern]... [-p [-t cache-ttl-ms]] [-r table-interval]
+ *                   [-m min-interval-ms] [-M max-interval-ms] [-u]
+ *                   [-w summary-window] [-j scan-workers] [-g cgroup-root] [interval]
+ *
+ * (c) Infinera Corporation, 2020
+ */
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <string>
+
+#include <unistd.h>
+
+#include "confd_agent.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "load_avg_collector.h"
+#include "process_stats_collector.h"
+#include "process_events_collector.h"
+#include "cpu_memory_collector.h"
+#include "process_table_collector.h"
+#include "cpu_stat_collector.h"
+#include "memory_collector.h"
+#include "summary_collector.h"
+#include "cgroup_collector.h"
+
+static confd_agent_t agent;
+static sampler_t sampler;
+static scheduler_t sched;
+static adaptive_cfg_t adaptive_cfg;
+
+static collector_t *collectors[] = {
+    &load_avg_collector,
+    &process_stats_collector,
+    &process_events_collector,
+    &cpu_memory_collector,
+    &process_table_collector,
+    &cpu_stat_collector,
+    &memory_collector,
+    &cgroup_collector,
+    NULL
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c collector,...] [-d] [-b deadband%%] [-s sync-cycles]\n"
+                    "       %*s [-k top-k] [-o cpu|memory|io|wait|switches] [-I]\n"
+                    "       %*s [-i name-pattern]... [-x name-pattern]...\n"
+                    "       %*s [-T name-pattern]... [-p [-t cache-ttl-ms]] [-r table-interval]\n"
+                    "       %*s [-m min-interval-ms] [-M max-interval-ms] [-u]\n"
+                    "       %*s [-w summary-window] [-j scan-workers] [-g cgroup-root] [interval]\n",
+            prog, (int) strlen(prog), "", (int) strlen(prog), "", (int) strlen(prog), "",
+            (int) strlen(prog), "", (int) strlen(prog), "");
+    fprintf(stderr, "Collectors:");
+    for (int i = 0; collectors[i] != NULL; i++) {
+        fprintf(stderr, " %s", collectors[i]->name);
+    }
+    fprintf(stderr, " (default: all)\n");
+    fprintf(stderr, "-k: stream the top-k processes by CPU, memory, I/O bytes, run-queue wait or\n"
+                    "    context switches (-o), plus the totals of the rest\n"
+                    "-I: add the I/O and scheduling counters of each process (implied by -o io,\n"
+                    "    wait and switches)\n"
+                    "-i/-x: stream only the processes whose name matches an -i and no -x pattern\n"
+                    "       (extended regular expressions, matched against the whole name)\n"
+                    "-T: also stream the threads of the processes whose name matches\n");
+    fprintf(stderr, "-u: adapt the interval to the CPU busy share instead of the load average\n");
+    fprintf(stderr, "-w: send a metric-summary every summary-window seconds, and the metrics\n"
+                    "    themselves only while above the lowest threshold band\n");
+    fprintf(stderr, "-j: share each /proc scan among up to %d threads on the housekeeping CPUs\n",
+            PROC_SCAN_MAX_WORKERS);
+    fprintf(stderr, "-g: the cgroup v2 hierarchy to stream (default: %s, or its unified mount)\n",
+            CGROUP_ROOT);
+    exit(1);
+}
+
+/* Enable the collectors named in a comma separated list */
+static bool select_collectors(const char *list, bool *enabled)
+{
+    std::string names(list);
+    size_t pos = 0;
+
+    while (pos <= names.size()) {
+        size_t end = names.find(',', pos);
+        if (end == std::string::npos) {
+            end = names.size();
+        }
+
+        std::string name = names.substr(pos, end - pos);
+        bool found = false;
+        for (int i = 0; collectors[i] != NULL; i++) {
+            if (name == collectors[i]->name) {
+                enabled[i] = found = true;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown collector: %s\n", name.c_str());
+            return false;
+        }
+
+        pos = end + 1;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool enabled[sizeof(collectors) / sizeof(collectors[0])];
+    bool selected = false;
+    int interval = 0;
+    uint32_t minMs = ADAPTIVE_MIN_MS, maxMs = ADAPTIVE_MAX_MS;
+    bool cpuBusy = false;
+    int summaryWindow = 0;
+    int scanWorkers = 1;
+    int c;
+
+    memset(enabled, 0, sizeof(enabled));
+
+    while ((c = getopt(argc, argv, "c:db:s:k:o:Ii:x:pt:r:m:M:uw:j:T:g:")) != -1) {
+        switch (c) {
+        case 'c':
+            if (!select_collectors(optarg, enabled))
+                usage(argv[0]);
+            selected = true;
+            break;
+        case 'd':
+            process_stats_opts.delta_mode = true;
+            break;
+        case 'b':
+            process_stats_opts.deadband = atoi(optarg);
+            break;
+        case 's':
+            process_stats_opts.sync_cycles = atoi(optarg);
+            break;
+        case 'k':
+            process_stats_opts.top_k = atoi(optarg);
+            break;
+        case 'o':
+            if (!process_stats_rank_by(optarg))
+                usage(argv[0]);
+            break;
+        case 'I':
+            process_stats_opts.io_sched = true;
+            break;
+        case 'i':
+            if (!process_stats_include(optarg))
+                usage(argv[0]);
+            break;
+        case 'x':
+            if (!process_stats_exclude(optarg))
+                usage(argv[0]);
+            break;
+        case 'T':
+            if (!process_stats_threads(optarg))
+                usage(argv[0]);
+            break;
+        case 'p':
+            process_table_opts.data_provider = true;
+            break;
+        case 't':
+            process_table_opts.cache_ttl_ms = atoi(optarg);
+            break;
+        case 'r':
+            if (atoi(optarg) > 0)
+                process_table_collector.interval = atoi(optarg);
+            break;
+        case 'm':
+            minMs = atoi(optarg);
+            break;
+        case 'M':
+            maxMs = atoi(optarg);
+            break;
+        case 'u':
+            cpuBusy = true;
+            break;
+        case 'w':
+            summaryWindow = atoi(optarg);
+            break;
+        case 'j':
+            scanWorkers = atoi(optarg);
+            break;
+        case 'g':
+            cgroup_opts.root = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (argc > optind)
+        interval = atoi(argv[optind]);
+    if (interval == 0)
+        interval = INTERVAL;
+
+    confd_agent_init(&agent, "telemetryd");
+
+    if (sampler_init(&sampler, PROC_ROOT) < 0)
+        confd_fatal("Failed to initialize the /proc scanner\n");
+    if (scanWorkers > 1 && proc_scanner_set_workers(&sampler.scanner, scanWorkers) < 0)
+        fprintf(stderr, "Scanning /proc on one thread: %s\n", strerror(errno));
+
+    adaptive_default_cfg(&adaptive_cfg, interval * 1000);
+    adaptive_cfg.min_ms = minMs;
+    adaptive_cfg.max_ms = maxMs;
+    if (cpuBusy)
+        adaptive_cfg.metric = ADAPTIVE_CPU_BUSY;
+    scheduler_init(&sched, &agent, &sampler, &adaptive_cfg);
+    for (int i = 0; collectors[i] != NULL; i++) {
+        if (!selected || enabled[i]) {
+            scheduler_add(&sched, collectors[i]);
+        }
+    }
+    /* Last, so that a window closes with the samples of its final tick */
+    if (summaryWindow > 0) {
+        summary_collector.interval = summaryWindow;
+        scheduler_add(&sched, &summary_collector);
+    }
+
+    scheduler_start(&sched);
+    scheduler_run(&sched);
+}